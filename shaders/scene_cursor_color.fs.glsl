@@ -1,12 +1,21 @@
 #version 450 core
 
-uniform vec2 resolution;
-uniform vec2 mouse;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 eye;
+    vec2 resolution;
+    vec2 mouse;
+    float time;
+    float time_delta;
+} frame;
 
 out vec4 color;
 
 void main()
 {
-    vec2 v = (mouse.xy / resolution.xy);
-    color = vec4(gl_FragCoord.xy / resolution.xy, (v.x + v.y) * 0.5f, 1.0f);
+    vec2 v = (frame.mouse.xy / frame.resolution.xy);
+    color = vec4(gl_FragCoord.xy / frame.resolution.xy, (v.x + v.y) * 0.5f, 1.0f);
 }
@@ -0,0 +1,13 @@
+#version 450 core
+
+in vec3 Normal;
+in vec3 Color;
+
+out vec4 color;
+
+void main()
+{
+    // fixed light from above and behind the camera's start
+    float light = 0.3 + 0.7 * max(dot(normalize(Normal), normalize(vec3(0.3, 1.0, 0.5))), 0.0);
+    color = vec4(Color * light, 1.0);
+}
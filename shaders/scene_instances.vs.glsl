@@ -0,0 +1,39 @@
+#version 450 core
+
+in vec3 position;
+in vec3 normal;
+
+// per instance
+in vec4 instance_offset_scale;
+in vec4 instance_rotation;
+in vec4 instance_color;
+
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 eye;
+    vec2 resolution;
+    vec2 mouse;
+    float time;
+    float time_delta;
+} frame;
+
+out vec3 Normal;
+out vec3 Color;
+
+// by a unit quaternion
+vec3 rotate(vec4 q, vec3 v)
+{
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main()
+{
+    vec3 world = rotate(instance_rotation, position) * instance_offset_scale.w + instance_offset_scale.xyz;
+
+    Normal = rotate(instance_rotation, normal);
+    Color = instance_color.rgb;
+    gl_Position = frame.view_projection * vec4(world, 1.0);
+}
@@ -1,12 +1,32 @@
 #version 450 core
+#extension GL_ARB_shader_draw_parameters : require
 
 in vec2 position;
 in vec2 texcoord;
 in vec3 color;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+    vec4 eye;
+    vec2 resolution;
+    vec2 mouse;
+    float time;
+    float time_delta;
+} frame;
+
+struct Object
+{
+    mat4 model;
+};
+
+// one record per drawn object, selected by the draw's base instance
+layout(std430, binding = 0) readonly buffer Objects
+{
+    Object objects[];
+};
 
 out vec3 Color;
 out vec2 Texcoord;
@@ -15,6 +35,6 @@ void main()
 {
 	Color = color;
     Texcoord = texcoord;
-    gl_Position = projection * view * model * vec4(position, 0.0, 1.0);
-    //gl_Position = view * model * vec4(position, 0.0, 1.0);
+    mat4 model = objects[gl_BaseInstanceARB + gl_InstanceID].model;
+    gl_Position = frame.view_projection * model * vec4(position, 0.0, 1.0);
 }
@@ -0,0 +1,372 @@
+#include "asset_loader.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <experimental/filesystem>
+
+#include "util.hpp"
+#include "shader.hpp"
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+Asset_Source examine_source(const std::string& path)
+{
+    Asset_Source source;
+    source.path = path;
+
+    std::error_code error;
+    fs::file_time_type time = fs::last_write_time(path, error);
+    std::uintmax_t size = error ? 0 : fs::file_size(path, error);
+
+    if (!error)
+    {
+        source.size = std::uint64_t(size);
+        source.time = std::int64_t(time.time_since_epoch().count());
+    }
+
+    return source;
+}
+
+struct Mesh_Job
+{
+    std::shared_ptr<Asset<Mesh>> asset;
+    std::function<Mesh_Data()> parse;
+    std::string cache_source;       // goes through the mesh cache of this file unless empty
+    GLbitfield optimize;
+    GLenum usage;
+    Mesh_Storage storage;
+
+    // worker results; view points into file, or into data and packed_indices
+    std::string error;
+    std::vector<Asset_Source> sources;     // cache_source, hashed by the mesh cache
+    std::unique_ptr<Mapped_File> file;
+    Mesh_Data data;
+    std::vector<GLubyte> packed_indices;
+    Mesh_Cache_View view;
+
+    // upload progress
+    std::shared_ptr<Mesh> mesh;
+    GLsizeiptr vertex_bytes_done = 0;
+    GLsizeiptr index_bytes_done = 0;
+
+    void run()
+    {
+        if (!cache_source.empty())
+        {
+            // examined before anything is read, so a later change never goes unnoticed
+            sources.push_back(examine_source(cache_source));
+
+            const std::string cache_path = mesh_cache::path_for(cache_source);
+
+            if (fs::exists(cache_path))
+            {
+                file.reset(new Mapped_File(cache_path));
+
+                if (mesh_cache::read(*file, optimize, view))
+                {
+                    auto recorded = std::find(view.sources.begin(), view.sources.end(), cache_source);
+                    if (recorded != view.sources.end()) sources[0].hash = view.source_hashes[recorded - view.sources.begin()];
+
+                    if (storage == MESH_STORAGE_GPU_AND_CPU)
+                    {
+                        const GLubyte* vertex_bytes = static_cast<const GLubyte*>(view.vertices);
+                        data.vertices.assign(vertex_bytes, vertex_bytes + std::size_t(view.vertex_count) * view.format.stride);
+                        data.indices = mesh_cache::unpack_indices(view);
+                    }
+                    return;
+                }
+
+                file.reset();
+            }
+        }
+
+        data = parse();
+        Mesh::prepare(data, optimize);
+
+        if (!cache_source.empty())
+        {
+            std::vector<std::string> cache_sources(1, cache_source);
+            cache_sources.insert(cache_sources.end(), data.dependencies.begin(), data.dependencies.end());
+
+            // failing to write the cache only costs the next load its parsing time
+            try
+            {
+                std::vector<std::uint64_t> hashes;
+                mesh_cache::write(mesh_cache::path_for(cache_source), data, optimize, cache_sources, &hashes);
+                sources[0].hash = hashes[0];
+            }
+            catch (const std::exception&)
+            {
+            }
+        }
+
+        mesh_cache::describe(data, packed_indices, view);
+    }
+};
+
+struct Shader_Job
+{
+    std::shared_ptr<Asset<Shader>> asset;
+    std::string vs_file;
+    std::string fs_file;
+
+    // worker results
+    std::string error;
+    std::vector<Asset_Source> sources;     // vs_file, fs_file
+    std::string vs_source;
+    std::string fs_source;
+};
+
+Asset_Loader::Asset_Loader(GLsizeiptr upload_budget, std::size_t thread_count)
+: workers(thread_count), pending(0), staging(nullptr), budget(upload_budget), region_fences{ nullptr, nullptr },
+  region(0), region_used(0), region_available(false)
+{
+    if (budget < 1)
+    {
+        throw std::runtime_error("Asset upload budget has to be positive");
+    }
+
+    // written by the CPU while the GPU copies out of the other region; coherent, so no flushes
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    staging_buffer = Gpu_Buffer::create();
+    glNamedBufferStorage(staging_buffer, 2 * budget, nullptr, flags);
+    staging_buffer.set_size(2 * budget);
+    staging = static_cast<GLubyte*>(glMapNamedBufferRange(staging_buffer, 0, 2 * budget, flags));
+
+    if (!staging)
+    {
+        throw std::runtime_error("Failed to map the asset staging buffer");
+    }
+}
+
+Asset_Loader::~Asset_Loader()
+{
+    // running jobs hand their results to the loader, so they have to be done first
+    workers.stop();
+
+    for (GLsync fence : region_fences)
+    {
+        if (fence) glDeleteSync(fence);
+    }
+
+    // the staging buffer goes with the deletion queue, which also ends its persistent mapping
+}
+
+std::shared_ptr<Asset<Mesh>> Asset_Loader::submit_mesh(std::shared_ptr<Mesh_Job> job)
+{
+    job->asset = std::make_shared<Asset<Mesh>>();
+    pending++;
+
+    workers.enqueue([this, job]()
+    {
+        try
+        {
+            job->run();
+        }
+        catch (const std::exception& e)
+        {
+            job->error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        finished_meshes.push_back(job);
+    });
+
+    return job->asset;
+}
+
+std::shared_ptr<Asset<Mesh>> Asset_Loader::load_mesh(std::function<Mesh_Data()> parse, GLbitfield optimize, GLenum usage, Mesh_Storage storage)
+{
+    std::shared_ptr<Mesh_Job> job = std::make_shared<Mesh_Job>();
+    job->parse = std::move(parse);
+    job->optimize = optimize;
+    job->usage = usage;
+    job->storage = storage;
+    return submit_mesh(job);
+}
+
+std::shared_ptr<Asset<Mesh>> Asset_Loader::load_obj(const std::string& obj_file_path, GLbitfield optimize, Mesh_Storage storage)
+{
+    std::shared_ptr<Mesh_Job> job = std::make_shared<Mesh_Job>();
+    job->parse = [obj_file_path]() { return Mesh::parse_obj(obj_file_path); };
+    job->cache_source = obj_file_path;
+    job->optimize = optimize;
+    job->usage = GL_STATIC_DRAW;
+    job->storage = storage;
+    return submit_mesh(job);
+}
+
+std::shared_ptr<Asset<Shader>> Asset_Loader::load_shader(const std::string& vs_file, const std::string& fs_file)
+{
+    std::shared_ptr<Shader_Job> job = std::make_shared<Shader_Job>();
+    job->asset = std::make_shared<Asset<Shader>>();
+    job->vs_file = vs_file;
+    job->fs_file = fs_file;
+    pending++;
+
+    workers.enqueue([this, job]()
+    {
+        try
+        {
+            job->sources.push_back(examine_source(job->vs_file));
+            job->sources.push_back(examine_source(job->fs_file));
+
+            job->vs_source = util::file_as_string(job->vs_file);
+            job->fs_source = util::file_as_string(job->fs_file);
+            job->sources[0].hash = util::hash_bytes(job->vs_source.data(), job->vs_source.size());
+            job->sources[1].hash = util::hash_bytes(job->fs_source.data(), job->fs_source.size());
+        }
+        catch (const std::exception& e)
+        {
+            job->error = e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        finished_shaders.push_back(job);
+    });
+
+    return job->asset;
+}
+
+void Asset_Loader::update()
+{
+    {
+        std::lock_guard<std::mutex> lock(finished_mutex);
+        uploads.insert(uploads.end(), finished_meshes.begin(), finished_meshes.end());
+        links.insert(links.end(), finished_shaders.begin(), finished_shaders.end());
+        finished_meshes.clear();
+        finished_shaders.clear();
+    }
+
+    region = 1 - region;
+    region_used = 0;
+    region_available = true;
+
+    if (GLsync fence = region_fences[region])
+    {
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            region_available = false;
+        }
+        else
+        {
+            glDeleteSync(fence);
+            region_fences[region] = nullptr;
+        }
+    }
+
+    // compiling and linking block in the driver, so one program per frame; a handle held only by the
+    // loader belongs to a load nobody waits for anymore
+    while (!links.empty())
+    {
+        std::shared_ptr<Shader_Job> job = links.front();
+        links.pop_front();
+        pending--;
+
+        if (job->asset.use_count() > 1)
+        {
+            link_shader(*job);
+            break;
+        }
+    }
+
+    while (!uploads.empty())
+    {
+        Mesh_Job& job = *uploads.front();
+
+        if (job.asset.use_count() > 1 && !upload_mesh(job))
+        {
+            break;  // budget spent
+        }
+
+        uploads.pop_front();
+        pending--;
+    }
+
+    if (region_used > 0)
+    {
+        region_fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+GLsizeiptr Asset_Loader::stage(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size)
+{
+    GLsizeiptr count = region_available ? std::min(size, budget - region_used) : 0;
+    if (count <= 0) return 0;
+
+    GLintptr staging_offset = region * budget + region_used;
+    std::memcpy(staging + staging_offset, data, std::size_t(count));
+
+    glCopyNamedBufferSubData(staging_buffer, buffer, staging_offset, offset, count);
+
+    region_used += count;
+    return count;
+}
+
+bool Asset_Loader::upload_mesh(Mesh_Job& job)
+{
+    if (!job.error.empty())
+    {
+        job.asset->sources = std::move(job.sources);
+        job.asset->state = ASSET_STATE_FAILED;
+        job.asset->error = job.error;
+        return true;
+    }
+
+    if (!region_available) return false;
+
+    // buffers are allocated up front and filled over as many frames as the budget needs
+    if (!job.mesh)
+    {
+        job.mesh.reset(new Mesh(job.view, job.usage, job.storage, false));
+    }
+
+    const GLsizeiptr vertex_bytes = GLsizeiptr(job.view.vertex_count) * job.view.format.stride;
+    const GLubyte* vertices = static_cast<const GLubyte*>(job.view.vertices);
+    const GLubyte* indices = static_cast<const GLubyte*>(job.view.indices);
+
+    job.vertex_bytes_done += stage(job.mesh->vertex_range.buffer, job.mesh->vertex_range.offset + job.vertex_bytes_done, vertices + job.vertex_bytes_done, vertex_bytes - job.vertex_bytes_done);
+    if (job.vertex_bytes_done < vertex_bytes) return false;
+
+    job.index_bytes_done += stage(job.mesh->index_range.buffer, job.mesh->index_range.offset + job.index_bytes_done, indices + job.index_bytes_done, job.view.index_bytes - job.index_bytes_done);
+    if (job.index_bytes_done < job.view.index_bytes) return false;
+
+    if (job.storage == MESH_STORAGE_GPU_AND_CPU)
+    {
+        job.mesh->vertices = std::move(job.data.vertices);
+        job.mesh->indices = std::move(job.data.indices);
+    }
+
+    // the copies are queued ahead of any draw that uses the mesh, so it is usable right away
+    job.asset->value = job.mesh;
+    job.asset->sources = std::move(job.sources);
+    job.asset->state = ASSET_STATE_READY;
+    return true;
+}
+
+void Asset_Loader::link_shader(Shader_Job& job)
+{
+    job.asset->sources = std::move(job.sources);
+
+    try
+    {
+        if (!job.error.empty())
+        {
+            throw std::runtime_error(job.error);
+        }
+
+        Vertex_Shader vs(job.vs_file, job.vs_source);
+        Fragment_Shader fs(job.fs_file, job.fs_source);
+
+        job.asset->value = std::make_shared<Shader>(vs, fs);
+        job.asset->state = ASSET_STATE_READY;
+    }
+    catch (const std::exception& e)
+    {
+        job.asset->state = ASSET_STATE_FAILED;
+        job.asset->error = e.what();
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "mesh.hpp"
+#include "gpu_object.hpp"
+#include "worker_pool.hpp"
+
+class Shader;
+struct Mesh_Job;
+struct Shader_Job;
+
+enum Asset_State
+{
+    ASSET_STATE_LOADING,    // queued, being read on a worker or waiting for its upload
+    ASSET_STATE_READY,
+    ASSET_STATE_FAILED
+};
+
+// a file a load read, as it was when it was read
+struct Asset_Source
+{
+    std::string path;
+    std::uint64_t size = 0;
+    std::int64_t time = -1;         // modification time; -1 when the file could not be examined
+    std::uint64_t hash = 0;         // content hash, taken on the worker; 0 when not hashed
+};
+
+// size and modification time of path as they are now, without reading it
+Asset_Source examine_source(const std::string& path);
+
+// Result of an asynchronous load; only touched on the GL thread.
+template <typename T>
+struct Asset
+{
+    Asset_State state = ASSET_STATE_LOADING;
+    std::shared_ptr<T> value;
+    std::string error;
+    std::vector<Asset_Source> sources;  // set once the load finished, ready or failed
+
+    // false while loading; a failed load rethrows its error as std::runtime_error
+    bool ready() const
+    {
+        if (state == ASSET_STATE_FAILED) throw std::runtime_error(error);
+        return state == ASSET_STATE_READY;
+    }
+};
+
+// Loads assets without stalling the frame loop. File access, parsing and mesh preparation run on a pool
+// of worker threads; their results are handed back to the GL thread, where update() copies at most
+// upload_budget bytes per frame into GL buffers through a persistently mapped staging buffer and links
+// at most one shader program. Loads whose handle nobody holds anymore are dropped before upload.
+class Asset_Loader
+{
+private:
+    Worker_Pool workers;
+
+    // worker results waiting for the GL thread
+    std::mutex finished_mutex;
+    std::deque<std::shared_ptr<Mesh_Job>> finished_meshes;
+    std::deque<std::shared_ptr<Shader_Job>> finished_shaders;
+
+    // GL thread only
+    std::deque<std::shared_ptr<Mesh_Job>> uploads;
+    std::deque<std::shared_ptr<Shader_Job>> links;
+    std::size_t pending;        // requested loads that are neither ready nor failed
+
+    // two regions of budget bytes, written on alternate frames; a region is only reused once the GPU
+    // has finished the copies out of it, and skipped for a frame rather than waited for
+    Gpu_Buffer staging_buffer;
+    GLubyte* staging;
+    GLsizeiptr budget;
+    GLsync region_fences[2];
+    int region;
+    GLsizeiptr region_used;
+    bool region_available;
+
+    std::shared_ptr<Asset<Mesh>> submit_mesh(std::shared_ptr<Mesh_Job> job);
+    bool upload_mesh(Mesh_Job& job);
+    void link_shader(Shader_Job& job);
+
+public:
+    // thread_count 0 uses one worker per core besides the GL thread
+    explicit Asset_Loader(GLsizeiptr upload_budget = 8 << 20, std::size_t thread_count = 0);
+    ~Asset_Loader();
+
+    Asset_Loader(const Asset_Loader&) = delete;
+    Asset_Loader& operator=(const Asset_Loader&) = delete;
+
+    // parse() runs on a worker and must not make GL calls; the result is prepared there as well
+    std::shared_ptr<Asset<Mesh>> load_mesh(std::function<Mesh_Data()> parse,
+                                           GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                           GLenum usage = GL_STATIC_DRAW,
+                                           Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // Mesh::load_obj, mesh cache included, with all file access and parsing on a worker
+    std::shared_ptr<Asset<Mesh>> load_obj(const std::string& obj_file_path,
+                                          GLbitfield optimize = MESH_OPTIMIZE_ALL,
+                                          Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // sources are read on a worker; compiling and linking need the GL thread
+    std::shared_ptr<Asset<Shader>> load_shader(const std::string& vs_file, const std::string& fs_file);
+
+    // GL thread, once per frame: takes over finished worker results and uploads within the budget
+    void update();
+
+    // Copies up to the rest of this frame's budget from data into buffer at offset, through the staging
+    // buffer. Returns the number of bytes copied; 0 once the budget is spent.
+    GLsizeiptr stage(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size);
+
+    bool busy() const { return pending > 0; }
+};
@@ -0,0 +1,83 @@
+#include "asset_registry.hpp"
+
+#include <fmt/format.h>
+
+Asset_Registry::Asset_Registry(Asset_Loader& loader, std::size_t capacity)
+    : loader(loader), capacity(capacity), hits(0), misses(0)
+{
+}
+
+// A file that cannot be examined now (or could not be then) never counts as unchanged.
+bool Asset_Registry::unchanged(const std::vector<Asset_Source>& sources)
+{
+    for (const Asset_Source& source : sources)
+    {
+        Asset_Source now = examine_source(source.path);
+        if (now.time == -1 || now.time != source.time || now.size != source.size) return false;
+    }
+
+    return true;
+}
+
+void Asset_Registry::forget(std::unordered_map<std::string, Entry>::iterator entry)
+{
+    if (entry->second.retained) recent.erase(entry->second.recent);
+    entries.erase(entry);
+}
+
+void Asset_Registry::touch(Entry& entry, const std::string& key, std::shared_ptr<void> asset)
+{
+    if (entry.retained)
+    {
+        recent.splice(recent.begin(), recent, entry.recent);
+        return;
+    }
+
+    recent.push_front(key);
+    entry.recent = recent.begin();
+    entry.retained = std::move(asset);
+
+    while (recent.size() > capacity)
+    {
+        auto oldest = entries.find(recent.back());
+        recent.pop_back();
+        oldest->second.retained.reset();
+
+        // still registered while somebody else holds it
+        if (oldest->second.asset.expired()) entries.erase(oldest);
+    }
+}
+
+std::shared_ptr<Asset<Mesh>> Asset_Registry::mesh(const std::string& name, std::function<Mesh_Data()> parse,
+                                                  GLbitfield optimize, GLenum usage, Mesh_Storage storage)
+{
+    std::string key = fmt::format("mesh:{}:{}:{}:{}", name, optimize, usage, int(storage));
+
+    return get<Mesh>(key, {}, [&]() { return loader.load_mesh(std::move(parse), optimize, usage, storage); });
+}
+
+std::shared_ptr<Asset<Mesh>> Asset_Registry::obj(const std::string& obj_file_path, GLbitfield optimize, Mesh_Storage storage)
+{
+    std::string key = fmt::format("obj:{}:{}:{}", obj_file_path, optimize, int(storage));
+
+    return get<Mesh>(key, { obj_file_path }, [&]() { return loader.load_obj(obj_file_path, optimize, storage); });
+}
+
+std::shared_ptr<Asset<Shader>> Asset_Registry::shader(const std::string& vs_file, const std::string& fs_file)
+{
+    std::string key = fmt::format("shader:{}:{}", vs_file, fs_file);
+
+    return get<Shader>(key, { vs_file, fs_file }, [&]() { return loader.load_shader(vs_file, fs_file); });
+}
+
+void Asset_Registry::clear()
+{
+    for (const std::string& key : recent)
+    {
+        auto entry = entries.find(key);
+        entry->second.retained.reset();
+        if (entry->second.asset.expired()) entries.erase(entry);
+    }
+
+    recent.clear();
+}
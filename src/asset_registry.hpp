@@ -0,0 +1,112 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "asset_loader.hpp"
+
+// Shares loaded assets between everything that asks for the same one, so switching back to a scene
+// finds its meshes and shaders already on the GPU instead of loading them again. Assets are keyed by
+// their kind, source paths and load options. An asset whose source files changed size or modification
+// time is loaded again; only those two are checked here, as reading large sources would stall the GL
+// thread. Once a load finished, the files as its worker read them (content hashes included) replace
+// what was examined at the request. Entries only hold weak references: an asset
+// lives as long as somebody uses it or it is among the capacity most recently requested ones, and the
+// least recently requested is let go first. GL thread only.
+class Asset_Registry
+{
+private:
+    struct Entry
+    {
+        std::vector<Asset_Source> sources;      // empty for generated assets
+        bool loaded;                            // sources are those the finished load read
+        std::weak_ptr<void> asset;              // an Asset<T> of the kind in the key
+        std::shared_ptr<void> retained;         // set while among the most recently requested
+        std::list<std::string>::iterator recent;
+    };
+
+    Asset_Loader& loader;
+    std::size_t capacity;
+    std::unordered_map<std::string, Entry> entries;
+    std::list<std::string> recent;              // keys of retained entries, most recently requested first
+
+    std::size_t hits;
+    std::size_t misses;
+
+    static bool unchanged(const std::vector<Asset_Source>& sources);
+    void forget(std::unordered_map<std::string, Entry>::iterator entry);
+    void touch(Entry& entry, const std::string& key, std::shared_ptr<void> asset);
+
+public:
+    // capacity is the number of assets kept alive after their last user let go of them
+    explicit Asset_Registry(Asset_Loader& loader, std::size_t capacity = 64);
+
+    Asset_Registry(const Asset_Registry&) = delete;
+    Asset_Registry& operator=(const Asset_Registry&) = delete;
+
+    // Returns the asset registered under key if it is loading or ready and its source files are
+    // unchanged, otherwise the result of load(), which is registered in its place. Keys have to be
+    // unique across asset kinds; the named functions below prefix theirs with the kind. Other kinds,
+    // textures for example, register through this as well.
+    template <typename T, typename Load>
+    std::shared_ptr<Asset<T>> get(const std::string& key, const std::vector<std::string>& source_paths, Load load)
+    {
+        auto found = entries.find(key);
+        if (found != entries.end())
+        {
+            std::shared_ptr<Asset<T>> asset = std::static_pointer_cast<Asset<T>>(found->second.asset.lock());
+            if (asset && asset->state == ASSET_STATE_READY && !found->second.loaded)
+            {
+                found->second.sources = asset->sources;
+                found->second.loaded = true;
+            }
+
+            if (asset && asset->state != ASSET_STATE_FAILED && unchanged(found->second.sources))
+            {
+                touch(found->second, key, asset);
+                hits++;
+                return asset;
+            }
+
+            forget(found);
+        }
+
+        std::vector<Asset_Source> sources;
+        for (const std::string& path : source_paths) sources.push_back(examine_source(path));
+        std::shared_ptr<Asset<T>> asset = load();
+
+        Entry& entry = entries[key];
+        entry.sources = std::move(sources);
+        entry.loaded = false;
+        entry.asset = asset;
+        touch(entry, key, asset);
+        misses++;
+        return asset;
+    }
+
+    // generated meshes have no sources; name identifies what parse() produces
+    std::shared_ptr<Asset<Mesh>> mesh(const std::string& name, std::function<Mesh_Data()> parse,
+                                      GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                      GLenum usage = GL_STATIC_DRAW,
+                                      Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    std::shared_ptr<Asset<Mesh>> obj(const std::string& obj_file_path,
+                                     GLbitfield optimize = MESH_OPTIMIZE_ALL,
+                                     Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    std::shared_ptr<Asset<Shader>> shader(const std::string& vs_file, const std::string& fs_file);
+
+    // lets go of all retained assets; those still in use stay registered
+    void clear();
+
+    std::size_t size() const { return entries.size(); }
+    std::size_t hit_count() const { return hits; }
+    std::size_t miss_count() const { return misses; }
+};
@@ -0,0 +1,74 @@
+#include "command_buffer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+static_assert(std::is_trivially_copyable<Draw_Packet>::value, "Draw packets are recorded as bytes");
+
+void Command_Buffer::append(Command_Type type, const void* payload, std::size_t size)
+{
+    // payloads are padded so every header stays 8-byte aligned
+    Command_Header header = { std::uint32_t(type), std::uint32_t((size + 7) & ~std::size_t(7)) };
+
+    std::size_t offset = commands.size();
+    commands.resize(offset + sizeof(header) + header.size);
+    std::memcpy(commands.data() + offset, &header, sizeof(header));
+    std::memcpy(commands.data() + offset + sizeof(header), payload, size);
+    command_count++;
+}
+
+void Command_Buffer::draw(const Draw_Packet& packet)
+{
+    append(COMMAND_DRAW, &packet, sizeof(packet));
+}
+
+void Command_Buffer::draw(const Draw_Packet& packet, const Object_Uniforms& object)
+{
+    Draw_Packet recorded = packet;
+    recorded.base_instance = GLuint(object_records.size());
+    recorded.instance_count = 1;
+    object_records.push_back(object);
+
+    append(COMMAND_DRAW_OBJECT, &recorded, sizeof(recorded));
+}
+
+void Command_Buffer::replay(Render_Queue& queue, GLuint first_object) const
+{
+    const std::uint8_t* command = commands.data();
+    const std::uint8_t* end = command + commands.size();
+
+    while (command < end)
+    {
+        Command_Header header;
+        std::memcpy(&header, command, sizeof(header));
+        command += sizeof(header);
+
+        switch (header.type)
+        {
+            case COMMAND_DRAW:
+            case COMMAND_DRAW_OBJECT:
+            {
+                Draw_Packet packet;
+                std::memcpy(&packet, command, sizeof(packet));
+                if (header.type == COMMAND_DRAW_OBJECT) packet.base_instance += first_object;
+                queue.submit(packet);
+            }
+            break;
+
+            default:
+                throw std::runtime_error(fmt::format("Unknown command type {} in command buffer", header.type));
+        }
+
+        command += header.size;
+    }
+}
+
+void Command_Buffer::clear()
+{
+    commands.clear();
+    object_records.clear();
+    command_count = 0;
+}
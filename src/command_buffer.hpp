@@ -0,0 +1,60 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "uniforms.hpp"
+#include "render_queue.hpp"
+
+enum Command_Type
+{
+    COMMAND_DRAW,           // Draw_Packet as submitted
+    COMMAND_DRAW_OBJECT     // Draw_Packet whose base_instance is an object record of the same buffer
+};
+
+// precedes every command; the payload follows directly
+struct Command_Header
+{
+    std::uint32_t type;     // Command_Type
+    std::uint32_t size;     // payload bytes, a multiple of 8
+};
+
+// Draws recorded off the GL thread. Recording makes no GL calls and touches nothing but the buffer, so
+// every worker can fill its own buffer concurrently (one per scene layer, culling chunk, ...); the GL
+// thread then replays the buffers one after the other into the render queue. Commands are a header and
+// a trivially copyable payload in one byte stream, so replay is a walk over the bytes with a switch per
+// command. Object records are kept next to the commands and get their place in the frame's Objects
+// block on replay, which rebases the draws that read them.
+class Command_Buffer
+{
+private:
+    std::vector<std::uint8_t> commands;
+    std::vector<Object_Uniforms> object_records;
+    std::size_t command_count;
+
+    void append(Command_Type type, const void* payload, std::size_t size);
+
+public:
+    Command_Buffer() : command_count(0) {}
+
+    // the packet as is: base_instance is an absolute record (e.g. of an Instance_Range)
+    void draw(const Draw_Packet& packet);
+
+    // the packet with one object record of its own, read through its base instance
+    void draw(const Draw_Packet& packet, const Object_Uniforms& object);
+
+    // GL thread: submits the commands in recorded order, with object records starting at first_object
+    // of the frame's Objects block
+    void replay(Render_Queue& queue, GLuint first_object) const;
+
+    // drops the commands, keeping the memory for the next frame
+    void clear();
+
+    const std::vector<Object_Uniforms>& objects() const { return object_records; }
+    std::size_t size() const { return command_count; }
+    std::size_t bytes() const { return commands.size(); }
+};
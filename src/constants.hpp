@@ -4,4 +4,11 @@ namespace constants
 {
     static const int window_width = 1280;
     static const int window_height = 720;
+
+    static const int arena_defragment_budget = 2 << 20;   // bytes moved per frame and arena
+    static const int frame_ring_size = 4 << 20;           // bytes of dynamic data per frame
+    static const int instance_ring_size = 40 << 20;       // bytes of instance records per frame, once a scene draws instances
+    static const int frame_object_capacity = 16384;       // object records per frame; the Objects block takes 1 MB of the frame ring
+
+    static const int instance_benchmark_count = 1000000;  // boxes of the instancing scene
 };
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+const GLuint corner_missing = std::numeric_limits<GLuint>::max();
+
+// One polygon corner in formats that index every attribute separately (OBJ, FBX); zero-based indices
+// into the position, texcoord and normal arrays, corner_missing where the attribute is absent.
+struct Corner
+{
+    GLuint v, vt, vn;
+};
+
+// Open addressing table from corners to welded vertex indices. Corners with identical tuples become
+// one vertex of the indexed mesh. The expected count is only a first guess: the table doubles
+// whenever it gets half full.
+class Corner_Table
+{
+private:
+    std::vector<Corner> keys;
+    std::vector<GLuint> values;
+    std::size_t mask;
+    std::size_t count;
+
+    static std::size_t hash(const Corner& c)
+    {
+        std::uint64_t h = (std::uint64_t(c.v) * 0x9e3779b97f4a7c15ull) ^ (std::uint64_t(c.vt) * 0xc2b2ae3d27d4eb4full) ^ (std::uint64_t(c.vn) * 0x165667b19e3779f9ull);
+        return std::size_t(h ^ (h >> 29));
+    }
+
+public:
+    explicit Corner_Table(std::size_t expected)
+    {
+        std::size_t capacity = 16;
+        while (capacity < expected * 2) capacity <<= 1;
+
+        keys.resize(capacity);
+        values.assign(capacity, corner_missing);
+        mask = capacity - 1;
+        count = 0;
+    }
+
+    // returns the existing index for the corner, or inserts next_index
+    GLuint insert(const Corner& corner, GLuint next_index)
+    {
+        for (std::size_t slot = hash(corner) & mask; ; slot = (slot + 1) & mask)
+        {
+            if (values[slot] == corner_missing)
+            {
+                if (2 * (count + 1) > keys.size())
+                {
+                    grow();
+                    return insert(corner, next_index);
+                }
+
+                keys[slot] = corner;
+                values[slot] = next_index;
+                count++;
+                return next_index;
+            }
+
+            const Corner& key = keys[slot];
+            if (key.v == corner.v && key.vt == corner.vt && key.vn == corner.vn)
+            {
+                return values[slot];
+            }
+        }
+    }
+
+private:
+    void grow()
+    {
+        std::vector<Corner> old_keys;
+        std::vector<GLuint> old_values;
+        old_keys.swap(keys);
+        old_values.swap(values);
+
+        keys.resize(old_keys.size() * 2);
+        values.assign(old_values.size() * 2, corner_missing);
+        mask = keys.size() - 1;
+
+        for (std::size_t i = 0; i < old_values.size(); ++i)
+        {
+            if (old_values[i] == corner_missing) continue;
+
+            std::size_t slot = hash(old_keys[i]) & mask;
+            while (values[slot] != corner_missing) slot = (slot + 1) & mask;
+
+            keys[slot] = old_keys[i];
+            values[slot] = old_values[i];
+        }
+    }
+};
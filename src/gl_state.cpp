@@ -0,0 +1,227 @@
+#include "gl_state.hpp"
+
+#include <algorithm>
+
+template <typename T>
+bool Gl_State::change(Cached<T>& cached, const T& value)
+{
+    frame.calls++;
+
+    if (cached.valid && cached.value == value)
+    {
+        frame.filtered++;
+        return false;
+    }
+
+    cached.value = value;
+    cached.valid = true;
+    return true;
+}
+
+void Gl_State::use_program(GLuint program)
+{
+    if (change(this->program, program)) glUseProgram(program);
+}
+
+void Gl_State::bind_vertex_array(GLuint vertex_array)
+{
+    if (change(this->vertex_array, vertex_array)) glBindVertexArray(vertex_array);
+}
+
+void Gl_State::bind_framebuffer(GLenum target, GLuint framebuffer)
+{
+    if (target != GL_FRAMEBUFFER)
+    {
+        Cached<GLuint>& cached = (target == GL_READ_FRAMEBUFFER) ? read_framebuffer : draw_framebuffer;
+        if (change(cached, framebuffer)) glBindFramebuffer(target, framebuffer);
+        return;
+    }
+
+    frame.calls++;
+
+    if (draw_framebuffer.valid && read_framebuffer.valid && draw_framebuffer.value == framebuffer && read_framebuffer.value == framebuffer)
+    {
+        frame.filtered++;
+        return;
+    }
+
+    draw_framebuffer.value = read_framebuffer.value = framebuffer;
+    draw_framebuffer.valid = read_framebuffer.valid = true;
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+void Gl_State::bind_buffer(GLenum target, GLuint buffer)
+{
+    frame.calls++;
+
+    auto it = std::find_if(buffers.begin(), buffers.end(), [target](const std::pair<GLenum, GLuint>& binding) { return binding.first == target; });
+    if (it == buffers.end())
+    {
+        buffers.emplace_back(target, buffer);
+    }
+    else if (it->second == buffer)
+    {
+        frame.filtered++;
+        return;
+    }
+    else
+    {
+        it->second = buffer;
+    }
+
+    glBindBuffer(target, buffer);
+}
+
+void Gl_State::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    frame.calls++;
+
+    auto it = std::find_if(indexed_buffers.begin(), indexed_buffers.end(), [target, index](const Indexed_Buffer& binding)
+    {
+        return binding.target == target && binding.index == index;
+    });
+
+    if (it == indexed_buffers.end())
+    {
+        indexed_buffers.push_back({ target, index, buffer, offset, size });
+    }
+    else if (it->buffer == buffer && it->offset == offset && it->size == size)
+    {
+        frame.filtered++;
+        return;
+    }
+    else
+    {
+        it->buffer = buffer;
+        it->offset = offset;
+        it->size = size;
+    }
+
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void Gl_State::bind_texture(GLuint unit, GLuint texture)
+{
+    if (unit >= textures.size()) textures.resize(unit + 1);
+    if (change(textures[unit], texture)) glBindTextureUnit(unit, texture);
+}
+
+void Gl_State::enable(GLenum cap)
+{
+    set_enabled(cap, true);
+}
+
+void Gl_State::disable(GLenum cap)
+{
+    set_enabled(cap, false);
+}
+
+void Gl_State::set_enabled(GLenum cap, bool enabled)
+{
+    frame.calls++;
+
+    auto it = std::find_if(capabilities.begin(), capabilities.end(), [cap](const Capability& capability) { return capability.cap == cap; });
+    if (it == capabilities.end())
+    {
+        capabilities.push_back({ cap, enabled });
+    }
+    else if (it->enabled == enabled)
+    {
+        frame.filtered++;
+        return;
+    }
+    else
+    {
+        it->enabled = enabled;
+    }
+
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+}
+
+void Gl_State::blend_func(GLenum source, GLenum destination)
+{
+    blend_func_separate(source, destination, source, destination);
+}
+
+void Gl_State::blend_func_separate(GLenum source_rgb, GLenum destination_rgb, GLenum source_alpha, GLenum destination_alpha)
+{
+    if (change(blend_function, glm::uvec4(source_rgb, destination_rgb, source_alpha, destination_alpha)))
+    {
+        glBlendFuncSeparate(source_rgb, destination_rgb, source_alpha, destination_alpha);
+    }
+}
+
+void Gl_State::blend_equation(GLenum mode)
+{
+    blend_equation_separate(mode, mode);
+}
+
+void Gl_State::blend_equation_separate(GLenum mode_rgb, GLenum mode_alpha)
+{
+    if (change(blend_equations, glm::uvec2(mode_rgb, mode_alpha))) glBlendEquationSeparate(mode_rgb, mode_alpha);
+}
+
+void Gl_State::depth_func(GLenum function)
+{
+    if (change(depth_function, function)) glDepthFunc(function);
+}
+
+void Gl_State::depth_mask(GLboolean write)
+{
+    if (change(depth_writes, write)) glDepthMask(write);
+}
+
+void Gl_State::cull_face(GLenum face)
+{
+    if (change(culled_face, face)) glCullFace(face);
+}
+
+void Gl_State::front_face(GLenum mode)
+{
+    if (change(front, mode)) glFrontFace(mode);
+}
+
+void Gl_State::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (change(viewport_rect, glm::ivec4(x, y, width, height))) glViewport(x, y, width, height);
+}
+
+void Gl_State::clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    if (change(clear_value, glm::vec4(red, green, blue, alpha))) glClearColor(red, green, blue, alpha);
+}
+
+void Gl_State::invalidate()
+{
+    invalidate_bindings();
+
+    capabilities.clear();
+    blend_function.valid = false;
+    blend_equations.valid = false;
+    depth_function.valid = false;
+    depth_writes.valid = false;
+    culled_face.valid = false;
+    front.valid = false;
+    viewport_rect.valid = false;
+    clear_value.valid = false;
+}
+
+void Gl_State::invalidate_bindings()
+{
+    program.valid = false;
+    vertex_array.valid = false;
+    draw_framebuffer.valid = false;
+    read_framebuffer.valid = false;
+    buffers.clear();
+    indexed_buffers.clear();
+    textures.clear();
+}
+
+void Gl_State::end_frame()
+{
+    previous = frame;
+    total.calls += frame.calls;
+    total.filtered += frame.filtered;
+    frame = Gl_State_Statistics();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+struct Gl_State_Statistics
+{
+    std::uint64_t calls = 0;        // state changes requested
+    std::uint64_t filtered = 0;     // of those, dropped because the state was already set
+};
+
+// Shadow copy of the GL state the renderer changes. Every setter compares with the value it last
+// passed to GL and only makes the call when it differs, so draws can state everything they depend on
+// without paying driver validation for the parts that did not change. Values start out unknown and
+// the first request always goes through. Whoever changes state behind its back (or deletes bound
+// objects) has to call invalidate(). GL thread only.
+class Gl_State
+{
+private:
+    template <typename T>
+    struct Cached
+    {
+        T value;
+        bool valid = false;
+    };
+
+    struct Capability
+    {
+        GLenum cap;
+        bool enabled;
+    };
+
+    struct Indexed_Buffer
+    {
+        GLenum target;
+        GLuint index;
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    Cached<GLuint> program;
+    Cached<GLuint> vertex_array;
+    Cached<GLuint> draw_framebuffer;
+    Cached<GLuint> read_framebuffer;
+    std::vector<std::pair<GLenum, GLuint>> buffers;     // per non-indexed target
+    std::vector<Indexed_Buffer> indexed_buffers;        // uniform, storage, ... binding points
+    std::vector<Cached<GLuint>> textures;               // per texture unit
+    std::vector<Capability> capabilities;
+
+    Cached<glm::uvec4> blend_function;                  // src rgb, dst rgb, src alpha, dst alpha
+    Cached<glm::uvec2> blend_equations;                 // rgb, alpha
+    Cached<GLenum> depth_function;
+    Cached<GLboolean> depth_writes;
+    Cached<GLenum> culled_face;
+    Cached<GLenum> front;
+    Cached<glm::ivec4> viewport_rect;
+    Cached<glm::vec4> clear_value;
+
+    Gl_State_Statistics frame;
+    Gl_State_Statistics previous;
+    Gl_State_Statistics total;
+
+    template <typename T>
+    bool change(Cached<T>& cached, const T& value);
+
+public:
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vertex_array);
+
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bind_framebuffer(GLenum target, GLuint framebuffer);
+
+    // non-indexed targets: GL_DRAW_INDIRECT_BUFFER, GL_DISPATCH_INDIRECT_BUFFER, GL_PIXEL_UNPACK_BUFFER, ...
+    // (element buffers belong to the vertex array and are attached with direct state access)
+    void bind_buffer(GLenum target, GLuint buffer);
+
+    // GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER or GL_TRANSFORM_FEEDBACK_BUFFER
+    void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    void bind_texture(GLuint unit, GLuint texture);
+
+    void enable(GLenum cap);
+    void disable(GLenum cap);
+    void set_enabled(GLenum cap, bool enabled);
+
+    void blend_func(GLenum source, GLenum destination);
+    void blend_func_separate(GLenum source_rgb, GLenum destination_rgb, GLenum source_alpha, GLenum destination_alpha);
+    void blend_equation(GLenum mode);
+    void blend_equation_separate(GLenum mode_rgb, GLenum mode_alpha);
+    void depth_func(GLenum function);
+    void depth_mask(GLboolean write);
+    void cull_face(GLenum face);
+    void front_face(GLenum mode);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void clear_color(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+
+    // forgets everything, so the next request of every state goes through
+    void invalidate();
+
+    // forgets bindings of object names only; after GL objects were deleted, as their names may be reused
+    void invalidate_bindings();
+
+    // once per frame, after its commands were issued
+    void end_frame();
+
+    // counts of the last complete frame, and of all complete frames
+    const Gl_State_Statistics& frame_statistics() const { return previous; }
+    const Gl_State_Statistics& statistics() const { return total; }
+};
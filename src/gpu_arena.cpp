@@ -0,0 +1,468 @@
+#include "gpu_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace
+{
+    int floor_log2(std::uint64_t value)
+    {
+        int log2 = 0;
+        while (value >>= 1) log2++;
+        return log2;
+    }
+
+    int lowest_bit(std::uint32_t bits)
+    {
+        int index = 0;
+        while (!(bits & 1u))
+        {
+            bits >>= 1;
+            index++;
+        }
+        return index;
+    }
+
+    // candidates looked at per defragment() call; keeps a call cheap when little can be moved
+    const std::size_t max_defragment_candidates = 64;
+}
+
+Gpu_Arena::Gpu_Arena(GLsizeiptr block_size)
+: block_size((std::max(block_size, GLsizeiptr(granularity)) + granularity - 1) / granularity * granularity), nodes(1), allocations(1),
+  move_count(0), moved_bytes(0)
+{
+}
+
+// sizes are multiples of granularity; bins below sl_count units are exact, above that each power of
+// two range is split into sl_count steps
+void Gpu_Arena::bin(GLsizeiptr size, int& fl, int& sl)
+{
+    std::uint64_t units = std::uint64_t(size / granularity);
+
+    if (units < std::uint64_t(sl_count))
+    {
+        fl = 0;
+        sl = int(units);
+        return;
+    }
+
+    int log2 = floor_log2(units);
+    fl = log2 - sl_bits + 1;
+    sl = int(units >> (log2 - sl_bits)) - sl_count;
+}
+
+GLsizeiptr Gpu_Arena::padded_size(GLsizeiptr size, GLsizeiptr alignment)
+{
+    // offsets are multiples of granularity already; other alignments leave room to round up within the range
+    if (granularity % alignment != 0) size += alignment - 1;
+    return (size + granularity - 1) / granularity * granularity;
+}
+
+GLintptr Gpu_Arena::align(GLintptr offset, GLsizeiptr alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+std::uint32_t Gpu_Arena::new_node()
+{
+    if (!unused_nodes.empty())
+    {
+        std::uint32_t node = unused_nodes.back();
+        unused_nodes.pop_back();
+        return node;
+    }
+
+    nodes.push_back(Node());
+    return std::uint32_t(nodes.size() - 1);
+}
+
+void Gpu_Arena::insert_free(std::uint32_t node)
+{
+    Node& free_node = nodes[node];
+    Block& block = blocks[free_node.block];
+
+    int fl, sl;
+    bin(free_node.size, fl, sl);
+
+    free_node.allocation = 0;
+    free_node.prev_free = 0;
+    free_node.next_free = block.heads[fl][sl];
+    if (free_node.next_free) nodes[free_node.next_free].prev_free = node;
+
+    block.heads[fl][sl] = node;
+    block.fl_bitmap |= 1u << fl;
+    block.sl_bitmap[fl] |= 1u << sl;
+}
+
+void Gpu_Arena::remove_free(std::uint32_t node)
+{
+    Node& free_node = nodes[node];
+    Block& block = blocks[free_node.block];
+
+    int fl, sl;
+    bin(free_node.size, fl, sl);
+
+    if (free_node.prev_free) nodes[free_node.prev_free].next_free = free_node.next_free;
+    if (free_node.next_free) nodes[free_node.next_free].prev_free = free_node.prev_free;
+
+    if (block.heads[fl][sl] == node)
+    {
+        block.heads[fl][sl] = free_node.next_free;
+
+        if (!free_node.next_free)
+        {
+            block.sl_bitmap[fl] &= ~(1u << sl);
+            if (!block.sl_bitmap[fl]) block.fl_bitmap &= ~(1u << fl);
+        }
+    }
+}
+
+std::uint32_t Gpu_Arena::find_free(Block& block, GLsizeiptr size)
+{
+    int fl, sl;
+
+    // start at the first bin whose every range fits, so no list has to be searched
+    std::uint64_t units = std::uint64_t(size / granularity);
+    if (units >= std::uint64_t(sl_count))
+    {
+        units += (std::uint64_t(1) << (floor_log2(units) - sl_bits)) - 1;
+    }
+
+    bin(GLsizeiptr(units) * granularity, fl, sl);
+
+    std::uint32_t sl_map = (fl < fl_count) ? block.sl_bitmap[fl] & (~0u << sl) : 0;
+    if (!sl_map)
+    {
+        std::uint32_t fl_map = (fl + 1 < fl_count) ? block.fl_bitmap & (~0u << (fl + 1)) : 0;
+
+        if (!fl_map)
+        {
+            // the bin of size itself may still hold a range that is large enough
+            bin(size, fl, sl);
+            for (std::uint32_t node = block.heads[fl][sl]; node; node = nodes[node].next_free)
+            {
+                if (nodes[node].size >= size) return node;
+            }
+            return 0;
+        }
+
+        fl = lowest_bit(fl_map);
+        sl_map = block.sl_bitmap[fl];
+    }
+
+    return block.heads[fl][lowest_bit(sl_map)];
+}
+
+std::uint32_t Gpu_Arena::take(std::uint32_t free_node, GLsizeiptr size, Handle allocation)
+{
+    remove_free(free_node);
+
+    if (nodes[free_node].size - size >= granularity)
+    {
+        std::uint32_t rest = new_node();
+        Node& node = nodes[free_node];
+
+        nodes[rest].offset = node.offset + size;
+        nodes[rest].size = node.size - size;
+        nodes[rest].block = node.block;
+        nodes[rest].prev_physical = free_node;
+        nodes[rest].next_physical = node.next_physical;
+        if (node.next_physical) nodes[node.next_physical].prev_physical = rest;
+
+        node.next_physical = rest;
+        node.size = size;
+        insert_free(rest);
+    }
+
+    nodes[free_node].allocation = allocation;
+    blocks[nodes[free_node].block].allocation_count++;
+    return free_node;
+}
+
+// merges into the free neighbours; a free range to the left absorbs this one, so its handle stays valid
+void Gpu_Arena::release(std::uint32_t node)
+{
+    std::uint32_t block = nodes[node].block;
+    nodes[node].allocation = 0;
+    blocks[block].allocation_count--;
+
+    std::uint32_t next = nodes[node].next_physical;
+    if (next && !nodes[next].allocation)
+    {
+        remove_free(next);
+        nodes[node].size += nodes[next].size;
+        nodes[node].next_physical = nodes[next].next_physical;
+        if (nodes[node].next_physical) nodes[nodes[node].next_physical].prev_physical = node;
+        unused_nodes.push_back(next);
+    }
+
+    std::uint32_t prev = nodes[node].prev_physical;
+    if (prev && !nodes[prev].allocation)
+    {
+        remove_free(prev);
+        nodes[prev].size += nodes[node].size;
+        nodes[prev].next_physical = nodes[node].next_physical;
+        if (nodes[prev].next_physical) nodes[nodes[prev].next_physical].prev_physical = prev;
+        unused_nodes.push_back(node);
+        node = prev;
+    }
+
+    insert_free(node);
+
+    if (blocks[block].allocation_count == 0)
+    {
+        std::size_t live = 0;
+        for (const Block& other : blocks) live += (other.buffer != 0);
+        if (live > 1) release_block(block);
+    }
+}
+
+std::uint32_t Gpu_Arena::add_block(GLsizeiptr size)
+{
+    std::uint32_t index = 0;
+    while (index < blocks.size() && blocks[index].buffer) index++;
+    if (index == blocks.size()) blocks.push_back(Block());
+
+    Block& block = blocks[index];
+    block = Block();
+    block.size = size;
+    block.allocation_count = 0;
+    block.fl_bitmap = 0;
+    std::fill(std::begin(block.sl_bitmap), std::end(block.sl_bitmap), 0u);
+    std::fill(&block.heads[0][0], &block.heads[0][0] + fl_count * sl_count, 0u);
+
+    // immutable storage; contents are written with glBufferSubData, copies or a write mapping
+    block.buffer = Gpu_Buffer::create();
+    glNamedBufferStorage(block.buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT | GL_MAP_WRITE_BIT);
+    block.buffer.set_size(size);
+
+    std::uint32_t node = new_node();
+    nodes[node].offset = 0;
+    nodes[node].size = size;
+    nodes[node].block = index;
+    nodes[node].prev_physical = 0;
+    nodes[node].next_physical = 0;
+    block.first = node;
+    insert_free(node);
+
+    return index;
+}
+
+void Gpu_Arena::release_block(std::uint32_t index)
+{
+    Block& block = blocks[index];
+
+    remove_free(block.first);
+    unused_nodes.push_back(block.first);
+
+    block.buffer.reset();
+    block.first = 0;
+}
+
+Gpu_Arena::Handle Gpu_Arena::allocate(GLsizeiptr size, GLsizeiptr alignment, Relocated relocated)
+{
+    if (size <= 0 || alignment <= 0)
+    {
+        throw std::runtime_error(fmt::format("Invalid arena allocation of {} bytes aligned to {}", size, alignment));
+    }
+
+    GLsizeiptr padded = padded_size(size, alignment);
+
+    std::uint32_t free_node = 0;
+    for (Block& block : blocks)
+    {
+        if (block.buffer && (free_node = find_free(block, padded))) break;
+    }
+
+    if (!free_node)
+    {
+        std::uint32_t block = add_block(std::max(block_size, padded));
+        free_node = find_free(blocks[block], padded);
+    }
+
+    Handle handle;
+    if (!unused_allocations.empty())
+    {
+        handle = unused_allocations.back();
+        unused_allocations.pop_back();
+    }
+    else
+    {
+        allocations.push_back(Allocation());
+        handle = Handle(allocations.size() - 1);
+    }
+
+    Allocation& allocation = allocations[handle];
+    allocation.node = take(free_node, padded, handle);
+    allocation.size = size;
+    allocation.alignment = alignment;
+    allocation.relocated = std::move(relocated);
+
+    return handle;
+}
+
+void Gpu_Arena::free(Handle handle)
+{
+    if (!handle) return;
+
+    Allocation& allocation = allocations[handle];
+    release(allocation.node);
+
+    allocation.node = 0;
+    allocation.relocated = Relocated();
+    unused_allocations.push_back(handle);
+}
+
+Gpu_Range Gpu_Arena::range(Handle handle) const
+{
+    const Allocation& allocation = allocations[handle];
+    const Node& node = nodes[allocation.node];
+
+    Gpu_Range range;
+    range.buffer = blocks[node.block].buffer;
+    range.offset = align(node.offset, allocation.alignment);
+    range.size = allocation.size;
+    return range;
+}
+
+GLsizeiptr Gpu_Arena::defragment(GLsizeiptr max_bytes)
+{
+    // position of the lowest free range; everything below it is packed already
+    auto lowest_free = [this](std::uint32_t& block, GLintptr& offset)
+    {
+        for (block = 0; block < blocks.size(); ++block)
+        {
+            if (!blocks[block].buffer) continue;
+
+            for (std::uint32_t node = blocks[block].first; node; node = nodes[node].next_physical)
+            {
+                if (!nodes[node].allocation)
+                {
+                    offset = nodes[node].offset;
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+
+    GLsizeiptr moved = 0;
+    std::size_t candidates = 0;
+    bool packed = false;
+
+    for (std::uint32_t b = std::uint32_t(blocks.size()); b-- > 0 && moved < max_bytes && !packed;)
+    {
+        if (!blocks[b].buffer) continue;
+
+        std::uint32_t node = blocks[b].first;
+        while (nodes[node].next_physical) node = nodes[node].next_physical;
+
+        while (node && blocks[b].buffer && moved < max_bytes && candidates < max_defragment_candidates)
+        {
+            std::uint32_t prev = nodes[node].prev_physical;
+            Handle handle = nodes[node].allocation;
+
+            if (handle && allocations[handle].relocated)
+            {
+                candidates++;
+
+                std::uint32_t hole_block;
+                GLintptr hole_offset;
+                if (!lowest_free(hole_block, hole_offset) || hole_block > b || (hole_block == b && hole_offset > nodes[node].offset))
+                {
+                    packed = true;
+                    break;
+                }
+
+                // lowest free range below the allocation that is large enough
+                GLsizeiptr size = nodes[node].size;
+                std::uint32_t target = 0;
+                for (std::uint32_t t = hole_block; t <= b && !target; ++t)
+                {
+                    if (!blocks[t].buffer) continue;
+
+                    for (std::uint32_t candidate = blocks[t].first; candidate; candidate = nodes[candidate].next_physical)
+                    {
+                        if (t == b && nodes[candidate].offset >= nodes[node].offset) break;
+
+                        if (!nodes[candidate].allocation && nodes[candidate].size >= size)
+                        {
+                            target = candidate;
+                            break;
+                        }
+                    }
+                }
+
+                if (target)
+                {
+                    std::uint32_t from = node;
+                    std::uint32_t to = take(target, size, handle);
+                    Allocation& allocation = allocations[handle];
+
+                    glCopyNamedBufferSubData(blocks[nodes[from].block].buffer, blocks[nodes[to].block].buffer,
+                                             align(nodes[from].offset, allocation.alignment), align(nodes[to].offset, allocation.alignment), allocation.size);
+
+                    allocation.node = to;
+                    release(from);
+
+                    move_count++;
+                    moved_bytes += std::uint64_t(allocation.size);
+                    moved += allocation.size;
+
+                    allocation.relocated(range(handle));
+                }
+            }
+
+            node = prev;
+        }
+    }
+
+    return moved;
+}
+
+Gpu_Arena_Statistics Gpu_Arena::statistics() const
+{
+    Gpu_Arena_Statistics statistics;
+    statistics.move_count = move_count;
+    statistics.moved_bytes = moved_bytes;
+
+    for (const Block& block : blocks)
+    {
+        if (!block.buffer) continue;
+
+        statistics.block_count++;
+        statistics.capacity += block.size;
+        statistics.allocation_count += block.allocation_count;
+
+        for (std::uint32_t node = block.first; node; node = nodes[node].next_physical)
+        {
+            if (nodes[node].allocation)
+            {
+                statistics.used += nodes[node].size;
+            }
+            else
+            {
+                statistics.free_range_count++;
+                statistics.largest_free_range = std::max(statistics.largest_free_range, nodes[node].size);
+            }
+        }
+    }
+
+    return statistics;
+}
+
+std::shared_ptr<Gpu_Arena> Gpu_Arena::shared(Gpu_Arena_Kind kind)
+{
+    static std::weak_ptr<Gpu_Arena> arenas[2];
+
+    std::shared_ptr<Gpu_Arena> arena = arenas[kind].lock();
+    if (!arena)
+    {
+        arena = std::make_shared<Gpu_Arena>(kind == GPU_ARENA_VERTICES ? GLsizeiptr(64 << 20) : GLsizeiptr(16 << 20));
+        arenas[kind] = arena;
+    }
+
+    return arena;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include <glad/glad.h>
+
+#include "gpu_object.hpp"
+
+enum Gpu_Arena_Kind
+{
+    GPU_ARENA_VERTICES,
+    GPU_ARENA_INDICES
+};
+
+// bytes of one arena buffer handed to one user
+struct Gpu_Range
+{
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+};
+
+struct Gpu_Arena_Statistics
+{
+    std::size_t block_count = 0;
+    GLsizeiptr capacity = 0;            // bytes of buffer storage
+    GLsizeiptr used = 0;                // bytes allocated, alignment padding included
+    std::size_t allocation_count = 0;
+    std::size_t free_range_count = 0;
+    GLsizeiptr largest_free_range = 0;
+    std::uint64_t move_count = 0;       // allocations moved by defragment() so far
+    std::uint64_t moved_bytes = 0;
+};
+
+// Suballocates a few large immutable GL buffers ("blocks") instead of creating one buffer per user.
+// Every block is managed by a two-level segregated fit allocator: free ranges are binned by size in
+// power of two classes split into sl_count linear steps, and two bitmaps find the smallest non-empty
+// bin that fits in constant time. Freed ranges merge with free neighbours right away. Blocks are
+// created when no block has room and released once they are empty (the first remaining block stays).
+// defragment() moves relocatable allocations into the lowest free ranges with GPU copies, so the
+// last blocks drain and can be released. GL thread only.
+class Gpu_Arena
+{
+public:
+    typedef std::uint32_t Handle;       // 0 is no allocation
+
+    // called with the new range after an allocation was moved
+    typedef std::function<void(const Gpu_Range&)> Relocated;
+
+private:
+    static const GLsizeiptr granularity = 16;
+    static const int sl_bits = 4;
+    static const int sl_count = 1 << sl_bits;
+    static const int fl_count = 32;
+
+    struct Node                         // physical range of a block, free or used
+    {
+        GLintptr offset;
+        GLsizeiptr size;
+        std::uint32_t block;
+        std::uint32_t prev_physical;
+        std::uint32_t next_physical;
+        std::uint32_t prev_free;
+        std::uint32_t next_free;
+        Handle allocation;              // 0 while free
+    };
+
+    struct Allocation
+    {
+        std::uint32_t node;             // 0 while the slot is unused
+        GLsizeiptr size;                // as requested
+        GLsizeiptr alignment;
+        Relocated relocated;            // empty for allocations that must not move
+    };
+
+    struct Block
+    {
+        Gpu_Buffer buffer;              // empty for a released block slot
+        GLsizeiptr size;
+        std::size_t allocation_count;
+        std::uint32_t first;
+        std::uint32_t fl_bitmap;
+        std::uint32_t sl_bitmap[fl_count];
+        std::uint32_t heads[fl_count][sl_count];
+    };
+
+    GLsizeiptr block_size;
+    std::vector<Node> nodes;            // index 0 unused
+    std::vector<std::uint32_t> unused_nodes;
+    std::vector<Allocation> allocations;
+    std::vector<Handle> unused_allocations;
+    std::vector<Block> blocks;
+    std::uint64_t move_count;
+    std::uint64_t moved_bytes;
+
+    static void bin(GLsizeiptr size, int& fl, int& sl);
+    static GLsizeiptr padded_size(GLsizeiptr size, GLsizeiptr alignment);
+    static GLintptr align(GLintptr offset, GLsizeiptr alignment);
+
+    std::uint32_t new_node();
+    void insert_free(std::uint32_t node);
+    void remove_free(std::uint32_t node);
+    std::uint32_t find_free(Block& block, GLsizeiptr size);
+    std::uint32_t take(std::uint32_t free_node, GLsizeiptr size, Handle allocation);
+    void release(std::uint32_t node);
+    std::uint32_t add_block(GLsizeiptr size);
+    void release_block(std::uint32_t block);
+
+public:
+    // blocks have block_size bytes unless a single allocation needs more
+    explicit Gpu_Arena(GLsizeiptr block_size = 64 << 20);
+
+    Gpu_Arena(const Gpu_Arena&) = delete;
+    Gpu_Arena& operator=(const Gpu_Arena&) = delete;
+
+    // Reserves size bytes whose offset is a multiple of alignment (any positive value, e.g. a vertex
+    // stride). Allocations with a relocated callback may be moved by defragment().
+    Handle allocate(GLsizeiptr size, GLsizeiptr alignment = 4, Relocated relocated = Relocated());
+    void free(Handle allocation);
+
+    Gpu_Range range(Handle allocation) const;
+
+    // Moves allocations from the end of the arena into lower free ranges until about max_bytes were
+    // copied; returns the bytes copied. The copies are queued on the GL command stream, so draws issued
+    // afterwards already see the data at its new place.
+    GLsizeiptr defragment(GLsizeiptr max_bytes);
+
+    Gpu_Arena_Statistics statistics() const;
+
+    // Arena shared by every mesh of the process for one kind of data; created on first use and
+    // destroyed with the last mesh (or other holder) that uses it.
+    static std::shared_ptr<Gpu_Arena> shared(Gpu_Arena_Kind kind);
+};
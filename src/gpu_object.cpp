@@ -0,0 +1,115 @@
+#include "gpu_object.hpp"
+
+#include <deque>
+#include <vector>
+
+namespace
+{
+    struct Released
+    {
+        Gpu_Object_Type type;
+        GLuint name;
+    };
+
+    struct Released_Frame
+    {
+        GLsync fence;
+        std::vector<Released> objects;
+    };
+
+    std::vector<Released> current;              // released while the current frame is recorded
+    std::deque<Released_Frame> frames;          // oldest first
+    Gpu_Object_Statistics stats = {};
+
+    void destroy(const Released& object)
+    {
+        switch (object.type)
+        {
+            case GPU_OBJECT_BUFFER:         glDeleteBuffers(1, &object.name); break;
+            case GPU_OBJECT_VERTEX_ARRAY:   glDeleteVertexArrays(1, &object.name); break;
+            case GPU_OBJECT_SHADER:         glDeleteShader(object.name); break;
+            case GPU_OBJECT_PROGRAM:        glDeleteProgram(object.name); break;
+            default: break;
+        }
+
+        stats.pending--;
+        stats.deleted++;
+    }
+
+    void destroy_frame(Released_Frame& frame)
+    {
+        for (const Released& object : frame.objects) destroy(object);
+        if (frame.fence) glDeleteSync(frame.fence);
+    }
+}
+
+namespace gpu_objects
+{
+    GLuint create(Gpu_Object_Type type, GLenum shader_type)
+    {
+        GLuint name = 0;
+
+        switch (type)
+        {
+            case GPU_OBJECT_BUFFER:         glCreateBuffers(1, &name); break;
+            case GPU_OBJECT_VERTEX_ARRAY:   glCreateVertexArrays(1, &name); break;
+            case GPU_OBJECT_SHADER:         name = glCreateShader(shader_type); break;
+            case GPU_OBJECT_PROGRAM:        name = glCreateProgram(); break;
+            default: break;
+        }
+
+        if (name) stats.live[type]++;
+        return name;
+    }
+
+    void release(Gpu_Object_Type type, GLuint name, GLsizeiptr bytes)
+    {
+        current.push_back({ type, name });
+
+        stats.live[type]--;
+        stats.bytes[type] -= bytes;
+        stats.pending++;
+    }
+
+    void resized(Gpu_Object_Type type, GLsizeiptr old_bytes, GLsizeiptr new_bytes)
+    {
+        stats.bytes[type] += new_bytes - old_bytes;
+    }
+
+    void end_frame()
+    {
+        if (!current.empty())
+        {
+            Released_Frame frame;
+            frame.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            frame.objects.swap(current);
+            frames.push_back(std::move(frame));
+        }
+
+        // fences signal in order, so the first one that has not bounds what can go
+        while (!frames.empty())
+        {
+            Released_Frame& frame = frames.front();
+            if (frame.fence && glClientWaitSync(frame.fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+
+            destroy_frame(frame);
+            frames.pop_front();
+        }
+    }
+
+    void flush()
+    {
+        glFinish();
+
+        for (Released_Frame& frame : frames) destroy_frame(frame);
+        frames.clear();
+
+        for (const Released& object : current) destroy(object);
+        current.clear();
+    }
+
+    Gpu_Object_Statistics statistics()
+    {
+        return stats;
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+enum Gpu_Object_Type
+{
+    GPU_OBJECT_BUFFER,
+    GPU_OBJECT_VERTEX_ARRAY,
+    GPU_OBJECT_SHADER,
+    GPU_OBJECT_PROGRAM,
+    GPU_OBJECT_TYPE_COUNT
+};
+
+struct Gpu_Object_Statistics
+{
+    std::size_t live[GPU_OBJECT_TYPE_COUNT];    // created and not released yet
+    GLsizeiptr bytes[GPU_OBJECT_TYPE_COUNT];    // storage of the live objects, as far as it was recorded
+    std::size_t pending;                        // released, waiting for the GPU to finish with them
+    std::size_t deleted;                        // since start
+};
+
+// Owned GL objects are not deleted when their owner lets go of them: the name is queued with the frame
+// it was released in and only handed to glDelete* once a fence placed after that frame's commands has
+// signaled, so the driver never has to block on (or keep alive) an object the GPU is still reading.
+// GL thread only.
+namespace gpu_objects
+{
+    GLuint create(Gpu_Object_Type type, GLenum shader_type = 0);
+    void release(Gpu_Object_Type type, GLuint name, GLsizeiptr bytes);
+    void resized(Gpu_Object_Type type, GLsizeiptr old_bytes, GLsizeiptr new_bytes);
+
+    // once per frame, after its commands were issued: fences this frame's releases and deletes the
+    // objects of earlier frames the GPU is done with
+    void end_frame();
+
+    // waits for the GPU and deletes everything released so far; before the context is destroyed
+    void flush();
+
+    Gpu_Object_Statistics statistics();
+}
+
+// Move-only owner of one GL object name; releasing it goes through the deferred deletion queue.
+template <Gpu_Object_Type type>
+class Gpu_Handle
+{
+private:
+    GLuint name;
+    GLsizeiptr bytes;
+
+    explicit Gpu_Handle(GLuint name) : name(name), bytes(0) {}
+
+public:
+    Gpu_Handle() : name(0), bytes(0) {}
+    ~Gpu_Handle() { reset(); }
+
+    Gpu_Handle(Gpu_Handle&& other) : name(other.name), bytes(other.bytes)
+    {
+        other.name = 0;
+        other.bytes = 0;
+    }
+
+    Gpu_Handle& operator=(Gpu_Handle&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            name = other.name;
+            bytes = other.bytes;
+            other.name = 0;
+            other.bytes = 0;
+        }
+        return *this;
+    }
+
+    Gpu_Handle(const Gpu_Handle&) = delete;
+    Gpu_Handle& operator=(const Gpu_Handle&) = delete;
+
+    // shader_type (GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, ...) for shader objects only
+    static Gpu_Handle create(GLenum shader_type = 0)
+    {
+        return Gpu_Handle(gpu_objects::create(type, shader_type));
+    }
+
+    void reset()
+    {
+        if (name) gpu_objects::release(type, name, bytes);
+        name = 0;
+        bytes = 0;
+    }
+
+    // storage the object holds, for the statistics (buffers)
+    void set_size(GLsizeiptr size)
+    {
+        gpu_objects::resized(type, bytes, size);
+        bytes = size;
+    }
+
+    GLuint get() const { return name; }
+    operator GLuint() const { return name; }
+};
+
+typedef Gpu_Handle<GPU_OBJECT_BUFFER> Gpu_Buffer;
+typedef Gpu_Handle<GPU_OBJECT_VERTEX_ARRAY> Gpu_Vertex_Array;
+typedef Gpu_Handle<GPU_OBJECT_SHADER> Gpu_Shader;
+typedef Gpu_Handle<GPU_OBJECT_PROGRAM> Gpu_Program;
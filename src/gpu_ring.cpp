@@ -0,0 +1,106 @@
+#include "gpu_ring.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+Gpu_Ring::Gpu_Ring(GLsizeiptr frame_size, int frames_in_flight)
+: mapping(nullptr), frame_size(frame_size), frames_in_flight(frames_in_flight), fences{}, frame(0), used(0),
+  peak(0), frame_count(0), waits(0)
+{
+    if (frame_size < 1 || frames_in_flight < 2 || frames_in_flight > 8)
+    {
+        throw std::runtime_error(fmt::format("Invalid ring buffer of {} frames of {} bytes", frames_in_flight, frame_size));
+    }
+
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLsizeiptr size = frame_size * frames_in_flight;
+
+    buffer = Gpu_Buffer::create();
+    glNamedBufferStorage(buffer, size, nullptr, flags);
+    mapping = static_cast<GLubyte*>(glMapNamedBufferRange(buffer, 0, size, flags));
+    buffer.set_size(size);
+
+    if (!mapping)
+    {
+        throw std::runtime_error("Failed to map the ring buffer");
+    }
+}
+
+Gpu_Ring::~Gpu_Ring()
+{
+    for (GLsync fence : fences)
+    {
+        if (fence) glDeleteSync(fence);
+    }
+}
+
+void Gpu_Ring::begin_frame()
+{
+    GLsync& fence = fences[frame];
+    if (!fence) return;
+
+    // the first check flushes, so the fence is sure to signal eventually
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED)
+    {
+        waits++;
+        while ((result = glClientWaitSync(fence, 0, 1000000)) == GL_TIMEOUT_EXPIRED);
+    }
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void Gpu_Ring::end_frame()
+{
+    if (used > 0)
+    {
+        fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    frame = (frame + 1) % frames_in_flight;
+    used = 0;
+    frame_count++;
+}
+
+Gpu_Ring_Allocation Gpu_Ring::allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    GLsizeiptr base = GLsizeiptr(frame) * frame_size;
+    GLsizeiptr offset = (base + used + alignment - 1) / alignment * alignment;
+
+    if (size < 0 || alignment < 1 || offset + size > base + frame_size)
+    {
+        throw std::runtime_error(fmt::format("Ring buffer frame of {} bytes cannot hold {} more bytes ({} used)", frame_size, size, used));
+    }
+
+    used = offset + size - base;
+    peak = std::max(peak, used);
+
+    Gpu_Ring_Allocation allocation;
+    allocation.buffer = buffer;
+    allocation.offset = offset;
+    allocation.size = size;
+    allocation.data = mapping + offset;
+    return allocation;
+}
+
+Gpu_Ring_Allocation Gpu_Ring::write(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+    Gpu_Ring_Allocation allocation = allocate(size, alignment);
+    std::memcpy(allocation.data, data, std::size_t(size));
+    return allocation;
+}
+
+Gpu_Ring_Statistics Gpu_Ring::statistics() const
+{
+    Gpu_Ring_Statistics statistics;
+    statistics.frame_size = frame_size;
+    statistics.used = used;
+    statistics.peak = peak;
+    statistics.frames = frame_count;
+    statistics.waits = waits;
+    return statistics;
+}
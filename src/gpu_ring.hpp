@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "gpu_object.hpp"
+
+// part of the ring written this frame
+struct Gpu_Ring_Allocation
+{
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+    GLsizeiptr size = 0;
+    void* data = nullptr;       // persistently mapped and coherent: written data needs no flush
+};
+
+struct Gpu_Ring_Statistics
+{
+    GLsizeiptr frame_size = 0;
+    GLsizeiptr used = 0;            // this frame so far
+    GLsizeiptr peak = 0;            // most used by any frame
+    std::uint64_t frames = 0;
+    std::uint64_t waits = 0;        // frames that had to wait for the GPU to release their region
+};
+
+// Per-frame dynamic data (uniforms, streamed vertices, indirect commands) in one persistently mapped
+// buffer split into frames_in_flight regions. Every frame allocates from its own region front to back;
+// end_frame() fences it and moves on to the next, and begin_frame() waits for that region's fence from
+// frames_in_flight frames ago, so the CPU never writes memory the GPU may still read and the driver
+// never has to orphan or synchronize a buffer. GL thread only.
+class Gpu_Ring
+{
+private:
+    Gpu_Buffer buffer;
+    GLubyte* mapping;
+    GLsizeiptr frame_size;
+    int frames_in_flight;
+
+    GLsync fences[8];
+    int frame;                  // region written this frame
+    GLsizeiptr used;
+
+    GLsizeiptr peak;
+    std::uint64_t frame_count;
+    std::uint64_t waits;
+
+public:
+    // frames_in_flight from 2 to 8
+    explicit Gpu_Ring(GLsizeiptr frame_size, int frames_in_flight = 3);
+    ~Gpu_Ring();
+
+    Gpu_Ring(const Gpu_Ring&) = delete;
+    Gpu_Ring& operator=(const Gpu_Ring&) = delete;
+
+    // before the first allocation of a frame; blocks only while the GPU is frames_in_flight frames behind
+    void begin_frame();
+
+    // after the last command of the frame that reads from the ring
+    void end_frame();
+
+    // size bytes at an offset that is a multiple of alignment (any positive value, e.g. a vertex stride
+    // or GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT); throws when the frame's region is exhausted
+    Gpu_Ring_Allocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    // allocates and copies size bytes of data
+    Gpu_Ring_Allocation write(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    GLuint name() const { return buffer; }
+    Gpu_Ring_Statistics statistics() const;
+};
@@ -0,0 +1,359 @@
+#include "inflate.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+    const std::uint16_t length_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    const std::uint8_t length_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    const std::uint16_t distance_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    const std::uint8_t distance_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    [[noreturn]] void corrupt(const char* what)
+    {
+        throw std::runtime_error(std::string("Corrupt deflate stream: ") + what);
+    }
+
+    // least significant bit first, refilled a byte at a time into a 64-bit buffer
+    struct Bit_Reader
+    {
+        const std::uint8_t* p;
+        const std::uint8_t* end;
+        std::uint64_t bits = 0;
+        int count = 0;
+        int overrun = 0;    // zero bytes fed in past the end of the input
+
+        Bit_Reader(const std::uint8_t* p, const std::uint8_t* end) : p(p), end(end) {}
+
+        void refill()
+        {
+            while (count <= 56)
+            {
+                if (p < end)
+                {
+                    bits |= std::uint64_t(*p++) << count;
+                }
+                else if (++overrun > 8)
+                {
+                    corrupt("unexpected end of input");
+                }
+                count += 8;
+            }
+        }
+
+        std::uint32_t read(int n)
+        {
+            if (count < n) refill();
+            std::uint32_t value = std::uint32_t(bits & ((std::uint64_t(1) << n) - 1));
+            bits >>= n;
+            count -= n;
+            return value;
+        }
+
+        // drops the bits of the current byte and returns the position of the next whole byte
+        const std::uint8_t* align()
+        {
+            bits >>= (count & 7);
+            count -= (count & 7);
+
+            const std::uint8_t* position = p - (count / 8 - overrun);
+            bits = 0;
+            count = 0;
+            overrun = 0;
+            return position;
+        }
+    };
+
+    // canonical huffman decoder; codes up to fast_bits long resolve with one table lookup
+    struct Huffman
+    {
+        static const int fast_bits = 10;
+
+        std::uint16_t fast[1 << fast_bits];   // (symbol << 4) | length, 0 when the code is longer
+        std::uint16_t counts[16];
+        std::uint16_t symbols[288];
+
+        void build(const std::uint8_t* lengths, int n)
+        {
+            std::memset(counts, 0, sizeof(counts));
+            std::memset(fast, 0, sizeof(fast));
+
+            for (int i = 0; i < n; ++i) counts[lengths[i]]++;
+            counts[0] = 0;
+
+            int left = 1;
+            for (int len = 1; len < 16; ++len)
+            {
+                left = (left << 1) - counts[len];
+                if (left < 0) corrupt("over-subscribed code");
+            }
+
+            std::uint16_t offsets[16];
+            offsets[1] = 0;
+            for (int len = 1; len < 15; ++len) offsets[len + 1] = std::uint16_t(offsets[len] + counts[len]);
+
+            for (int i = 0; i < n; ++i)
+            {
+                if (lengths[i]) symbols[offsets[lengths[i]]++] = std::uint16_t(i);
+            }
+
+            // fill the lookup table, with codes bit-reversed to match the stream order
+            int code = 0;
+            int index = 0;
+            for (int len = 1; len <= fast_bits; ++len)
+            {
+                for (int k = 0; k < counts[len]; ++k, ++code, ++index)
+                {
+                    int reversed = 0;
+                    for (int b = 0; b < len; ++b) reversed |= ((code >> b) & 1) << (len - 1 - b);
+
+                    for (int fill = reversed; fill < (1 << fast_bits); fill += (1 << len))
+                    {
+                        fast[fill] = std::uint16_t((symbols[index] << 4) | len);
+                    }
+                }
+                code <<= 1;
+            }
+        }
+
+        int decode(Bit_Reader& in) const
+        {
+            if (in.count < 16) in.refill();
+
+            std::uint16_t entry = fast[in.bits & ((1u << fast_bits) - 1)];
+            if (entry)
+            {
+                in.bits >>= (entry & 15);
+                in.count -= (entry & 15);
+                return entry >> 4;
+            }
+
+            // longer codes: walk the canonical code one bit at a time
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len < 16; ++len)
+            {
+                code |= int((in.bits >> (len - 1)) & 1);
+                int count = counts[len];
+
+                if (code - first < count)
+                {
+                    in.bits >>= len;
+                    in.count -= len;
+                    return symbols[index + code - first];
+                }
+
+                index += count;
+                first = (first + count) << 1;
+                code <<= 1;
+            }
+
+            corrupt("invalid code");
+        }
+    };
+
+    void build_fixed(Huffman& literals, Huffman& distances)
+    {
+        std::uint8_t lengths[288];
+        for (int i = 0; i < 144; ++i) lengths[i] = 8;
+        for (int i = 144; i < 256; ++i) lengths[i] = 9;
+        for (int i = 256; i < 280; ++i) lengths[i] = 7;
+        for (int i = 280; i < 288; ++i) lengths[i] = 8;
+        literals.build(lengths, 288);
+
+        for (int i = 0; i < 30; ++i) lengths[i] = 5;
+        distances.build(lengths, 30);
+    }
+
+    void build_dynamic(Bit_Reader& in, Huffman& literals, Huffman& distances)
+    {
+        static const std::uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+        int literal_count = int(in.read(5)) + 257;
+        int distance_count = int(in.read(5)) + 1;
+        int code_count = int(in.read(4)) + 4;
+
+        if (literal_count > 286 || distance_count > 30) corrupt("too many codes");
+
+        std::uint8_t lengths[286 + 30] = {};
+        for (int i = 0; i < code_count; ++i) lengths[order[i]] = std::uint8_t(in.read(3));
+
+        Huffman code_lengths;
+        code_lengths.build(lengths, 19);
+        std::memset(lengths, 0, 19);
+
+        for (int i = 0; i < literal_count + distance_count; )
+        {
+            int symbol = code_lengths.decode(in);
+
+            if (symbol < 16)
+            {
+                lengths[i++] = std::uint8_t(symbol);
+                continue;
+            }
+
+            int repeat;
+            std::uint8_t value = 0;
+
+            if (symbol == 16)
+            {
+                if (i == 0) corrupt("repeat without previous length");
+                value = lengths[i - 1];
+                repeat = 3 + int(in.read(2));
+            }
+            else if (symbol == 17)
+            {
+                repeat = 3 + int(in.read(3));
+            }
+            else
+            {
+                repeat = 11 + int(in.read(7));
+            }
+
+            if (i + repeat > literal_count + distance_count) corrupt("too many lengths");
+            while (repeat--) lengths[i++] = value;
+        }
+
+        if (lengths[256] == 0) corrupt("missing end of block code");
+
+        literals.build(lengths, literal_count);
+        distances.build(lengths + literal_count, distance_count);
+    }
+
+    std::uint32_t adler32(const std::uint8_t* data, std::size_t size)
+    {
+        std::uint32_t a = 1, b = 0;
+
+        while (size > 0)
+        {
+            // largest run that cannot overflow b before the modulo
+            std::size_t run = size < 5552 ? size : 5552;
+            size -= run;
+
+            while (run--)
+            {
+                a += *data++;
+                b += a;
+            }
+
+            a %= 65521;
+            b %= 65521;
+        }
+
+        return (b << 16) | a;
+    }
+}
+
+namespace inflate
+{
+    std::size_t raw(const void* src, std::size_t src_size, void* dst, std::size_t dst_size)
+    {
+        const std::uint8_t* input = static_cast<const std::uint8_t*>(src);
+        std::uint8_t* out = static_cast<std::uint8_t*>(dst);
+        std::uint8_t* out_end = out + dst_size;
+
+        Bit_Reader in(input, input + src_size);
+        Huffman literals, distances;
+
+        bool last;
+        do
+        {
+            last = in.read(1) != 0;
+            std::uint32_t type = in.read(2);
+
+            if (type == 0)
+            {
+                // stored block
+                const std::uint8_t* p = in.align();
+                if (in.end - p < 4) corrupt("truncated stored block");
+
+                std::size_t length = std::size_t(p[0] | (p[1] << 8));
+                std::size_t inverse = std::size_t(p[2] | (p[3] << 8));
+                p += 4;
+
+                if (length != (~inverse & 0xffff)) corrupt("stored block length mismatch");
+                if (std::size_t(in.end - p) < length) corrupt("truncated stored block");
+                if (std::size_t(out_end - out) < length) corrupt("output larger than expected");
+
+                std::memcpy(out, p, length);
+                out += length;
+                in.p = p + length;
+                continue;
+            }
+
+            if (type == 1) build_fixed(literals, distances);
+            else if (type == 2) build_dynamic(in, literals, distances);
+            else corrupt("invalid block type");
+
+            while (true)
+            {
+                int symbol = literals.decode(in);
+
+                if (symbol < 256)
+                {
+                    if (out == out_end) corrupt("output larger than expected");
+                    *out++ = std::uint8_t(symbol);
+                    continue;
+                }
+
+                if (symbol == 256) break;
+
+                symbol -= 257;
+                if (symbol >= 29) corrupt("invalid length code");
+
+                std::size_t length = length_base[symbol] + in.read(length_extra[symbol]);
+
+                int distance_symbol = distances.decode(in);
+                if (distance_symbol >= 30) corrupt("invalid distance code");
+
+                std::size_t distance = distance_base[distance_symbol] + in.read(distance_extra[distance_symbol]);
+
+                if (distance > std::size_t(out - static_cast<std::uint8_t*>(dst))) corrupt("distance too far back");
+                if (std::size_t(out_end - out) < length) corrupt("output larger than expected");
+
+                const std::uint8_t* from = out - distance;
+                if (distance >= length)
+                {
+                    std::memcpy(out, from, length);
+                    out += length;
+                }
+                else
+                {
+                    // overlapping copy repeats the last distance bytes
+                    while (length--) *out++ = *from++;
+                }
+            }
+        }
+        while (!last);
+
+        if (out != out_end) corrupt("output smaller than expected");
+
+        return std::size_t(in.align() - input);
+    }
+
+    void zlib(const void* src, std::size_t src_size, void* dst, std::size_t dst_size)
+    {
+        const std::uint8_t* input = static_cast<const std::uint8_t*>(src);
+
+        if (src_size < 6 || (input[0] & 0x0f) != 8 || ((input[0] << 8) | input[1]) % 31 != 0 || (input[1] & 0x20))
+        {
+            corrupt("invalid zlib header");
+        }
+
+        std::size_t consumed = 2 + raw(input + 2, src_size - 2, dst, dst_size);
+
+        if (src_size - consumed < 4)
+        {
+            corrupt("missing adler-32 checksum");
+        }
+
+        const std::uint8_t* trailer = input + consumed;
+        std::uint32_t expected = (std::uint32_t(trailer[0]) << 24) | (std::uint32_t(trailer[1]) << 16) | (std::uint32_t(trailer[2]) << 8) | trailer[3];
+
+        if (adler32(static_cast<const std::uint8_t*>(dst), dst_size) != expected)
+        {
+            corrupt("checksum mismatch");
+        }
+    }
+}
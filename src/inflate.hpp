@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// DEFLATE (RFC 1951) decompression for loaders whose formats embed compressed data. The output size
+// has to be known up front, as it is for FBX arrays; decoding stops with an error instead of growing
+// the output. Throws std::runtime_error on corrupt or truncated input.
+namespace inflate
+{
+    // raw deflate stream; returns the number of input bytes consumed
+    std::size_t raw(const void* src, std::size_t src_size, void* dst, std::size_t dst_size);
+
+    // deflate stream with zlib header and adler-32 trailer (RFC 1950)
+    void zlib(const void* src, std::size_t src_size, void* dst, std::size_t dst_size);
+}
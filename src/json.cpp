@@ -0,0 +1,271 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+class Json_Parser
+{
+private:
+    const char* begin;
+    const char* p;
+    const char* end;
+    int depth;
+
+    [[noreturn]] void fail(const char* what)
+    {
+        throw std::runtime_error(fmt::format("Malformed JSON at offset {}: {}", p - begin, what));
+    }
+
+    void skip_space()
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    void expect(const char* literal)
+    {
+        std::size_t length = std::strlen(literal);
+        if (std::size_t(end - p) < length || std::memcmp(p, literal, length) != 0) fail("unexpected token");
+        p += length;
+    }
+
+    static void append_utf8(std::string& out, unsigned long code)
+    {
+        if (code < 0x80)
+        {
+            out += char(code);
+        }
+        else if (code < 0x800)
+        {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    unsigned long hex4()
+    {
+        if (end - p < 4) fail("truncated escape");
+
+        unsigned long code = 0;
+        for (int i = 0; i < 4; ++i, ++p)
+        {
+            char c = *p;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= unsigned(c - '0');
+            else if (c >= 'a' && c <= 'f') code |= unsigned(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F') code |= unsigned(c - 'A' + 10);
+            else fail("invalid escape");
+        }
+        return code;
+    }
+
+    std::string parse_string()
+    {
+        ++p; // opening quote
+        std::string out;
+
+        while (true)
+        {
+            // copy runs without escapes in one go
+            const char* run = p;
+            while (p < end && *p != '"' && *p != '\\') ++p;
+            out.append(run, p);
+
+            if (p >= end) fail("unterminated string");
+            if (*p++ == '"') return out;
+
+            if (p >= end) fail("unterminated string");
+            switch (*p++)
+            {
+            case '"':  out += '"'; break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/'; break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u':
+            {
+                unsigned long code = hex4();
+                if (code >= 0xd800 && code < 0xdc00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+                {
+                    p += 2;
+                    unsigned long low = hex4();
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                append_utf8(out, code);
+                break;
+            }
+            default:
+                fail("invalid escape");
+            }
+        }
+    }
+
+    void parse_value(Json& value)
+    {
+        if (++depth > 512) fail("nesting too deep");
+
+        skip_space();
+        if (p >= end) fail("unexpected end");
+
+        switch (*p)
+        {
+        case '{':
+            value.type = JSON_TYPE_OBJECT;
+            ++p;
+            skip_space();
+
+            if (p < end && *p == '}')
+            {
+                ++p;
+                break;
+            }
+
+            while (true)
+            {
+                skip_space();
+                if (p >= end || *p != '"') fail("expected key");
+
+                value.members.emplace_back(parse_string(), Json());
+
+                skip_space();
+                if (p >= end || *p++ != ':') fail("expected ':'");
+
+                parse_value(value.members.back().second);
+
+                skip_space();
+                if (p >= end) fail("unexpected end");
+                if (*p == ',') { ++p; continue; }
+                if (*p == '}') { ++p; break; }
+                fail("expected ',' or '}'");
+            }
+            break;
+
+        case '[':
+            value.type = JSON_TYPE_ARRAY;
+            ++p;
+            skip_space();
+
+            if (p < end && *p == ']')
+            {
+                ++p;
+                break;
+            }
+
+            while (true)
+            {
+                value.elements.emplace_back();
+                parse_value(value.elements.back());
+
+                skip_space();
+                if (p >= end) fail("unexpected end");
+                if (*p == ',') { ++p; continue; }
+                if (*p == ']') { ++p; break; }
+                fail("expected ',' or ']'");
+            }
+            break;
+
+        case '"':
+            value.type = JSON_TYPE_STRING;
+            value.text = parse_string();
+            break;
+
+        case 't':
+            expect("true");
+            value.type = JSON_TYPE_BOOL;
+            value.boolean = true;
+            break;
+
+        case 'f':
+            expect("false");
+            value.type = JSON_TYPE_BOOL;
+            value.boolean = false;
+            break;
+
+        case 'n':
+            expect("null");
+            value.type = JSON_TYPE_NULL;
+            break;
+
+        default:
+        {
+            // strtod needs a terminated string; numbers are short, so copy the token
+            const char* start = p;
+            while (p < end && (std::strchr("+-.eE", *p) || (*p >= '0' && *p <= '9'))) ++p;
+            if (p == start || p - start > 63) fail("invalid number");
+
+            char token[64];
+            std::memcpy(token, start, std::size_t(p - start));
+            token[p - start] = '\0';
+
+            char* token_end;
+            value.type = JSON_TYPE_NUMBER;
+            value.number = std::strtod(token, &token_end);
+            if (token_end != token + (p - start)) fail("invalid number");
+            break;
+        }
+        }
+
+        --depth;
+    }
+
+public:
+    Json_Parser(const char* begin, const char* end) : begin(begin), p(begin), end(end), depth(0) {}
+
+    Json parse()
+    {
+        // byte order mark
+        if (end - p >= 3 && std::memcmp(p, "\xef\xbb\xbf", 3) == 0) p += 3;
+
+        Json root;
+        parse_value(root);
+
+        skip_space();
+        if (p != end) fail("trailing characters");
+        return root;
+    }
+};
+
+Json Json::parse(const char* begin, const char* end)
+{
+    return Json_Parser(begin, end).parse();
+}
+
+bool Json::has(const std::string& key) const
+{
+    return !(*this)[key].is_null();
+}
+
+const Json& Json::operator[](const std::string& key) const
+{
+    static const Json null_value;
+
+    for (const std::pair<std::string, Json>& member : members)
+    {
+        if (member.first == key) return member.second;
+    }
+    return null_value;
+}
+
+const Json& Json::operator[](std::size_t index) const
+{
+    static const Json null_value;
+    return index < elements.size() ? elements[index] : null_value;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+enum Json_Type
+{
+    JSON_TYPE_NULL,
+    JSON_TYPE_BOOL,
+    JSON_TYPE_NUMBER,
+    JSON_TYPE_STRING,
+    JSON_TYPE_ARRAY,
+    JSON_TYPE_OBJECT
+};
+
+// Read-only JSON document tree (RFC 8259). Lookups of missing keys or indices return a null value
+// instead of throwing, so optional properties can be read with defaults.
+class Json
+{
+private:
+    Json_Type type;
+    bool boolean;
+    double number;
+    std::string text;
+    std::vector<Json> elements;
+    std::vector<std::pair<std::string, Json>> members; // in document order
+
+    friend class Json_Parser;
+
+public:
+    Json() : type(JSON_TYPE_NULL), boolean(false), number(0.0) {}
+
+    // throws std::runtime_error on malformed input
+    static Json parse(const char* begin, const char* end);
+
+    Json_Type kind() const { return type; }
+    bool is_null() const { return type == JSON_TYPE_NULL; }
+    bool is_number() const { return type == JSON_TYPE_NUMBER; }
+    bool is_string() const { return type == JSON_TYPE_STRING; }
+    bool is_array() const { return type == JSON_TYPE_ARRAY; }
+    bool is_object() const { return type == JSON_TYPE_OBJECT; }
+
+    bool has(const std::string& key) const;
+    const Json& operator[](const std::string& key) const;
+    const Json& operator[](std::size_t index) const;
+    std::size_t size() const { return type == JSON_TYPE_ARRAY ? elements.size() : members.size(); }
+
+    const std::vector<Json>& array() const { return elements; }
+    const std::vector<std::pair<std::string, Json>>& object() const { return members; }
+
+    bool as_bool(bool fallback = false) const { return type == JSON_TYPE_BOOL ? boolean : fallback; }
+    double as_number(double fallback = 0.0) const { return type == JSON_TYPE_NUMBER ? number : fallback; }
+    long long as_integer(long long fallback = 0) const { return type == JSON_TYPE_NUMBER ? (long long)number : fallback; }
+    const std::string& as_string() const { return text; }
+};
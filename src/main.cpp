@@ -34,38 +34,41 @@ int main(int argc, char* argv[])
         glfwMakeContextCurrent(window);
         gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
 
-        Renderer renderer(window);
-        glfwSetWindowUserPointer(window, &renderer);
-
-        auto key_callback = [](GLFWwindow* window, int key, int scancode, int action, int mods)
-        {
-            Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
-            if (r) r->key_callback(window, key, scancode, action, mods);
-        };
-
-        auto cursor_pos_callback = [](GLFWwindow* window, double x, double y)
-        {
-            Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
-            if (r) r->cursor_pos_callback(window, x, y);
-        };
-
-        auto mouse_button_callback = [](GLFWwindow* window, int button, int action, int mods)
-        {
-            Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
-            if (r) r->mouse_button_callback(window, button, action, mods);
-        };
-
-        glfwSetKeyCallback(window, key_callback);
-        glfwSetCursorPosCallback(window, cursor_pos_callback);
-        glfwSetMouseButtonCallback(window, mouse_button_callback);
-
-        glfwSwapInterval(1);
-
-        while (!glfwWindowShouldClose(window))
+        // the renderer owns GL objects, so it goes away while the context still exists
         {
-            glfwPollEvents();         
-            renderer.update();
-            renderer.render();
+            Renderer renderer(window);
+            glfwSetWindowUserPointer(window, &renderer);
+
+            auto key_callback = [](GLFWwindow* window, int key, int scancode, int action, int mods)
+            {
+                Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
+                if (r) r->key_callback(window, key, scancode, action, mods);
+            };
+
+            auto cursor_pos_callback = [](GLFWwindow* window, double x, double y)
+            {
+                Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
+                if (r) r->cursor_pos_callback(window, x, y);
+            };
+
+            auto mouse_button_callback = [](GLFWwindow* window, int button, int action, int mods)
+            {
+                Renderer* r = (Renderer*)(glfwGetWindowUserPointer(window));
+                if (r) r->mouse_button_callback(window, button, action, mods);
+            };
+
+            glfwSetKeyCallback(window, key_callback);
+            glfwSetCursorPosCallback(window, cursor_pos_callback);
+            glfwSetMouseButtonCallback(window, mouse_button_callback);
+
+            glfwSwapInterval(1);
+
+            while (!glfwWindowShouldClose(window))
+            {
+                glfwPollEvents();         
+                renderer.update();
+                renderer.render();
+            }
         }
 
         glfwDestroyWindow(window);
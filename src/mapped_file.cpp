@@ -0,0 +1,90 @@
+#include "mapped_file.hpp"
+
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+
+Mapped_File::Mapped_File(const std::string& file_path)
+: bytes(nullptr), length(0), file_handle(INVALID_HANDLE_VALUE), mapping_handle(nullptr)
+{
+    file_handle = CreateFileA(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error(fmt::format("Cannot open file \"{}\" for mapping", file_path));
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file_handle, &file_size);
+    length = std::size_t(file_size.QuadPart);
+
+    if (length > 0)
+    {
+        mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        bytes = mapping_handle ? static_cast<const char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+        if (!bytes)
+        {
+            if (mapping_handle) CloseHandle(mapping_handle);
+            CloseHandle(file_handle);
+            throw std::runtime_error(fmt::format("Cannot map file \"{}\" into memory", file_path));
+        }
+    }
+}
+
+Mapped_File::~Mapped_File()
+{
+    if (bytes) UnmapViewOfFile(bytes);
+    if (mapping_handle) CloseHandle(mapping_handle);
+    if (file_handle != INVALID_HANDLE_VALUE) CloseHandle(file_handle);
+}
+
+#else
+
+Mapped_File::Mapped_File(const std::string& file_path)
+: bytes(nullptr), length(0), file_descriptor(-1)
+{
+    file_descriptor = open(file_path.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+    {
+        throw std::runtime_error(fmt::format("Cannot open file \"{}\" for mapping", file_path));
+    }
+
+    struct stat file_stat;
+    fstat(file_descriptor, &file_stat);
+    length = std::size_t(file_stat.st_size);
+
+    if (length > 0)
+    {
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+        if (mapping == MAP_FAILED)
+        {
+            close(file_descriptor);
+            throw std::runtime_error(fmt::format("Cannot map file \"{}\" into memory", file_path));
+        }
+
+        // the whole file is read front to back
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        bytes = static_cast<const char*>(mapping);
+    }
+}
+
+Mapped_File::~Mapped_File()
+{
+    if (bytes) munmap(const_cast<char*>(bytes), length);
+    if (file_descriptor >= 0) close(file_descriptor);
+}
+
+#endif
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The mapping is released when the object is destroyed.
+class Mapped_File
+{
+private:
+    const char* bytes;
+    std::size_t length;
+
+#ifdef _WIN32
+    void* file_handle;
+    void* mapping_handle;
+#else
+    int file_descriptor;
+#endif
+
+public:
+    explicit Mapped_File(const std::string& file_path);
+    ~Mapped_File();
+
+    Mapped_File(const Mapped_File&) = delete;
+    Mapped_File& operator=(const Mapped_File&) = delete;
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+};
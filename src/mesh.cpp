@@ -1,117 +1,676 @@
 #include "mesh.hpp"
+#include "shader.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
 
-#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
 #include <exception>
-#include <experimental/filesystem>
 
 #include <fmt/format.h>
-#define TINYOBJLOADER_IMPLEMENTATION
-#include <tiny_obj_loader.h>
 
-namespace fs = std::experimental::filesystem;
+namespace
+{
+    Mesh_Bounds bounds_of(const std::vector<GLfloat>& positions)
+    {
+        Mesh_Bounds bounds;
+        if (positions.empty()) return bounds;
+
+        bounds.min = bounds.max = glm::vec3(positions[0], positions[1], positions[2]);
+
+        for (std::size_t i = 0; i + 2 < positions.size(); i += 3)
+        {
+            glm::vec3 p(positions[i], positions[i + 1], positions[i + 2]);
+            bounds.min = glm::min(bounds.min, p);
+            bounds.max = glm::max(bounds.max, p);
+        }
+
+        return bounds;
+    }
+
+    // Assembled vertices pass through a block of about this size on their way into GPU memory; small
+    // enough to stay in the cache between the writer and the copy.
+    const GLsizeiptr assemble_block_size = 64 << 10;
+
+    // Large blobs (usually straight from a mapped file) are copied in pieces, so the driver never has to
+    // stage the whole blob at once and page faults overlap with the transfer of earlier pieces.
+    const GLsizeiptr upload_chunk_size = 4 << 20;
+
+    void buffer_sub_data(const Gpu_Range& range, const void* data)
+    {
+        const GLubyte* bytes = static_cast<const GLubyte*>(data);
+        for (GLsizeiptr offset = 0; offset < range.size; offset += upload_chunk_size)
+        {
+            glNamedBufferSubData(range.buffer, range.offset + offset, std::min(upload_chunk_size, range.size - offset), bytes + offset);
+        }
+    }
+}
+
+Mesh::Mesh(const Vertex_Format& format, const void* vertices, GLsizei vertex_count, const std::vector<GLuint>& indices, GLenum mode, GLenum usage, Mesh_Storage storage, GLbitfield optimize)
+: vertex_allocation(0), index_allocation(0), format(format), vertex_count(vertex_count), index_count(GLsizei(indices.size())), 
+  index_type(GL_UNSIGNED_INT), storage(storage), topology(mode), vertex_usage(usage)
+{
+    if (vertex_count < 1 || !vertices)
+    {
+        throw std::runtime_error("Cannot create a mesh without vertices");
+    }
+
+    if ((optimize != MESH_OPTIMIZE_NONE && topology == GL_TRIANGLES && !indices.empty()) || (optimize & MESH_OPTIMIZE_QUANTIZE))
+    {
+        // reordering works on a private copy; only paid for when an optimization is requested
+        const GLubyte* vertex_bytes = static_cast<const GLubyte*>(vertices);
+
+        Mesh_Data data;
+        data.format = format;
+        data.vertex_count = vertex_count;
+        data.vertices.assign(vertex_bytes, vertex_bytes + std::size_t(vertex_count) * format.stride);
+        data.indices = indices;
+        data.topology = topology;
+
+        prepare(data, optimize);
+        upload(data);
+        return;
+    }
+
+    submeshes.push_back({ 0, indices.empty() ? vertex_count : index_count, -1 });
+    bounds = bounds_of(mesh_optimizer::read_positions(format, vertices, vertex_count));
+
+    if (topology == GL_TRIANGLES && !indices.empty())
+    {
+        input_cache_stats = cache_stats = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+    }
+
+    if (storage == MESH_STORAGE_GPU_AND_CPU)
+    {
+        // one allocation and one copy for the whole mesh
+        const GLubyte* vertex_bytes = static_cast<const GLubyte*>(vertices);
+        this->vertices.assign(vertex_bytes, vertex_bytes + std::size_t(vertex_count) * format.stride);
+        this->indices = indices;
+    }
+
+    // upload straight from the caller's contiguous vertex block
+    create_buffers(vertices, indices);
+}
+
+Mesh::Mesh(Mesh_Data&& data, GLenum usage, Mesh_Storage storage, GLbitfield optimize)
+: vertex_allocation(0), index_allocation(0), format(data.format), vertex_count(data.vertex_count), index_count(0),
+  index_type(GL_UNSIGNED_INT), storage(storage), topology(data.topology), vertex_usage(usage)
+{
+    prepare(data, optimize);
+    upload(data);
+}
+
+Mesh::Mesh(const Vertex_Format& format, GLenum mode, GLenum usage, Mesh_Storage storage)
+: vertex_allocation(0), index_allocation(0), format(format), vertex_count(0), index_count(0),
+  index_type(GL_UNSIGNED_INT), storage(storage), topology(mode), vertex_usage(usage)
+{
+}
+
+Mesh::Mesh(Mesh_Cache_View& view, GLenum usage, Mesh_Storage storage, bool upload_contents)
+: vertex_allocation(0), index_allocation(0), format(view.format), vertex_count(view.vertex_count), index_count(view.index_count),
+  index_type(view.index_type), storage(storage), submeshes(std::move(view.submeshes)), materials(std::move(view.materials)),
+  lods(std::move(view.lods)), meshlets(std::move(view.meshlets)), bounds(view.bounds), input_cache_stats(view.input_cache_stats), cache_stats(view.cache_stats), topology(view.topology),
+  vertex_usage(usage)
+{
+    if (index_count > 0 && !submeshes.empty())
+    {
+        index_count = submeshes.back().first + submeshes.back().count;
+    }
+
+    if (upload_contents)
+    {
+        create_buffers(view.vertices, view.indices, view.index_bytes);
+    }
+    else
+    {
+        create_buffers(nullptr, nullptr, view.index_bytes);
+    }
+}
+
+Mesh::Mesh(const Vertex_Format& format, GLsizei vertex_count, const std::vector<GLuint>& indices, GLenum mode, GLenum usage, Mesh_Storage storage)
+: vertex_allocation(0), index_allocation(0), format(format), vertex_count(vertex_count), index_count(GLsizei(indices.size())), 
+  index_type(GL_UNSIGNED_INT), storage(storage), topology(mode), vertex_usage(usage)
+{
+    if (vertex_count < 1)
+    {
+        throw std::runtime_error("Cannot create a mesh without vertices");
+    }
+
+    submeshes.push_back({ 0, indices.empty() ? vertex_count : index_count, -1 });
+
+    // only the indices are known up front; the bounds follow once the vertices were written
+    if (topology == GL_TRIANGLES && !indices.empty())
+    {
+        input_cache_stats = cache_stats = mesh_optimizer::analyze_vertex_cache(indices, vertex_count);
+    }
+
+    if (storage == MESH_STORAGE_GPU_AND_CPU)
+    {
+        // vertices are written into the CPU copy and uploaded from there
+        this->vertices.resize(std::size_t(vertex_count) * format.stride);
+        this->indices = indices;
+    }
+
+    // allocate vertex storage only; the contents are streamed in through write_vertices()
+    create_buffers(nullptr, indices);
+}
+
+void Mesh::prepare(Mesh_Data& data, GLbitfield optimize)
+{
+    if (data.vertex_count < 1 || data.vertices.size() < std::size_t(data.vertex_count) * data.format.stride)
+    {
+        throw std::runtime_error("Cannot create a mesh without vertices");
+    }
+
+    if (data.submeshes.empty())
+    {
+        data.submeshes.push_back({ 0, data.indices.empty() ? data.vertex_count : GLsizei(data.indices.size()), -1 });
+    }
+
+    std::vector<GLfloat> positions = mesh_optimizer::read_positions(data.format, data.vertices.data(), data.vertex_count);
+    // unreferenced vertices count too; they are rare and harmless for culling
+    data.bounds = bounds_of(positions);
+    data.lods.clear();
+    data.meshlets.clear();
+
+    if (data.topology == GL_TRIANGLES && !data.indices.empty())
+    {
+        data.input_cache_stats = mesh_optimizer::analyze_vertex_cache(data.indices, data.vertex_count);
+
+        // triangles are only reordered within their submesh so every material stays one contiguous range
+        if (optimize & (MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW))
+        {
+            for (const Submesh& submesh : data.submeshes)
+            {
+                std::vector<GLuint> range(data.indices.begin() + submesh.first, data.indices.begin() + submesh.first + submesh.count);
+                mesh_optimizer::optimize_vertex_cache(range, data.vertex_count);
+
+                if ((optimize & MESH_OPTIMIZE_OVERDRAW) && !positions.empty())
+                {
+                    mesh_optimizer::optimize_overdraw(range, positions.data(), 3 * sizeof(GLfloat), data.vertex_count);
+                }
+
+                std::copy(range.begin(), range.end(), data.indices.begin() + submesh.first);
+            }
+        }
+
+        if ((optimize & MESH_OPTIMIZE_MESHLETS) && !positions.empty())
+        {
+            for (const Submesh& submesh : data.submeshes)
+            {
+                std::vector<GLuint> range(data.indices.begin() + submesh.first, data.indices.begin() + submesh.first + submesh.count);
+                std::vector<Meshlet> meshlets = mesh_optimizer::build_meshlets(range, positions.data(), data.vertex_count);
+
+                for (Meshlet& meshlet : meshlets)
+                {
+                    meshlet.first += submesh.first;
+                }
+
+                std::copy(range.begin(), range.end(), data.indices.begin() + submesh.first);
+                data.meshlets.insert(data.meshlets.end(), meshlets.begin(), meshlets.end());
+            }
+        }
+
+        if ((optimize & MESH_OPTIMIZE_LOD_CHAIN) && !positions.empty())
+        {
+            build_lods(data, positions);
+        }
+
+        // the levels share the vertex buffer, so their indices are renumbered along with the full detail ones
+        if (optimize & MESH_OPTIMIZE_VERTEX_FETCH)
+        {
+            data.vertex_count = mesh_optimizer::optimize_vertex_fetch(data.vertices.data(), data.vertex_count, data.format.stride, data.indices);
+            data.vertices.resize(std::size_t(data.vertex_count) * data.format.stride);
+        }
+
+        const Submesh& last = data.submeshes.back();
+        std::vector<GLuint> full_detail(data.indices.begin(), data.indices.begin() + last.first + last.count);
+        data.cache_stats = mesh_optimizer::analyze_vertex_cache(full_detail, data.vertex_count);
+
+        // meshlets are triangle list ranges
+        if ((optimize & MESH_OPTIMIZE_TRIANGLE_STRIPS) && data.meshlets.empty())
+        {
+            build_strips(data);
+        }
+    }
+
+    // last, as everything above reads float attributes
+    if (optimize & MESH_OPTIMIZE_QUANTIZE)
+    {
+        quantize(data);
+    }
+}
+
+void Mesh::build_lods(Mesh_Data& data, const std::vector<GLfloat>& positions)
+{
+    // each level halves the triangles of the previous one until simplification stops paying off
+    const std::size_t max_levels = 8;
+    const float min_reduction = 0.85f;
+
+    const glm::vec3 size = data.bounds.max - data.bounds.min;
+    const GLfloat extent = std::max(size.x, std::max(size.y, size.z));
+
+    // normals and texcoords steer the collapses, so shading seams and uv stretch are kept in check
+    std::vector<GLfloat> attributes;
+    GLsizei attribute_count = 0;
+    {
+        std::vector<GLfloat> normals = mesh_optimizer::read_attribute(data.format, data.vertices.data(), data.vertex_count, "normal", 3);
+        std::vector<GLfloat> texcoords = mesh_optimizer::read_attribute(data.format, data.vertices.data(), data.vertex_count, "texcoord", 2);
+        attribute_count = GLsizei(normals.size() + texcoords.size()) / data.vertex_count;
+        attributes.reserve(normals.size() + texcoords.size());
+
+        for (GLsizei v = 0; v < data.vertex_count && attribute_count > 0; ++v)
+        {
+            if (!normals.empty()) attributes.insert(attributes.end(), &normals[v * 3], &normals[v * 3] + 3);
+            if (!texcoords.empty()) attributes.insert(attributes.end(), &texcoords[v * 2], &texcoords[v * 2] + 2);
+        }
+    }
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, GLenum mode, GLenum usage)
-: vertices(vertices), indices(std::vector<GLuint>()), topology(mode), vertex_usage(usage)
+    // every level is simplified from the previous one, submesh by submesh with locked borders, so
+    // materials stay separate ranges and no cracks open up between them
+    std::vector<std::vector<GLuint>> ranges;
+    for (const Submesh& submesh : data.submeshes)
+    {
+        ranges.emplace_back(data.indices.begin() + submesh.first, data.indices.begin() + submesh.first + submesh.count);
+    }
+
+    std::size_t previous_count = data.submeshes.back().first + data.submeshes.back().count;
+    GLfloat error = 0.0f;
+
+    for (std::size_t level = 0; level < max_levels; ++level)
+    {
+        Mesh_Lod lod;
+        lod.error = error;
+        std::size_t count = 0;
+
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            float range_error = 0.0f;
+            std::size_t target = ranges[i].size() / 6 * 3;
+            ranges[i] = mesh_optimizer::simplify(ranges[i], positions.data(), data.vertex_count, target, 1.0f, true,
+                                                 attribute_count ? attributes.data() : nullptr, attribute_count, 0.01f, &range_error);
+            mesh_optimizer::optimize_vertex_cache(ranges[i], data.vertex_count);
+
+            // simplified from the previous level, so the deviations add up
+            lod.error = std::max(lod.error, error + range_error * extent);
+            count += ranges[i].size();
+        }
+
+        if (count == 0 || count > previous_count * min_reduction) break;
+
+        for (std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            lod.submeshes.push_back({ GLsizei(data.indices.size()), GLsizei(ranges[i].size()), data.submeshes[i].material });
+            data.indices.insert(data.indices.end(), ranges[i].begin(), ranges[i].end());
+        }
+
+        error = lod.error;
+        previous_count = count;
+        data.lods.push_back(std::move(lod));
+    }
+}
+
+void Mesh::quantize(Mesh_Data& data)
 {
-	// assemble vertex data
-	std::vector<GLfloat> data = Vertex::assemble(vertices);
+    // the layouts the loaders produce and their packed counterparts, attribute for attribute
+    const std::pair<const Vertex_Format*, const Vertex_Format*> layouts[] =
+    {
+        { &Vertex_Position::format(), &Vertex_Packed_Position::format() },
+        { &Vertex_Position_Color::format(), &Vertex_Packed_Position_Color::format() },
+        { &Vertex_Position_Texcoord::format(), &Vertex_Packed_Position_Texcoord::format() },
+        { &Vertex_Position_Normal::format(), &Vertex_Packed_Position_Normal::format() },
+        { &Vertex_Position_Normal_Texcoord::format(), &Vertex_Packed_Position_Normal_Texcoord::format() }
+    };
+
+    auto layout = std::find_if(std::begin(layouts), std::end(layouts), [&data](const std::pair<const Vertex_Format*, const Vertex_Format*>& l)
+    {
+        return l.first->attribs == data.format.attribs;
+    });
+    if (layout == std::end(layouts))
+    {
+        return;
+    }
+
+    const Vertex_Format& packed = *layout->second;
+    const std::size_t count = std::size_t(data.vertex_count);
+
+    std::vector<std::vector<GLfloat>> values(packed.attrib_count);
+    for (GLuint i = 0; i < packed.attrib_count; ++i)
+    {
+        const Vertex_Attrib& from = data.format.attribs[i];
+        const Vertex_Attrib& to = packed.attribs[i];
 
-	// generate vertex array object
-	glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+        // colors gain an opaque alpha
+        GLint components = (to.type == GL_UNSIGNED_BYTE) ? to.size : from.size;
+        values[i] = mesh_optimizer::read_attribute(data.format, data.vertices.data(), data.vertex_count, from.name, components);
+        if (components > from.size)
+        {
+            for (std::size_t v = 0; v < count; ++v) values[i][v * components + 3] = 1.0f;
+        }
 
-	// create vertex buffer
-    GLuint vertex_buffer;
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), &data.front(), vertex_usage);
+        // values the packed type cannot hold (tiled texcoords, huge scenes) keep the mesh in floats
+        GLfloat low = (to.type == GL_HALF_FLOAT) ? -65504.0f : (to.type == GL_INT_2_10_10_10_REV) ? -1.0f : 0.0f;
+        GLfloat high = (to.type == GL_HALF_FLOAT) ? 65504.0f : 1.0f;
+        if (std::any_of(values[i].begin(), values[i].end(), [low, high](GLfloat value) { return !(value >= low && value <= high); }))
+        {
+            return;
+        }
+    }
 
-	// configure vertex attributes
-	for (Vertex_Attrib attrib : vertices.front().attribs)
-	{
-		glEnableVertexAttribArray(attrib.index);
-    	glVertexAttribPointer(attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.stride, (void*)(attrib.offset * sizeof(GLfloat)));
-	}
+    std::vector<GLubyte> vertices(count * packed.stride, 0);
+    for (GLuint i = 0; i < packed.attrib_count; ++i)
+    {
+        const Vertex_Attrib& to = packed.attribs[i];
+        GLubyte* out = vertices.data() + to.offset;
+        GLsizei components = GLsizei(values[i].size() / count);
 
-    glBindVertexArray(0);
+        switch (to.type)
+        {
+            case GL_HALF_FLOAT:          vertex_encode::half(values[i].data(), components, count, out, packed.stride); break;
+            case GL_INT_2_10_10_10_REV:  vertex_encode::int_2_10_10_10(values[i].data(), count, out, packed.stride); break;
+            case GL_UNSIGNED_SHORT:      vertex_encode::unorm16(values[i].data(), components, count, out, packed.stride); break;
+            case GL_UNSIGNED_BYTE:       vertex_encode::unorm8(values[i].data(), components, count, out, packed.stride); break;
+            default: break;
+        }
+    }
+
+    data.format = packed;
+    data.vertices = std::move(vertices);
+
+    // rounded positions; the bounds have to contain what is drawn
+    data.bounds = bounds_of(mesh_optimizer::read_positions(data.format, data.vertices.data(), data.vertex_count));
 }
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<GLuint>& indices, GLenum mode, GLenum usage)
-: vertices(vertices), indices(indices), topology(mode), vertex_usage(usage)
+void Mesh::build_strips(Mesh_Data& data)
 {
-	// assemble vertex data
-	std::vector<GLfloat> data = Vertex::assemble(vertices);
+    // consecutive submeshes of a level are drawn as one range, so their strips are kept apart by a restart
+    std::vector<GLuint> strips;
+
+    auto convert = [&](std::vector<Submesh>& submeshes)
+    {
+        bool first = true;
+        for (Submesh& submesh : submeshes)
+        {
+            std::vector<GLuint> range(data.indices.begin() + submesh.first, data.indices.begin() + submesh.first + submesh.count);
+            std::vector<GLuint> strip = mesh_optimizer::build_triangle_strips(range, data.vertex_count);
 
-	// generate vertex array object
-	glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+            if (!first && !strip.empty()) strips.push_back(mesh_optimizer::restart_index);
+            first &= strip.empty();
 
-	// create vertex buffer
-    GLuint vertex_buffer;
-    glGenBuffers(1, &vertex_buffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
-    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(GLfloat), &data.front(), vertex_usage);
+            submesh.first = GLsizei(strips.size());
+            submesh.count = GLsizei(strip.size());
+            strips.insert(strips.end(), strip.begin(), strip.end());
+        }
+    };
 
-	// create index buffer
-    GLuint index_buffer;
-    glGenBuffers(1, &index_buffer);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices.front(), GL_STATIC_DRAW);
+    std::vector<Submesh> strip_submeshes = data.submeshes;
+    std::vector<Mesh_Lod> strip_lods = data.lods;
 
-	// configure vertex attributes
-	for (Vertex_Attrib attrib : vertices.front().attribs)
-	{
-		glEnableVertexAttribArray(attrib.index);
-    	glVertexAttribPointer(attrib.index, attrib.size, attrib.type, attrib.normalized, attrib.stride, (void*)(attrib.offset * sizeof(GLfloat)));
-	}
+    convert(strip_submeshes);
+    for (Mesh_Lod& lod : strip_lods)
+    {
+        convert(lod.submeshes);
+    }
 
-    glBindVertexArray(0);	
+    if (strips.size() < data.indices.size())
+    {
+        data.indices.swap(strips);
+        data.submeshes.swap(strip_submeshes);
+        data.lods.swap(strip_lods);
+        data.topology = GL_TRIANGLE_STRIP;
+    }
 }
 
-std::shared_ptr<Mesh> load_obj(const std::string& obj_file_path)
+GLsizei Mesh::select_lod(const glm::mat4& transform, const Lod_View& view) const
 {
-	if (!fs::exists(obj_file_path))
-	{
-		throw std::runtime_error(fmt::format("Failed to load mesh file \"obj_file_path\"; path does not exist"));
-	}
+    if (lods.empty()) return 0;
 
-	std::ifstream file(obj_file_path, std::ios::in);
-	if (!file.is_open())
-	{
-		throw std::runtime_error(fmt::format("Failed to read mesh file \"obj_file_path\"; permission denied or file is corrupt"));
-	}
+    // bounding sphere in world space; the largest axis scale bounds how much the errors grow
+    glm::vec3 center = glm::vec3(transform * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+    GLfloat scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+    GLfloat radius = glm::length(bounds.max - bounds.min) * 0.5f * scale;
 
+    GLfloat distance = glm::length(center - view.eye) - radius;
+    if (distance <= 0.0f) return 0;
 
+    GLsizei level = 0;
+    for (std::size_t i = 0; i < lods.size(); ++i)
+    {
+        if (lods[i].error * scale * view.projection_scale / distance > view.pixel_error) break;
+        level = GLsizei(i + 1);
+    }
+
+    return level;
 }
 
-std::shared_ptr<Mesh> load_fbx(const std::string& fbx_file_path)
+GLsizei Mesh::cull_meshlets(const glm::mat4& transform, const Cull_View& view, std::vector<std::pair<GLsizei, GLsizei>>& ranges) const
 {
-	if (!fs::exists(fbx_file_path))
-	{
-		throw std::runtime_error(fmt::format("Failed to load mesh file \"obj_file_path\"; path does not exist"));
-	}
+    // frustum planes of the clip matrix (Gribb and Hartmann), normalized for sphere distances
+    glm::vec4 planes[6];
+    const glm::mat4& m = view.view_projection;
+    for (int i = 0; i < 3; ++i)
+    {
+        glm::vec4 row(m[0][i], m[1][i], m[2][i], m[3][i]);
+        glm::vec4 w(m[0][3], m[1][3], m[2][3], m[3][3]);
+        planes[i * 2] = w + row;
+        planes[i * 2 + 1] = w - row;
+    }
+
+    for (glm::vec4& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    glm::vec3 scales(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+    GLfloat scale = std::max(scales.x, std::max(scales.y, scales.z));
+    bool cones = std::min(scales.x, std::min(scales.y, scales.z)) > scale * 0.99f && glm::determinant(glm::mat3(transform)) > 0.0f;
+
+    GLsizei visible = 0;
+    GLsizei range_end = -1;
+
+    for (const Meshlet& meshlet : meshlets)
+    {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(meshlet.center[0], meshlet.center[1], meshlet.center[2], 1.0f));
+        GLfloat radius = meshlet.radius * scale;
+
+        bool inside = true;
+        for (const glm::vec4& plane : planes)
+        {
+            inside &= glm::dot(glm::vec3(plane), center) + plane.w >= -radius;
+        }
+        if (!inside) continue;
+
+        if (cones && meshlet.cone_cutoff < 1.0f)
+        {
+            glm::vec3 axis = glm::normalize(glm::mat3(transform) * glm::vec3(meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2]));
+            glm::vec3 direction = center - view.eye;
 
-	std::ifstream file(fbx_file_path, std::ios::in);
-	if (!file.is_open())
-	{
-		throw std::runtime_error(fmt::format("Failed to read mesh file \"obj_file_path\"; permission denied or file is corrupt"));
-	}
+            if (glm::dot(direction, axis) >= meshlet.cone_cutoff * glm::length(direction) + radius) continue;
+        }
 
+        if (meshlet.first == range_end)
+        {
+            ranges.back().second += meshlet.count;
+        }
+        else
+        {
+            ranges.push_back(std::make_pair(meshlet.first, meshlet.count));
+        }
 
+        range_end = meshlet.first + meshlet.count;
+        visible++;
+    }
+
+    return visible;
+}
+
+std::pair<GLsizei, GLsizei> Mesh::lod_range(GLsizei level) const
+{
+    const std::vector<Submesh>& ranges = (level > 0) ? lods[level - 1].submeshes : submeshes;
+    GLsizei first = ranges.front().first;
+    return std::make_pair(first, ranges.back().first + ranges.back().count - first);
 }
 
-std::shared_ptr<Mesh> load_gltf(const std::string& gltf_file_path)
+void Mesh::upload(Mesh_Data& data)
 {
-	if (!fs::exists(gltf_file_path))
-	{
-		throw std::runtime_error(fmt::format("Failed to load mesh file \"obj_file_path\"; path does not exist"));
-	}
+    format = data.format;
+    vertex_count = data.vertex_count;
+    index_count = data.indices.empty() ? 0 : data.submeshes.back().first + data.submeshes.back().count;
+    topology = data.topology;
+    submeshes = data.submeshes;
+    materials = std::move(data.materials);
+    lods = std::move(data.lods);
+    meshlets = std::move(data.meshlets);
+    bounds = data.bounds;
+    input_cache_stats = data.input_cache_stats;
+    cache_stats = data.cache_stats;
 
-	std::ifstream file(gltf_file_path, std::ios::in);
-	if (!file.is_open())
-	{
-		throw std::runtime_error(fmt::format("Failed to read mesh file \"obj_file_path\"; permission denied or file is corrupt"));
-	}
+    create_buffers(data.vertices.data(), data.indices);
 
-	
+    if (storage == MESH_STORAGE_GPU_AND_CPU)
+    {
+        vertices = std::move(data.vertices);
+        indices = std::move(data.indices);
+    }
+}
+
+void Mesh::create_buffers(const void* vertex_data, const std::vector<GLuint>& indices)
+{
+    // the narrowest index type that can address every vertex
+    if (indices.empty())
+    {
+        create_buffers(vertex_data, nullptr, 0);
+    }
+    else if ((index_type = mesh_optimizer::index_type(vertex_count)) == GL_UNSIGNED_INT)
+    {
+        create_buffers(vertex_data, indices.data(), GLsizeiptr(indices.size() * sizeof(GLuint)));
+    }
+    else
+    {
+        std::vector<GLubyte> packed = mesh_optimizer::pack_indices(indices, index_type);
+        create_buffers(vertex_data, packed.data(), GLsizeiptr(packed.size()));
+    }
+}
+
+void Mesh::create_buffers(const void* vertex_data, const void* index_data, GLsizeiptr index_bytes)
+{
+    // vertices start on a multiple of the stride, so they are addressed with a base vertex; moves only
+    // change the range, the shared vertex arrays attach whichever block a mesh is in when it is bound
+    vertex_arrays = Vertex_Array_Cache::shared();
+    vertex_arena = Gpu_Arena::shared(GPU_ARENA_VERTICES);
+    vertex_allocation = vertex_arena->allocate(GLsizeiptr(vertex_count) * format.stride, format.stride, [this](const Gpu_Range& range)
+    {
+        vertex_range = range;
+    });
+    vertex_range = vertex_arena->range(vertex_allocation);
+
+    if (vertex_data)
+    {
+        buffer_sub_data(vertex_range, vertex_data);
+    }
+
+    // indices are already packed to index_type
+    if (index_bytes > 0)
+    {
+        index_arena = Gpu_Arena::shared(GPU_ARENA_INDICES);
+
+        try
+        {
+            index_allocation = index_arena->allocate(index_bytes, 4, [this](const Gpu_Range& range)
+            {
+                index_range = range;
+            });
+        }
+        catch (...)
+        {
+            // the destructor does not run when a constructor throws
+            vertex_arena->free(vertex_allocation);
+            vertex_allocation = 0;
+            throw;
+        }
+        index_range = index_arena->range(index_allocation);
+
+        if (index_data)
+        {
+            buffer_sub_data(index_range, index_data);
+        }
+    }
+}
+
+Mesh::~Mesh()
+{
+    if (vertex_allocation) vertex_arena->free(vertex_allocation);
+    if (index_allocation) index_arena->free(index_allocation);
+}
+
+GLuint Mesh::vertex_array(Shader& shader, const Vertex_Format* instance_format)
+{
+    // keyed by the locations the shader resolved itself, never by its program name, which GL hands out
+    // again once the program was deleted
+    const GLint* instance_locations = instance_format ? shader.attrib_locations(*instance_format).data() : nullptr;
+    return vertex_arrays->vertex_array(format, shader.attrib_locations(format).data(), instance_format, instance_locations);
+}
+
+void Mesh::bind(Gl_State& state, Shader& shader, const Vertex_Format* instance_format, GLuint instance_buffer)
+{
+    vertex_arrays->bind(state, vertex_array(shader, instance_format), vertex_range.buffer, format.stride, index_range.buffer,
+                        instance_buffer, instance_format ? instance_format->stride : 0);
+}
+
+void Mesh::write_vertices(const std::function<void(void* vertices, GLsizei first, GLsizei count)>& write)
+{
+    if (storage == MESH_STORAGE_GPU_AND_CPU)
+    {
+        write(vertices.data(), 0, vertex_count);
+        bounds = bounds_of(mesh_optimizer::read_positions(format, vertices.data(), vertex_count));
+        glNamedBufferSubData(vertex_range.buffer, vertex_range.offset, vertices.size(), vertices.data());
+        return;
+    }
+
+    // write-only: the mapping is usually write-combined memory, which is slow or impossible to read
+    GLubyte* mapped = static_cast<GLubyte*>(glMapNamedBufferRange(vertex_range.buffer, vertex_range.offset, vertex_range.size,
+                                                                  GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT));
+    if (!mapped)
+    {
+        throw std::runtime_error("Failed to map vertex buffer for writing");
+    }
+
+    const GLsizei block_count = GLsizei(std::max<GLsizeiptr>(1, assemble_block_size / format.stride));
+    std::vector<GLubyte> block(std::size_t(std::min(block_count, vertex_count)) * format.stride);
+
+    try
+    {
+        for (GLsizei first = 0; first < vertex_count; first += block_count)
+        {
+            GLsizei count = std::min(block_count, vertex_count - first);
+            write(block.data(), first, count);
+
+            Mesh_Bounds block_bounds = bounds_of(mesh_optimizer::read_positions(format, block.data(), count));
+            bounds.min = (first == 0) ? block_bounds.min : glm::min(bounds.min, block_bounds.min);
+            bounds.max = (first == 0) ? block_bounds.max : glm::max(bounds.max, block_bounds.max);
+
+            std::memcpy(mapped + std::size_t(first) * format.stride, block.data(), std::size_t(count) * format.stride);
+        }
+    }
+    catch (...)
+    {
+        glUnmapNamedBuffer(vertex_range.buffer);
+        throw;
+    }
+
+    if (glUnmapNamedBuffer(vertex_range.buffer) == GL_FALSE)
+    {
+        // the buffer contents became undefined while mapped (e.g. video mode change)
+        throw std::runtime_error("Vertex buffer contents were lost while mapped");
+    }
+}
+
+void Mesh::release_cpu_data()
+{
+    storage = MESH_STORAGE_GPU;
+    std::vector<GLubyte>().swap(vertices);
+    std::vector<GLuint>().swap(indices);
 }
@@ -1,42 +1,352 @@
 #pragma once
 
+#include <array>
+#include <string>
 #include <memory>
 #include <vector>
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include <type_traits>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
 
 #include "vertex.hpp"
+#include "gpu_arena.hpp"
+#include "vertex_array_cache.hpp"
+#include "mesh_optimizer.hpp"
 
 class Model;
+class Shader;
 class Renderer;
+class Asset_Loader;
+struct Mesh_Cache_View;
+
+enum Mesh_Storage
+{
+    MESH_STORAGE_GPU,           // vertex and index data only live in GL buffers after upload
+    MESH_STORAGE_GPU_AND_CPU    // additionally keep the interleaved vertices and indices in memory
+};
+
+enum Mesh_Optimize
+{
+    MESH_OPTIMIZE_NONE          = 0,
+    MESH_OPTIMIZE_VERTEX_CACHE  = 1 << 0,   // reorder triangles for post-transform cache hits
+    MESH_OPTIMIZE_OVERDRAW      = 1 << 1,   // reorder triangle clusters front to back (implies vertex cache)
+    MESH_OPTIMIZE_VERTEX_FETCH  = 1 << 2,   // renumber vertices in order of first use
+    MESH_OPTIMIZE_ALL           = MESH_OPTIMIZE_VERTEX_CACHE | MESH_OPTIMIZE_OVERDRAW | MESH_OPTIMIZE_VERTEX_FETCH,
+
+    MESH_OPTIMIZE_TRIANGLE_STRIPS = 1 << 3, // convert to strips joined by primitive restart when that is smaller
+    MESH_OPTIMIZE_LOD_CHAIN     = 1 << 4,   // append simplified levels of detail to the index list
+    MESH_OPTIMIZE_MESHLETS      = 1 << 5,   // group triangles into cullable clusters (keeps the list from becoming strips)
+    MESH_OPTIMIZE_QUANTIZE      = 1 << 6    // store vertices in the matching packed layout from vertex.hpp (lossy)
+};
+
+struct Mesh_Material
+{
+    std::string name;
+    std::array<GLfloat, 3> ambient = {{ 0.0f, 0.0f, 0.0f }};
+    std::array<GLfloat, 3> diffuse = {{ 1.0f, 1.0f, 1.0f }};
+    std::array<GLfloat, 3> specular = {{ 0.0f, 0.0f, 0.0f }};
+    GLfloat shininess = 0.0f;
+    GLfloat opacity = 1.0f;
+    std::string diffuse_map;    // texture path, relative to the working directory
+};
+
+// contiguous range of the index list (or of the vertices for non-indexed meshes) sharing one material
+struct Submesh
+{
+    GLsizei first;
+    GLsizei count;
+    GLint material;             // index into the mesh materials; -1 for none
+};
+
+// Simplified level of detail. Its submeshes mirror those of the full detail mesh (some may be empty)
+// and follow each other in the shared index buffer, so a level is drawn as one contiguous range.
+struct Mesh_Lod
+{
+    std::vector<Submesh> submeshes;
+    GLfloat error;              // largest deviation from the full detail surface, in model units
+};
+
+// what Mesh::select_lod needs to know about the camera
+struct Lod_View
+{
+    glm::vec3 eye;              // camera position in world space
+    GLfloat projection_scale;   // pixels per world unit at distance 1: viewport height / (2 tan(fovy / 2))
+    GLfloat pixel_error = 1.0f; // largest acceptable screen space error
+};
+
+// what Mesh::cull_meshlets tests against
+struct Cull_View
+{
+    glm::mat4 view_projection;  // world space to clip space
+    glm::vec3 eye;              // camera position in world space
+};
+
+// axis aligned, in model space
+struct Mesh_Bounds
+{
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+};
+
+// CPU-side geometry as produced by the loaders; carries no GL state, so it can be built on any thread
+struct Mesh_Data
+{
+    Vertex_Format format = { 0, 0, nullptr };
+    GLsizei vertex_count = 0;
+    std::vector<GLubyte> vertices;
+    std::vector<GLuint> indices;
+    std::vector<Submesh> submeshes;
+    std::vector<Mesh_Material> materials;
+    std::vector<Mesh_Lod> lods;             // coarser levels after the full detail submeshes, finest first
+    std::vector<Meshlet> meshlets;          // full detail only, within submeshes
+    GLenum topology = GL_TRIANGLES;
+
+    std::vector<std::string> dependencies;  // files besides the source the data was read from (e.g. material libraries)
+
+    // filled in by Mesh::prepare()
+    Mesh_Bounds bounds;
+    Vertex_Cache_Statistics input_cache_stats;
+    Vertex_Cache_Statistics cache_stats;
+
+    // loader output for vertices of a layout from vertex.hpp
+    template <typename V>
+    static Mesh_Data from_vertices(const std::vector<V>& vertices,
+                                   const std::vector<GLuint>& indices = std::vector<GLuint>(),
+                                   GLenum mode = GL_TRIANGLES)
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "Mesh vertices must be trivially copyable");
+
+        Mesh_Data data;
+        data.format = V::format();
+        data.vertex_count = GLsizei(vertices.size());
+        const GLubyte* bytes = reinterpret_cast<const GLubyte*>(vertices.data());
+        data.vertices.assign(bytes, bytes + vertices.size() * sizeof(V));
+        data.indices = indices;
+        data.topology = mode;
+        return data;
+    }
+};
+
+class Mesh;
+
+// mesh placed in a scene by a loader
+struct Mesh_Instance
+{
+    std::shared_ptr<Mesh> mesh;
+    glm::mat4 transform;    // mesh space to scene space
+};
 
 class Mesh
 {
 friend class Model;
 friend class Renderer;
+friend class Asset_Loader;
+friend class Mesh_Stream;
+friend class Render_Queue;
 
 private:
-    GLuint vao;
+    // vertex arrays are shared with every mesh of the layout and found by the attribute locations
+    std::shared_ptr<Vertex_Array_Cache> vertex_arrays;
+
+    // vertex and index data are ranges of the shared arenas; vertices start on a multiple of the stride
+    std::shared_ptr<Gpu_Arena> vertex_arena;
+    std::shared_ptr<Gpu_Arena> index_arena;
+    Gpu_Arena::Handle vertex_allocation;
+    Gpu_Arena::Handle index_allocation;
+    Gpu_Range vertex_range;
+    Gpu_Range index_range;  // empty for non-indexed meshes
+
+    Vertex_Format format;
+    GLsizei vertex_count;
+    GLsizei index_count;    // full detail; levels of detail follow in the index buffer
+    GLenum index_type;      // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT; the smallest that fits vertex_count
 
-	std::vector<Vertex> vertices;
-	std::vector<GLuint> indices;
+    Mesh_Storage storage;
+    std::vector<GLubyte> vertices;  // interleaved vertex data, laid out as described by format (MESH_STORAGE_GPU_AND_CPU only)
+    std::vector<GLuint> indices;    // as uploaded, widened to 32 bits (MESH_STORAGE_GPU_AND_CPU only)
 
-	GLenum topology;        // GL_POINTS, GL_LINE_STRIP, GL_LINE_LOOP, GL_LINES, GL_LINE_STRIP_ADJACENCY, GL_LINES_ADJACENCY,
+    std::vector<Submesh> submeshes;         // always covers the whole full detail mesh
+    std::vector<Mesh_Material> materials;
+    std::vector<Mesh_Lod> lods;
+    std::vector<Meshlet> meshlets;
+
+    Mesh_Bounds bounds;
+    Vertex_Cache_Statistics input_cache_stats;  // index order as given (indexed triangle lists only)
+    Vertex_Cache_Statistics cache_stats;        // index order as uploaded
+
+    GLenum topology;        // GL_POINTS, GL_LINE_STRIP, GL_LINE_LOOP, GL_LINES, GL_LINE_STRIP_ADJACENCY, GL_LINES_ADJACENCY,
                             // GL_TRIANGLE_STRIP, GL_TRIANGLE_FAN, GL_TRIANGLES, GL_TRIANGLE_STRIP_ADJACENCY, GL_TRIANGLES_ADJACENCY, GL_PATCHES
-    GLenum vertex_usage;    // GL_STREAM_DRAW, GL_STREAM_READ, GL_STREAM_COPY, GL_STATIC_DRAW, GL_STATIC_READ, GL_STATIC_COPY, GL_DYNAMIC_DRAW, GL_DYNAMIC_READ, GL_DYNAMIC_COPY
+    GLenum vertex_usage;    // as requested; arena storage is the same for every usage. GL_STREAM_DRAW, GL_STREAM_READ, GL_STREAM_COPY, GL_STATIC_DRAW, GL_STATIC_READ, GL_STATIC_COPY, GL_DYNAMIC_DRAW, GL_DYNAMIC_READ, GL_DYNAMIC_COPY
+
+    Mesh(const Vertex_Format& format,
+         GLsizei vertex_count,
+         const std::vector<GLuint>& indices,
+         GLenum mode,
+         GLenum usage,
+         Mesh_Storage storage);
+
+    Mesh(const Vertex_Format& format, GLenum mode, GLenum usage, Mesh_Storage storage);
+
+    // prepared data as described by a cache file (or mesh_cache::describe); without upload_contents the
+    // buffers are only allocated and their contents copied in later
+    Mesh(Mesh_Cache_View& view, GLenum usage, Mesh_Storage storage, bool upload_contents);
+
+    static void build_lods(Mesh_Data& data, const std::vector<GLfloat>& positions);
+    static void build_strips(Mesh_Data& data);
+    static void quantize(Mesh_Data& data);
+
+    void upload(Mesh_Data& data);
+    void create_buffers(const void* vertex_data, const std::vector<GLuint>& indices);
+    void create_buffers(const void* vertex_data, const void* index_data, GLsizeiptr index_bytes);
+
+    // Fills the vertex block through write(vertices, first, count) over consecutive ranges, and takes the
+    // bounds from what was written. For GPU storage every range is written into a small CPU block first and
+    // copied into a write-only mapping from there, so mapped GPU memory is never read back.
+    void write_vertices(const std::function<void(void* vertices, GLsizei first, GLsizei count)>& write);
 
 public:
-    Mesh(const std::vector<Vertex>& vertices, 
+    template <typename V>
+    Mesh(const std::vector<V>& vertices, 
          GLenum mode  = GL_TRIANGLES, 
-         GLenum usage = GL_STATIC_DRAW);
+         GLenum usage = GL_STATIC_DRAW,
+         Mesh_Storage storage = MESH_STORAGE_GPU_AND_CPU)
+    : Mesh(V::format(), vertices.data(), GLsizei(vertices.size()), std::vector<GLuint>(), mode, usage, storage)
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "Mesh vertices must be trivially copyable");
+    }
 
-    Mesh(const std::vector<Vertex>& vertices, 
+    template <typename V>
+    Mesh(const std::vector<V>& vertices, 
          const std::vector<GLuint>& indices, 
          GLenum mode  = GL_TRIANGLES, 
-         GLenum usage = GL_STATIC_DRAW);
+         GLenum usage = GL_STATIC_DRAW,
+         Mesh_Storage storage = MESH_STORAGE_GPU_AND_CPU,
+         GLbitfield optimize = MESH_OPTIMIZE_NONE)
+    : Mesh(V::format(), vertices.data(), GLsizei(vertices.size()), indices, mode, usage, storage, optimize)
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "Mesh vertices must be trivially copyable");
+    }
+
+    // contiguous block of vertex_count vertices with the given format
+    Mesh(const Vertex_Format& format,
+         const void* vertices,
+         GLsizei vertex_count,
+         const std::vector<GLuint>& indices,
+         GLenum mode  = GL_TRIANGLES,
+         GLenum usage = GL_STATIC_DRAW,
+         Mesh_Storage storage = MESH_STORAGE_GPU_AND_CPU,
+         GLbitfield optimize = MESH_OPTIMIZE_NONE);
+
+    // takes over loader output; optimizations run in place, per submesh
+    Mesh(Mesh_Data&& data,
+         GLenum usage = GL_STATIC_DRAW,
+         Mesh_Storage storage = MESH_STORAGE_GPU,
+         GLbitfield optimize = MESH_OPTIMIZE_NONE);
+
+    // Builds a mesh of vertex_count vertices of type V by letting write(V* vertices, GLsizei first, GLsizei count)
+    // fill vertices[0] to vertices[count - 1] with vertices first to first + count - 1, in consecutive calls
+    // that cover the mesh. For MESH_STORAGE_GPU the writer gets a small block at a time that is copied into
+    // mapped GL memory, so the interleaved data is never staged whole. Bounds come from the written vertices.
+    template <typename V, typename Writer>
+    static std::shared_ptr<Mesh> assemble(GLsizei vertex_count,
+                                          const std::vector<GLuint>& indices,
+                                          Writer write,
+                                          GLenum mode  = GL_TRIANGLES,
+                                          GLenum usage = GL_STATIC_DRAW,
+                                          Mesh_Storage storage = MESH_STORAGE_GPU)
+    {
+        static_assert(std::is_trivially_copyable<V>::value, "Mesh vertices must be trivially copyable");
+
+        std::shared_ptr<Mesh> mesh(new Mesh(V::format(), vertex_count, indices, mode, usage, storage));
+        mesh->write_vertices([&write](void* vertices, GLsizei first, GLsizei count)
+        {
+            write(static_cast<V*>(vertices), first, count);
+        });
+        return mesh;
+    }
+
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Vertex array object whose attribute locations match the inputs of shader, shared with every mesh
+    // of the same layout. Locations are resolved once per vertex layout and shader; the shader keeps them
+    // so repeated calls cost no GL queries. With an instance_format the vertex array also reads
+    // those attributes once per instance.
+    GLuint vertex_array(Shader& shader, const Vertex_Format* instance_format = nullptr);
+
+    // binds vertex_array(shader, instance_format) with this mesh's arena blocks and instance_buffer
+    // attached; draws add base_vertex(), and the base instance picks the first instance record
+    void bind(Gl_State& state, Shader& shader, const Vertex_Format* instance_format = nullptr, GLuint instance_buffer = 0);
+
+    // first vertex of the mesh in its vertex buffer (basevertex, or first for glDrawArrays)
+    GLint base_vertex() const { return GLint(vertex_range.offset / format.stride); }
+
+    // byte offset of index first in the element buffer
+    const void* index_offset(GLsizei first = 0) const
+    {
+        return (const void*)std::uintptr_t(index_range.offset + GLintptr(first) * mesh_optimizer::index_size(index_type));
+    }
+
+    const Mesh_Bounds& bounding_box() const { return bounds; }
+    const std::vector<Mesh_Lod>& levels_of_detail() const { return lods; }
+
+    // Coarsest level whose error, projected at the distance of the bounding sphere transformed into world
+    // space, stays within view.pixel_error: 0 for full detail, i for lods[i - 1]. Full detail while the
+    // eye is inside the sphere.
+    GLsizei select_lod(const glm::mat4& transform, const Lod_View& view) const;
+
+    // index range of a level as returned by select_lod, restart indices between its submeshes included
+    std::pair<GLsizei, GLsizei> lod_range(GLsizei level) const;
+
+    const std::vector<Meshlet>& meshlet_list() const { return meshlets; }
+
+    // Appends the full detail index ranges (first, count) of the meshlets that are inside the view frustum
+    // and not entirely backfacing; neighbouring visible meshlets share one range. Returns the number of
+    // visible meshlets. Cone culling is skipped for transforms that scale non-uniformly or mirror.
+    GLsizei cull_meshlets(const glm::mat4& transform, const Cull_View& view, std::vector<std::pair<GLsizei, GLsizei>>& ranges) const;
+    const Vertex_Cache_Statistics& input_vertex_cache_statistics() const { return input_cache_stats; }
+    const Vertex_Cache_Statistics& vertex_cache_statistics() const { return cache_stats; }
+
+    // drops the CPU-side copies of the vertex and index data; the GL buffers remain intact
+    void release_cpu_data();
+
+    // Runs the requested optimizations on loader output and computes its bounds and cache statistics.
+    // Makes no GL calls.
+    static void prepare(Mesh_Data& data, GLbitfield optimize);
+
+    // Loads source_path through its binary cache (source_path + ".meshcache"). When the cache is missing
+    // or was built from different file contents, parse() is called and the prepared result is written
+    // back; otherwise the cached blobs are uploaded straight from the mapped file.
+    static std::shared_ptr<Mesh> load_cached(const std::string& source_path,
+                                             const std::function<Mesh_Data()>& parse,
+                                             GLbitfield optimize,
+                                             Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // Wavefront OBJ with MTL materials. The file is memory mapped and parsed on all cores; identical
+    // position/texcoord/normal tuples are welded into one indexed vertex. parse_obj() makes no GL calls;
+    // load_obj() goes through the mesh cache.
+    static Mesh_Data parse_obj(const std::string& obj_file_path);
+    static std::shared_ptr<Mesh> load_obj(const std::string& obj_file_path,
+                                          GLbitfield optimize = MESH_OPTIMIZE_ALL,
+                                          Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // glTF 2.0 (.gltf with external or embedded buffers, or .glb), one mesh per primitive. Primitives
+    // whose attributes already form one of the layouts in vertex.hpp are uploaded straight from the
+    // mapped buffer without re-interleaving (unless an optimization is requested); others are converted.
+    static std::vector<Mesh_Instance> load_gltf(const std::string& gltf_file_path,
+                                                GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                                Mesh_Storage storage = MESH_STORAGE_GPU);
 
-	static std::shared_ptr<Mesh> load_obj();
-	static std::shared_ptr<Mesh> load_fbx();
-	static std::shared_ptr<Mesh> load_gltf();
+    // Binary FBX (6.1 to 7.x), one mesh per distinct geometry and material set, placed by the model
+    // transforms. Compressed geometry arrays are inflated in parallel; polygons are fan triangulated.
+    static std::vector<Mesh_Instance> load_fbx(const std::string& fbx_file_path,
+                                               GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                               Mesh_Storage storage = MESH_STORAGE_GPU);
 };
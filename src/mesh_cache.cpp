@@ -0,0 +1,589 @@
+#include "mesh_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <experimental/filesystem>
+
+#include "util.hpp"
+#include "mapped_file.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    struct Stats_Record
+    {
+        std::uint32_t vertices_transformed;
+        std::uint32_t triangle_count;
+        float acmr;
+        float atvr;
+    };
+
+    struct File_Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t optimize;
+        std::uint32_t topology;
+        std::uint32_t index_type;
+        std::uint32_t vertex_count;
+        std::uint32_t index_count;
+        std::uint32_t stride;
+        std::uint32_t attrib_count;
+        std::uint32_t submesh_count;
+        std::uint32_t material_count;
+        std::uint32_t source_count;
+        std::uint32_t lod_count;
+        std::uint32_t meshlet_count;
+        float bounds_min[3];
+        float bounds_max[3];
+        Stats_Record input_stats;
+        Stats_Record stats;
+
+        // byte offsets from the start of the file
+        std::uint64_t attrib_offset;
+        std::uint64_t submesh_offset;   // submesh_count records for the full detail mesh, then as many per level
+        std::uint64_t lod_offset;
+        std::uint64_t meshlet_offset;
+        std::uint64_t material_offset;
+        std::uint64_t source_offset;
+        std::uint64_t string_offset;
+        std::uint64_t vertex_offset;
+        std::uint64_t index_offset;
+        std::uint64_t index_bytes;
+        std::uint64_t file_size;
+    };
+
+    // strings are (offset, length) pairs into the string table
+    struct String_Record
+    {
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    struct Attrib_Record
+    {
+        std::uint32_t index;
+        std::uint32_t size;
+        std::uint32_t type;
+        std::uint32_t normalized;
+        std::uint32_t offset;
+        String_Record name;
+        std::uint32_t reserved;
+    };
+
+    struct Submesh_Record
+    {
+        std::int32_t first;
+        std::int32_t count;
+        std::int32_t material;
+    };
+
+    struct Lod_Record
+    {
+        float error;
+    };
+
+    struct Meshlet_Record
+    {
+        std::int32_t first;
+        std::int32_t count;
+        std::uint32_t vertex_count;
+        float center[3];
+        float radius;
+        float cone_axis[3];
+        float cone_cutoff;
+    };
+
+    struct Material_Record
+    {
+        float ambient[3];
+        float diffuse[3];
+        float specular[3];
+        float shininess;
+        float opacity;
+        String_Record name;
+        String_Record diffuse_map;
+    };
+
+    struct Source_Record
+    {
+        std::uint64_t hash;
+        std::uint64_t size;
+        std::int64_t time;
+        String_Record path;
+    };
+
+    static_assert(std::is_trivially_copyable<File_Header>::value && sizeof(File_Header) == 200, "Cache header layout changed");
+
+    const std::size_t blob_alignment = 16;
+
+    // cached descriptors are matched against the known layouts so meshes from a cache share their static
+    // attribute tables (and shader location caches) with freshly parsed ones
+    const Vertex_Format* find_format(const Attrib_Record* records, std::uint32_t count, std::uint32_t stride, const char* strings, std::size_t strings_size)
+    {
+        for (const Vertex_Format* format : vertex_formats())
+        {
+            if (format->attrib_count != count || GLuint(format->stride) != stride) continue;
+
+            bool match = true;
+            for (std::uint32_t i = 0; i < count && match; ++i)
+            {
+                const Vertex_Attrib& attrib = format->attribs[i];
+                const Attrib_Record& record = records[i];
+
+                match = record.index == attrib.index && GLint(record.size) == attrib.size && record.type == attrib.type &&
+                        record.normalized == attrib.normalized && GLuint(record.offset) == GLuint(attrib.offset) &&
+                        std::size_t(record.name.offset) + record.name.length <= strings_size &&
+                        std::strlen(attrib.name) == record.name.length &&
+                        std::memcmp(strings + record.name.offset, attrib.name, record.name.length) == 0;
+            }
+
+            if (match) return format;
+        }
+
+        return nullptr;
+    }
+
+    std::int64_t modification_time(const std::string& path)
+    {
+        return std::int64_t(fs::last_write_time(path).time_since_epoch().count());
+    }
+
+    std::uint64_t content_hash(const std::string& path)
+    {
+        Mapped_File file(path);
+        return util::hash_bytes(file.data(), file.size());
+    }
+
+    class Writer
+    {
+    private:
+        std::vector<char> bytes;
+
+    public:
+        std::vector<char> strings;
+
+        std::size_t size() const { return bytes.size(); }
+        char* data() { return bytes.data(); }
+
+        void align()
+        {
+            bytes.resize((bytes.size() + blob_alignment - 1) / blob_alignment * blob_alignment, 0);
+        }
+
+        std::uint64_t append(const void* data, std::size_t size)
+        {
+            std::uint64_t offset = bytes.size();
+            bytes.insert(bytes.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+            return offset;
+        }
+
+        String_Record string(const std::string& value)
+        {
+            String_Record record = { std::uint32_t(strings.size()), std::uint32_t(value.size()) };
+            strings.insert(strings.end(), value.begin(), value.end());
+            return record;
+        }
+    };
+
+    template <typename T>
+    bool in_bounds(std::uint64_t offset, std::uint64_t count, std::size_t file_size)
+    {
+        return offset <= file_size && count <= (file_size - offset) / sizeof(T);
+    }
+}
+
+namespace mesh_cache
+{
+    std::string path_for(const std::string& source_path)
+    {
+        return source_path + ".meshcache";
+    }
+
+    bool read(const Mapped_File& file, GLbitfield optimize, Mesh_Cache_View& view)
+    {
+        if (file.size() < sizeof(File_Header))
+        {
+            return false;
+        }
+
+        File_Header header;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (header.magic != magic || header.version != version || header.optimize != optimize || header.file_size != file.size())
+        {
+            return false;
+        }
+
+        const std::size_t size = file.size();
+        std::uint64_t string_size = header.vertex_offset - std::min(header.vertex_offset, header.string_offset);
+
+        if (!in_bounds<Attrib_Record>(header.attrib_offset, header.attrib_count, size) ||
+            !in_bounds<Submesh_Record>(header.submesh_offset, std::uint64_t(header.submesh_count) * (1 + header.lod_count), size) ||
+            !in_bounds<Lod_Record>(header.lod_offset, header.lod_count, size) ||
+            !in_bounds<Meshlet_Record>(header.meshlet_offset, header.meshlet_count, size) ||
+            !in_bounds<Material_Record>(header.material_offset, header.material_count, size) ||
+            !in_bounds<Source_Record>(header.source_offset, header.source_count, size) ||
+            !in_bounds<char>(header.string_offset, string_size, size) ||
+            !in_bounds<GLubyte>(header.vertex_offset, std::uint64_t(header.vertex_count) * header.stride, size) ||
+            !in_bounds<GLubyte>(header.index_offset, header.index_bytes, size))
+        {
+            return false;
+        }
+
+        // records are read through copies; the mapping gives no alignment guarantees for them
+        auto records = [&](std::uint64_t offset, std::uint32_t count, auto* type)
+        {
+            typedef typename std::remove_pointer<decltype(type)>::type Record;
+            std::vector<Record> result(count);
+            if (count) std::memcpy(result.data(), file.data() + offset, count * sizeof(Record));
+            return result;
+        };
+
+        const char* strings = file.data() + header.string_offset;
+        auto string = [&](const String_Record& record, std::string& out)
+        {
+            if (std::uint64_t(record.offset) + record.length > string_size) return false;
+            out.assign(strings + record.offset, record.length);
+            return true;
+        };
+
+        // stale when any source changed; size and time are checked first so an unchanged source is not reread
+        view.sources.clear();
+        view.source_hashes.clear();
+        for (const Source_Record& source : records(header.source_offset, header.source_count, (Source_Record*)nullptr))
+        {
+            std::string path;
+            if (!string(source.path, path) || !fs::exists(path) || fs::file_size(path) != source.size)
+            {
+                return false;
+            }
+
+            if (modification_time(path) != source.time && content_hash(path) != source.hash)
+            {
+                return false;
+            }
+
+            view.sources.push_back(path);
+            view.source_hashes.push_back(source.hash);
+        }
+
+        std::vector<Attrib_Record> attribs = records(header.attrib_offset, header.attrib_count, (Attrib_Record*)nullptr);
+        const Vertex_Format* format = find_format(attribs.data(), header.attrib_count, header.stride, strings, std::size_t(string_size));
+        if (!format)
+        {
+            return false;
+        }
+
+        view.format = *format;
+        view.vertex_count = GLsizei(header.vertex_count);
+        view.index_count = GLsizei(header.index_count);
+        view.index_type = header.index_type;
+        view.topology = header.topology;
+        view.vertices = file.data() + header.vertex_offset;
+        view.indices = header.index_bytes ? file.data() + header.index_offset : nullptr;
+        view.index_bytes = GLsizeiptr(header.index_bytes);
+
+        if (header.lod_count > 0 && header.submesh_count == 0)
+        {
+            return false;
+        }
+
+        if (view.index_count > 0 && view.index_bytes != GLsizeiptr(view.index_count) * mesh_optimizer::index_size(view.index_type))
+        {
+            return false;
+        }
+
+        std::vector<Submesh_Record> submeshes = records(header.submesh_offset, header.submesh_count * (1 + header.lod_count), (Submesh_Record*)nullptr);
+        std::vector<Lod_Record> lods = records(header.lod_offset, header.lod_count, (Lod_Record*)nullptr);
+
+        view.submeshes.clear();
+        view.lods.assign(header.lod_count, Mesh_Lod());
+        for (std::size_t i = 0; i < submeshes.size(); ++i)
+        {
+            const Submesh_Record& record = submeshes[i];
+            std::size_t level = i / header.submesh_count;
+
+            // every range has to lie within the index (or vertex) data
+            std::uint64_t limit = header.index_count ? header.index_count : header.vertex_count;
+            if (record.first < 0 || record.count < 0 || std::uint64_t(record.first) + std::uint64_t(record.count) > limit)
+            {
+                return false;
+            }
+
+            std::vector<Submesh>& level_submeshes = level ? view.lods[level - 1].submeshes : view.submeshes;
+            level_submeshes.push_back({ record.first, record.count, record.material });
+        }
+
+        for (std::uint32_t i = 0; i < header.lod_count; ++i)
+        {
+            view.lods[i].error = lods[i].error;
+        }
+
+        view.meshlets.clear();
+        for (const Meshlet_Record& record : records(header.meshlet_offset, header.meshlet_count, (Meshlet_Record*)nullptr))
+        {
+            if (record.first < 0 || record.count < 0 || std::uint64_t(record.first) + std::uint64_t(record.count) > header.index_count)
+            {
+                return false;
+            }
+
+            Meshlet meshlet = { record.first, record.count, record.vertex_count, { record.center[0], record.center[1], record.center[2] }, record.radius,
+                                { record.cone_axis[0], record.cone_axis[1], record.cone_axis[2] }, record.cone_cutoff };
+            view.meshlets.push_back(meshlet);
+        }
+
+        view.materials.clear();
+        for (const Material_Record& record : records(header.material_offset, header.material_count, (Material_Record*)nullptr))
+        {
+            Mesh_Material material;
+            std::copy(record.ambient, record.ambient + 3, material.ambient.begin());
+            std::copy(record.diffuse, record.diffuse + 3, material.diffuse.begin());
+            std::copy(record.specular, record.specular + 3, material.specular.begin());
+            material.shininess = record.shininess;
+            material.opacity = record.opacity;
+
+            if (!string(record.name, material.name) || !string(record.diffuse_map, material.diffuse_map))
+            {
+                return false;
+            }
+
+            view.materials.push_back(material);
+        }
+
+        view.bounds.min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+        view.bounds.max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+        view.input_cache_stats = { header.input_stats.vertices_transformed, header.input_stats.triangle_count, header.input_stats.acmr, header.input_stats.atvr };
+        view.cache_stats = { header.stats.vertices_transformed, header.stats.triangle_count, header.stats.acmr, header.stats.atvr };
+        return true;
+    }
+
+    bool write(const std::string& cache_path, const Mesh_Data& data, GLbitfield optimize, const std::vector<std::string>& sources,
+               std::vector<std::uint64_t>* source_hashes)
+    {
+        Writer writer;
+        File_Header header = {};
+
+        std::vector<Attrib_Record> attribs;
+        for (GLuint i = 0; i < data.format.attrib_count; ++i)
+        {
+            const Vertex_Attrib& attrib = data.format.attribs[i];
+            attribs.push_back({ attrib.index, GLuint(attrib.size), attrib.type, attrib.normalized, GLuint(attrib.offset), writer.string(attrib.name), 0 });
+        }
+
+        if (!find_format(attribs.data(), GLuint(attribs.size()), GLuint(data.format.stride), writer.strings.data(), writer.strings.size()))
+        {
+            return false;
+        }
+
+        std::vector<Submesh_Record> submeshes;
+        for (const Submesh& submesh : data.submeshes)
+        {
+            submeshes.push_back({ submesh.first, submesh.count, submesh.material });
+        }
+
+        std::vector<Lod_Record> lods;
+        for (const Mesh_Lod& lod : data.lods)
+        {
+            if (lod.submeshes.size() != data.submeshes.size()) return false;
+
+            for (const Submesh& submesh : lod.submeshes)
+            {
+                submeshes.push_back({ submesh.first, submesh.count, submesh.material });
+            }
+
+            lods.push_back({ lod.error });
+        }
+
+        std::vector<Meshlet_Record> meshlets;
+        for (const Meshlet& meshlet : data.meshlets)
+        {
+            meshlets.push_back({ meshlet.first, meshlet.count, meshlet.vertex_count, { meshlet.center[0], meshlet.center[1], meshlet.center[2] }, meshlet.radius,
+                                 { meshlet.cone_axis[0], meshlet.cone_axis[1], meshlet.cone_axis[2] }, meshlet.cone_cutoff });
+        }
+
+        std::vector<Material_Record> materials;
+        for (const Mesh_Material& material : data.materials)
+        {
+            Material_Record record = {};
+            std::copy(material.ambient.begin(), material.ambient.end(), record.ambient);
+            std::copy(material.diffuse.begin(), material.diffuse.end(), record.diffuse);
+            std::copy(material.specular.begin(), material.specular.end(), record.specular);
+            record.shininess = material.shininess;
+            record.opacity = material.opacity;
+            record.name = writer.string(material.name);
+            record.diffuse_map = writer.string(material.diffuse_map);
+            materials.push_back(record);
+        }
+
+        std::vector<Source_Record> source_records;
+        if (source_hashes) source_hashes->assign(sources.size(), 0);
+        for (std::size_t i = 0; i < sources.size(); ++i)
+        {
+            const std::string& source = sources[i];
+            if (!fs::exists(source)) continue;
+
+            source_records.push_back({ content_hash(source), std::uint64_t(fs::file_size(source)), modification_time(source), writer.string(source) });
+            if (source_hashes) (*source_hashes)[i] = source_records.back().hash;
+        }
+
+        GLenum index_type = mesh_optimizer::index_type(data.vertex_count);
+        std::vector<GLubyte> packed = data.indices.empty() ? std::vector<GLubyte>() : mesh_optimizer::pack_indices(data.indices, index_type);
+
+        header.magic = magic;
+        header.version = version;
+        header.optimize = optimize;
+        header.topology = data.topology;
+        header.index_type = index_type;
+        header.vertex_count = std::uint32_t(data.vertex_count);
+        header.index_count = std::uint32_t(data.indices.size());
+        header.stride = std::uint32_t(data.format.stride);
+        header.attrib_count = std::uint32_t(attribs.size());
+        header.submesh_count = std::uint32_t(data.submeshes.size());
+        header.lod_count = std::uint32_t(lods.size());
+        header.meshlet_count = std::uint32_t(meshlets.size());
+        header.material_count = std::uint32_t(materials.size());
+        header.source_count = std::uint32_t(source_records.size());
+
+        for (int i = 0; i < 3; ++i)
+        {
+            header.bounds_min[i] = data.bounds.min[i];
+            header.bounds_max[i] = data.bounds.max[i];
+        }
+
+        const Vertex_Cache_Statistics& input = data.input_cache_stats;
+        const Vertex_Cache_Statistics& output = data.cache_stats;
+        header.input_stats = { input.vertices_transformed, input.triangle_count, input.acmr, input.atvr };
+        header.stats = { output.vertices_transformed, output.triangle_count, output.acmr, output.atvr };
+
+        writer.append(&header, sizeof(header));
+        header.attrib_offset = writer.append(attribs.data(), attribs.size() * sizeof(Attrib_Record));
+        header.submesh_offset = writer.append(submeshes.data(), submeshes.size() * sizeof(Submesh_Record));
+        header.lod_offset = writer.append(lods.data(), lods.size() * sizeof(Lod_Record));
+        header.meshlet_offset = writer.append(meshlets.data(), meshlets.size() * sizeof(Meshlet_Record));
+        header.material_offset = writer.append(materials.data(), materials.size() * sizeof(Material_Record));
+        header.source_offset = writer.append(source_records.data(), source_records.size() * sizeof(Source_Record));
+        header.string_offset = writer.append(writer.strings.data(), writer.strings.size());
+
+        writer.align();
+        header.vertex_offset = writer.append(data.vertices.data(), std::size_t(data.vertex_count) * data.format.stride);
+
+        writer.align();
+        header.index_offset = writer.append(packed.data(), packed.size());
+        header.index_bytes = packed.size();
+        header.file_size = writer.size();
+
+        std::memcpy(writer.data(), &header, sizeof(header));
+
+        // written under a temporary name first so a crash never leaves a truncated cache behind
+        std::string temporary_path = cache_path + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file.write(writer.data(), std::streamsize(writer.size())))
+            {
+                return false;
+            }
+        }
+
+        std::error_code error;
+        fs::rename(temporary_path, cache_path, error);
+        if (error)
+        {
+            fs::remove(temporary_path, error);
+            return false;
+        }
+
+        return true;
+    }
+
+    void describe(const Mesh_Data& data, std::vector<GLubyte>& packed_indices, Mesh_Cache_View& view)
+    {
+        view.format = data.format;
+        view.vertex_count = data.vertex_count;
+        view.index_count = GLsizei(data.indices.size());
+        view.index_type = mesh_optimizer::index_type(data.vertex_count);
+        view.topology = data.topology;
+
+        packed_indices = data.indices.empty() ? std::vector<GLubyte>() : mesh_optimizer::pack_indices(data.indices, view.index_type);
+
+        view.vertices = data.vertices.data();
+        view.indices = packed_indices.data();
+        view.index_bytes = GLsizeiptr(packed_indices.size());
+
+        view.submeshes = data.submeshes;
+        view.lods = data.lods;
+        view.meshlets = data.meshlets;
+        view.materials = data.materials;
+        view.bounds = data.bounds;
+        view.input_cache_stats = data.input_cache_stats;
+        view.cache_stats = data.cache_stats;
+    }
+
+    std::vector<GLuint> unpack_indices(const Mesh_Cache_View& view)
+    {
+        std::vector<GLuint> indices(std::size_t(view.index_count));
+
+        for (GLsizei i = 0; i < view.index_count; ++i)
+        {
+            const GLubyte* index = static_cast<const GLubyte*>(view.indices) + i * mesh_optimizer::index_size(view.index_type);
+
+            switch (view.index_type)
+            {
+            case GL_UNSIGNED_BYTE:  indices[i] = (*index == 0xff) ? mesh_optimizer::restart_index : *index; break;
+            case GL_UNSIGNED_SHORT: { GLushort value; std::memcpy(&value, index, sizeof(value)); indices[i] = (value == 0xffff) ? mesh_optimizer::restart_index : value; break; }
+            default:                std::memcpy(&indices[i], index, sizeof(GLuint)); break;
+            }
+        }
+
+        return indices;
+    }
+}
+
+std::shared_ptr<Mesh> Mesh::load_cached(const std::string& source_path, const std::function<Mesh_Data()>& parse, GLbitfield optimize, Mesh_Storage storage)
+{
+    const std::string cache_path = mesh_cache::path_for(source_path);
+
+    if (fs::exists(cache_path))
+    {
+        Mapped_File file(cache_path);
+        Mesh_Cache_View view;
+
+        if (mesh_cache::read(file, optimize, view))
+        {
+            // uploaded directly from the mapping
+            std::shared_ptr<Mesh> mesh(new Mesh(view, GL_STATIC_DRAW, storage, true));
+
+            if (storage == MESH_STORAGE_GPU_AND_CPU)
+            {
+                const GLubyte* vertex_bytes = static_cast<const GLubyte*>(view.vertices);
+                mesh->vertices.assign(vertex_bytes, vertex_bytes + std::size_t(view.vertex_count) * view.format.stride);
+                mesh->indices = mesh_cache::unpack_indices(view);
+            }
+
+            return mesh;
+        }
+    }
+
+    Mesh_Data data = parse();
+    prepare(data, optimize);
+
+    std::vector<std::string> sources(1, source_path);
+    sources.insert(sources.end(), data.dependencies.begin(), data.dependencies.end());
+
+    // failing to write the cache only costs the next start its parsing time
+    try
+    {
+        mesh_cache::write(cache_path, data, optimize, sources);
+    }
+    catch (const std::exception&)
+    {
+    }
+
+    std::shared_ptr<Mesh> mesh(new Mesh(data.format, data.topology, GL_STATIC_DRAW, storage));
+    mesh->upload(data);
+    return mesh;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+
+#include "mesh.hpp"
+
+class Mapped_File;
+
+// Prepared mesh as stored in a cache file. The vertex and index blobs point into the mapping and are
+// laid out exactly as uploaded, so they can be handed to glBufferStorage without a copy.
+struct Mesh_Cache_View
+{
+    Vertex_Format format = { 0, 0, nullptr };
+    GLsizei vertex_count = 0;
+    GLsizei index_count = 0;
+    GLenum index_type = GL_UNSIGNED_INT;
+    GLenum topology = GL_TRIANGLES;
+
+    const void* vertices = nullptr;
+    const void* indices = nullptr;
+    GLsizeiptr index_bytes = 0;
+
+    std::vector<Submesh> submeshes;
+    std::vector<Mesh_Lod> lods;
+    std::vector<Meshlet> meshlets;
+    std::vector<Mesh_Material> materials;
+    Mesh_Bounds bounds;
+    Vertex_Cache_Statistics input_cache_stats;
+    Vertex_Cache_Statistics cache_stats;
+
+    // files the mesh was prepared from, with their content hashes
+    std::vector<std::string> sources;
+    std::vector<std::uint64_t> source_hashes;
+};
+
+// Versioned binary mesh container. A file holds a header, the vertex layout descriptor, the submesh, level
+// of detail, meshlet and material tables, the list of source files with their content hashes, a string table and
+// finally the vertex and index blobs (16 byte aligned). Only hosts with little endian byte order are supported.
+namespace mesh_cache
+{
+    const std::uint32_t magic = 0x4853454d;  // "MESH"
+    const std::uint32_t version = 3;
+
+    // the cache lives next to its source
+    std::string path_for(const std::string& source_path);
+
+    // Validates file and fills view. Returns false when the file is no cache of this version, was built
+    // with other optimization flags, or any of its source files changed since. Sources whose size and
+    // modification time are unchanged are trusted without hashing them again.
+    bool read(const Mapped_File& file, GLbitfield optimize, Mesh_Cache_View& view);
+
+    // Writes prepared data, recording the content hash of every file in sources; the hashes are also
+    // stored in source_hashes if given (0 for missing files). Returns false when the vertex layout is
+    // not one of the layouts in vertex.hpp or the file cannot be written.
+    bool write(const std::string& cache_path, const Mesh_Data& data, GLbitfield optimize, const std::vector<std::string>& sources,
+               std::vector<std::uint64_t>* source_hashes = nullptr);
+
+    // Describes prepared data the way read() describes a cache file, so both are uploaded alike. The
+    // indices are packed into packed_indices; view points into data and packed_indices.
+    void describe(const Mesh_Data& data, std::vector<GLubyte>& packed_indices, Mesh_Cache_View& view);
+
+    // the view's indices widened back to 32 bits, restart indices included
+    std::vector<GLuint> unpack_indices(const Mesh_Cache_View& view);
+}
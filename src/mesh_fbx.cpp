@@ -0,0 +1,696 @@
+#include "mesh.hpp"
+
+#include <map>
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <experimental/filesystem>
+
+#include <fmt/format.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "util.hpp"
+#include "inflate.hpp"
+#include "mapped_file.hpp"
+#include "corner_table.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    const char fbx_magic[] = "Kaydara FBX Binary  ";   // followed by 0x00 0x1a 0x00 and a 32-bit version
+    const std::size_t fbx_header_size = 27;
+
+    struct Fbx_Property
+    {
+        char type;                  // Y C I F D L: scalars; S R: string, raw; f d l i b: arrays
+        const char* data;           // payload in the mapped file
+        std::uint32_t size;         // payload bytes (compressed size for encoded arrays)
+        std::uint32_t count;        // array elements
+        std::uint32_t encoding;     // arrays: 0 raw, 1 zlib
+        std::vector<char> decoded;  // encoded arrays, after inflating
+
+        std::size_t element_size() const
+        {
+            switch (type)
+            {
+            case 'b': return 1;
+            case 'f': case 'i': return 4;
+            case 'd': case 'l': return 8;
+            default:  return 0;
+            }
+        }
+
+        bool is_array() const { return element_size() != 0; }
+
+        double number() const
+        {
+            switch (type)
+            {
+            case 'C': return double(std::uint8_t(data[0]));
+            case 'Y': { std::int16_t v; std::memcpy(&v, data, 2); return v; }
+            case 'I': { std::int32_t v; std::memcpy(&v, data, 4); return v; }
+            case 'F': { float v; std::memcpy(&v, data, 4); return v; }
+            case 'D': { double v; std::memcpy(&v, data, 8); return v; }
+            case 'L': { std::int64_t v; std::memcpy(&v, data, 8); return double(v); }
+            default:  return 0.0;
+            }
+        }
+
+        std::int64_t integer() const
+        {
+            if (type == 'L')
+            {
+                std::int64_t v;
+                std::memcpy(&v, data, 8);
+                return v;
+            }
+            return std::int64_t(number());
+        }
+
+        std::string string() const
+        {
+            return (type == 'S' || type == 'R') ? std::string(data, size) : std::string();
+        }
+
+        // elements converted to T
+        template <typename T>
+        std::vector<T> array() const
+        {
+            const char* bytes = encoding ? decoded.data() : data;
+            if (encoding && decoded.size() != std::size_t(count) * element_size())
+            {
+                throw std::runtime_error("array was not decompressed");
+            }
+
+            std::vector<T> result(count);
+            for (std::uint32_t i = 0; i < count; ++i)
+            {
+                const char* element = bytes + i * element_size();
+                switch (type)
+                {
+                case 'b': result[i] = T(std::uint8_t(element[0])); break;
+                case 'f': { float v; std::memcpy(&v, element, 4); result[i] = T(v); break; }
+                case 'i': { std::int32_t v; std::memcpy(&v, element, 4); result[i] = T(v); break; }
+                case 'd': { double v; std::memcpy(&v, element, 8); result[i] = T(v); break; }
+                case 'l': { std::int64_t v; std::memcpy(&v, element, 8); result[i] = T(v); break; }
+                }
+            }
+            return result;
+        }
+    };
+
+    struct Fbx_Node
+    {
+        std::string name;
+        std::vector<Fbx_Property> properties;
+        std::vector<Fbx_Node> children;
+
+        const Fbx_Node* child(const char* child_name) const
+        {
+            for (const Fbx_Node& node : children)
+            {
+                if (node.name == child_name) return &node;
+            }
+            return nullptr;
+        }
+
+        // first property of the named child, or null
+        const Fbx_Property* value(const char* child_name) const
+        {
+            const Fbx_Node* node = child(child_name);
+            return (node && !node->properties.empty()) ? &node->properties[0] : nullptr;
+        }
+
+        std::int64_t id() const { return properties.empty() ? 0 : properties[0].integer(); }
+
+        // object names are stored as "name\x00\x01class"
+        std::string object_name() const
+        {
+            std::string full = properties.size() > 1 ? properties[1].string() : std::string();
+            return full.substr(0, full.find('\0'));
+        }
+    };
+
+    class Fbx_Reader
+    {
+    private:
+        const char* begin;
+        const char* end;
+        std::uint32_t version;
+
+        template <typename T>
+        T read(const char*& p)
+        {
+            if (std::size_t(end - p) < sizeof(T)) throw std::runtime_error("unexpected end of file");
+            T value;
+            std::memcpy(&value, p, sizeof(T));
+            p += sizeof(T);
+            return value;
+        }
+
+        std::uint64_t read_offset(const char*& p)
+        {
+            return version >= 7500 ? read<std::uint64_t>(p) : read<std::uint32_t>(p);
+        }
+
+        // returns false for the null record that terminates a node list
+        bool read_node(const char*& p, Fbx_Node& node)
+        {
+            std::uint64_t end_offset = read_offset(p);
+            std::uint64_t property_count = read_offset(p);
+            read_offset(p); // property list length
+            std::uint8_t name_length = read<std::uint8_t>(p);
+
+            if (end_offset == 0)
+            {
+                return false;
+            }
+
+            if (end_offset > std::uint64_t(end - begin) || std::size_t(end - p) < name_length)
+            {
+                throw std::runtime_error("node exceeds file");
+            }
+
+            const char* node_end = begin + end_offset;
+            node.name.assign(p, name_length);
+            p += name_length;
+
+            node.properties.resize(std::size_t(property_count));
+            for (Fbx_Property& property : node.properties)
+            {
+                property.type = read<char>(p);
+                property.count = 0;
+                property.encoding = 0;
+
+                switch (property.type)
+                {
+                case 'C': property.size = 1; break;
+                case 'Y': property.size = 2; break;
+                case 'I': case 'F': property.size = 4; break;
+                case 'D': case 'L': property.size = 8; break;
+
+                case 'S': case 'R':
+                    property.size = read<std::uint32_t>(p);
+                    break;
+
+                case 'f': case 'd': case 'l': case 'i': case 'b':
+                    property.count = read<std::uint32_t>(p);
+                    property.encoding = read<std::uint32_t>(p);
+                    property.size = read<std::uint32_t>(p);
+
+                    if (property.encoding > 1 || (property.encoding == 0 && property.size != property.count * property.element_size()))
+                    {
+                        throw std::runtime_error(fmt::format("invalid array in node \"{}\"", node.name));
+                    }
+                    break;
+
+                default:
+                    throw std::runtime_error(fmt::format("unknown property type '{}' in node \"{}\"", property.type, node.name));
+                }
+
+                if (std::size_t(node_end - p) < property.size)
+                {
+                    throw std::runtime_error(fmt::format("property exceeds node \"{}\"", node.name));
+                }
+
+                property.data = p;
+                p += property.size;
+            }
+
+            while (p < node_end)
+            {
+                node.children.emplace_back();
+                if (!read_node(p, node.children.back()))
+                {
+                    node.children.pop_back();
+                    break;
+                }
+            }
+
+            p = node_end;
+            return true;
+        }
+
+    public:
+        Fbx_Reader(const char* begin, const char* end) : begin(begin), end(end), version(0) {}
+
+        Fbx_Node read_document()
+        {
+            if (std::size_t(end - begin) < fbx_header_size || std::memcmp(begin, fbx_magic, sizeof(fbx_magic) - 1) != 0)
+            {
+                throw std::runtime_error("not a binary FBX file (ASCII FBX is not supported)");
+            }
+
+            const char* p = begin + 23;
+            version = read<std::uint32_t>(p);
+
+            Fbx_Node root;
+            while (p < end)
+            {
+                root.children.emplace_back();
+                if (!read_node(p, root.children.back()))
+                {
+                    root.children.pop_back();
+                    break;
+                }
+            }
+            return root;
+        }
+    };
+
+    // Inflates every compressed array below the given nodes. Arrays are independent zlib streams, so
+    // they are spread over all workers, largest first, each worker taking the next one as it finishes.
+    void decompress_arrays(const std::vector<Fbx_Node*>& nodes)
+    {
+        std::vector<Fbx_Property*> jobs;
+
+        std::function<void(Fbx_Node&)> collect = [&](Fbx_Node& node)
+        {
+            for (Fbx_Property& property : node.properties)
+            {
+                if (property.is_array() && property.encoding == 1) jobs.push_back(&property);
+            }
+            for (Fbx_Node& child : node.children) collect(child);
+        };
+
+        for (Fbx_Node* node : nodes) collect(*node);
+
+        std::sort(jobs.begin(), jobs.end(), [](const Fbx_Property* a, const Fbx_Property* b) { return a->size > b->size; });
+
+        std::atomic<std::size_t> next(0);
+        util::parallel_for(std::min(util::worker_count(), jobs.size()), [&](std::size_t, std::size_t, std::size_t)
+        {
+            for (std::size_t job; (job = next++) < jobs.size(); )
+            {
+                Fbx_Property& property = *jobs[job];
+                property.decoded.resize(std::size_t(property.count) * property.element_size());
+                inflate::zlib(property.data, property.size, property.decoded.data(), property.decoded.size());
+            }
+        });
+    }
+
+    // per corner attribute layer (normals, uvs, materials) with its mapping and reference mode
+    struct Fbx_Layer
+    {
+        std::vector<double> values;
+        std::vector<GLint> indices;
+        GLint components = 0;
+        std::string mapping;
+        bool indexed = false;
+
+        Fbx_Layer() = default;
+
+        Fbx_Layer(const Fbx_Node* layer, const char* values_name, const char* indices_name, GLint components)
+        : components(components)
+        {
+            if (!layer) return;
+
+            const Fbx_Property* value_array = layer->value(values_name);
+            const Fbx_Property* index_array = layer->value(indices_name);
+            const Fbx_Property* mapping_type = layer->value("MappingInformationType");
+            const Fbx_Property* reference_type = layer->value("ReferenceInformationType");
+
+            if (!value_array || !value_array->is_array()) return;
+
+            values = value_array->array<double>();
+            mapping = mapping_type ? mapping_type->string() : "ByPolygonVertex";
+            indexed = reference_type && reference_type->string() != "Direct" && index_array && index_array->is_array();
+            if (indexed) indices = index_array->array<GLint>();
+        }
+
+        bool empty() const { return values.empty(); }
+
+        // element for a corner; corner_missing when out of range
+        GLuint element(std::size_t corner, std::size_t polygon, std::size_t vertex) const
+        {
+            std::size_t i;
+            if (mapping == "ByPolygonVertex") i = corner;
+            else if (mapping == "ByVertice" || mapping == "ByVertex" || mapping == "ByControlPoint") i = vertex;
+            else if (mapping == "ByPolygon") i = polygon;
+            else i = 0; // AllSame
+
+            if (indexed)
+            {
+                if (i >= indices.size() || indices[i] < 0) return corner_missing;
+                i = std::size_t(indices[i]);
+            }
+
+            return (i + 1) * std::size_t(components) <= values.size() ? GLuint(i) : corner_missing;
+        }
+    };
+
+    Mesh_Data geometry_data(const Fbx_Node& geometry, const std::vector<Mesh_Material>& materials)
+    {
+        const Fbx_Property* vertex_array = geometry.value("Vertices");
+        const Fbx_Property* polygon_array = geometry.value("PolygonVertexIndex");
+
+        if (!vertex_array || !polygon_array || !vertex_array->is_array() || !polygon_array->is_array())
+        {
+            throw std::runtime_error(fmt::format("geometry \"{}\" has no vertices or polygons", geometry.object_name()));
+        }
+
+        const std::vector<double> positions = vertex_array->array<double>();
+        const std::vector<GLint> polygon_indices = polygon_array->array<GLint>();
+        const std::size_t position_count = positions.size() / 3;
+
+        const Fbx_Layer normals(geometry.child("LayerElementNormal"), "Normals", "NormalsIndex", 3);
+        const Fbx_Layer texcoords(geometry.child("LayerElementUV"), "UV", "UVIndex", 2);
+
+        // material indices are per polygon (or one for all) and index the materials of the model
+        std::vector<GLint> polygon_materials;
+        std::string material_mapping;
+        if (const Fbx_Node* layer = geometry.child("LayerElementMaterial"))
+        {
+            if (const Fbx_Property* material_array = layer->value("Materials")) polygon_materials = material_array->array<GLint>();
+            if (const Fbx_Property* mapping = layer->value("MappingInformationType")) material_mapping = mapping->string();
+        }
+
+        // triangulate polygons as fans and weld their corners
+        Corner_Table table(polygon_indices.size());
+        std::vector<Corner> unique;
+        std::vector<GLuint> triangles;
+        std::vector<GLint> triangle_materials;
+
+        std::vector<GLuint> polygon;
+        std::size_t polygon_index = 0;
+
+        for (std::size_t corner = 0; corner < polygon_indices.size(); ++corner)
+        {
+            GLint index = polygon_indices[corner];
+            bool last = index < 0;
+            std::size_t v = std::size_t(last ? ~index : index);
+
+            if (v >= position_count)
+            {
+                throw std::runtime_error(fmt::format("geometry \"{}\" references a vertex that does not exist", geometry.object_name()));
+            }
+
+            Corner key = { GLuint(v), texcoords.element(corner, polygon_index, v), normals.element(corner, polygon_index, v) };
+            GLuint welded = table.insert(key, GLuint(unique.size()));
+            if (welded == unique.size()) unique.push_back(key);
+            polygon.push_back(welded);
+
+            if (!last) continue;
+
+            GLint material = -1;
+            if (!materials.empty())
+            {
+                std::size_t m = (material_mapping == "ByPolygon") ? polygon_index : 0;
+                material = (m < polygon_materials.size()) ? polygon_materials[m] : 0;
+                if (material < 0 || std::size_t(material) >= materials.size()) material = 0;
+            }
+
+            for (std::size_t i = 1; i + 1 < polygon.size(); ++i)
+            {
+                triangles.insert(triangles.end(), { polygon[0], polygon[i], polygon[i + 1] });
+                triangle_materials.push_back(material);
+            }
+
+            polygon.clear();
+            polygon_index++;
+        }
+
+        if (triangles.empty())
+        {
+            throw std::runtime_error(fmt::format("geometry \"{}\" has no faces", geometry.object_name()));
+        }
+
+        Mesh_Data data;
+        data.materials = materials;
+        data.topology = GL_TRIANGLES;
+
+        // group triangles by material so each material is one contiguous submesh
+        const GLint material_slots = GLint(std::max<std::size_t>(materials.size(), 1));
+        std::vector<std::size_t> slot_start(std::size_t(material_slots) + 1, 0);
+        for (GLint material : triangle_materials) slot_start[std::size_t(std::max(material, 0)) + 1]++;
+        for (GLint m = 0; m < material_slots; ++m) slot_start[m + 1] += slot_start[m];
+
+        data.indices.resize(triangles.size());
+        std::vector<std::size_t> cursor(slot_start.begin(), slot_start.end() - 1);
+        for (std::size_t t = 0; t < triangle_materials.size(); ++t)
+        {
+            std::size_t& at = cursor[std::size_t(std::max(triangle_materials[t], 0))];
+            std::copy(&triangles[t * 3], &triangles[t * 3] + 3, &data.indices[at * 3]);
+            at++;
+        }
+
+        for (GLint m = 0; m < material_slots; ++m)
+        {
+            GLsizei count = GLsizei(slot_start[m + 1] - slot_start[m]) * 3;
+            if (count > 0)
+            {
+                data.submeshes.push_back({ GLsizei(slot_start[m] * 3), count, materials.empty() ? -1 : m });
+            }
+        }
+
+        // interleave the welded vertices
+        if (!normals.empty() && !texcoords.empty()) data.format = Vertex_Position_Normal_Texcoord::format();
+        else if (!normals.empty()) data.format = Vertex_Position_Normal::format();
+        else if (!texcoords.empty()) data.format = Vertex_Position_Texcoord::format();
+        else data.format = Vertex_Position::format();
+
+        data.vertex_count = GLsizei(unique.size());
+        data.vertices.resize(unique.size() * data.format.stride);
+
+        util::parallel_for(unique.size(), [&](std::size_t first, std::size_t last, std::size_t)
+        {
+            for (std::size_t v = first; v < last; ++v)
+            {
+                GLubyte* out = &data.vertices[v * data.format.stride];
+                const Corner& corner = unique[v];
+
+                for (GLuint a = 0; a < data.format.attrib_count; ++a)
+                {
+                    const Vertex_Attrib& attrib = data.format.attribs[a];
+
+                    GLfloat values[3] = { 0.0f, 0.0f, 0.0f };
+                    if (a == 0)
+                    {
+                        for (int c = 0; c < 3; ++c) values[c] = GLfloat(positions[corner.v * 3 + c]);
+                    }
+                    else
+                    {
+                        const bool normal = std::strcmp(attrib.name, "normal") == 0;
+                        const Fbx_Layer& layer = normal ? normals : texcoords;
+                        const GLuint element = normal ? corner.vn : corner.vt;
+
+                        for (GLint c = 0; element != corner_missing && c < attrib.size; ++c)
+                        {
+                            values[c] = GLfloat(layer.values[element * layer.components + c]);
+                        }
+                    }
+
+                    std::memcpy(out + attrib.offset, values, std::size_t(attrib.size) * sizeof(GLfloat));
+                }
+            }
+        }, 4096);
+
+        return data;
+    }
+
+    // values of a Properties70 "P" record start after its name, type, label and flags
+    const Fbx_Node* find_property(const Fbx_Node& object, const char* name)
+    {
+        const Fbx_Node* properties = object.child("Properties70");
+        if (!properties) return nullptr;
+
+        for (const Fbx_Node& property : properties->children)
+        {
+            if (property.properties.size() > 4 && property.properties[0].string() == name) return &property;
+        }
+        return nullptr;
+    }
+
+    bool read_vec3(const Fbx_Node& object, const char* name, glm::vec3& out)
+    {
+        const Fbx_Node* property = find_property(object, name);
+        if (!property || property->properties.size() < 7) return false;
+
+        out = glm::vec3(property->properties[4].number(), property->properties[5].number(), property->properties[6].number());
+        return true;
+    }
+
+    bool read_scalar(const Fbx_Node& object, const char* name, GLfloat& out)
+    {
+        const Fbx_Node* property = find_property(object, name);
+        if (!property) return false;
+
+        out = GLfloat(property->properties[4].number());
+        return true;
+    }
+
+    // local transform from the Lcl properties; pivots, pre- and post-rotations are not applied
+    glm::mat4 local_transform(const Fbx_Node& model)
+    {
+        glm::vec3 translation(0.0f), rotation(0.0f), scaling(1.0f);
+        read_vec3(model, "Lcl Translation", translation);
+        read_vec3(model, "Lcl Rotation", rotation);
+        read_vec3(model, "Lcl Scaling", scaling);
+
+        // euler XYZ: x is applied first
+        glm::mat4 result = glm::translate(glm::mat4(1.0f), translation);
+        result = glm::rotate(result, glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        result = glm::rotate(result, glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        result = glm::rotate(result, glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        return glm::scale(result, scaling);
+    }
+}
+
+std::vector<Mesh_Instance> Mesh::load_fbx(const std::string& fbx_file_path, GLbitfield optimize, Mesh_Storage storage)
+{
+    if (!fs::exists(fbx_file_path))
+    {
+        throw std::runtime_error(fmt::format("Failed to load mesh file \"{}\"; path does not exist", fbx_file_path));
+    }
+
+    try
+    {
+        Mapped_File file(fbx_file_path);
+        Fbx_Node document = Fbx_Reader(file.data(), file.data() + file.size()).read_document();
+
+        Fbx_Node* objects = nullptr;
+        for (Fbx_Node& node : document.children)
+        {
+            if (node.name == "Objects") objects = &node;
+        }
+
+        const Fbx_Node* connections = document.child("Connections");
+        if (!objects || !connections)
+        {
+            throw std::runtime_error("file has no objects or connections");
+        }
+
+        // only geometry arrays are needed; animation curves and the like stay compressed
+        std::vector<Fbx_Node*> geometries;
+        std::unordered_map<std::int64_t, const Fbx_Node*> object_ids;
+
+        for (Fbx_Node& object : objects->children)
+        {
+            object_ids[object.id()] = &object;
+            if (object.name == "Geometry") geometries.push_back(&object);
+        }
+
+        decompress_arrays(geometries);
+
+        // object links: children connect to parents, textures to material properties
+        std::unordered_map<std::int64_t, std::int64_t> model_parent;
+        std::unordered_map<std::int64_t, const Fbx_Node*> model_geometry;
+        std::unordered_map<std::int64_t, std::vector<const Fbx_Node*>> model_materials;
+        std::unordered_map<std::int64_t, const Fbx_Node*> material_diffuse_texture;
+        std::vector<const Fbx_Node*> models;
+
+        for (const Fbx_Node& connection : connections->children)
+        {
+            if (connection.name != "C" || connection.properties.size() < 3) continue;
+
+            const std::string type = connection.properties[0].string();
+            const std::int64_t child = connection.properties[1].integer();
+            const std::int64_t parent = connection.properties[2].integer();
+
+            auto child_it = object_ids.find(child);
+            if (child_it == object_ids.end()) continue;
+            const Fbx_Node* child_node = child_it->second;
+
+            auto parent_it = object_ids.find(parent);
+            const Fbx_Node* parent_node = (parent_it != object_ids.end()) ? parent_it->second : nullptr;
+
+            if (type == "OO" && child_node->name == "Model")
+            {
+                if (parent_node && parent_node->name == "Model") model_parent[child] = parent;
+            }
+            else if (type == "OO" && parent_node && parent_node->name == "Model")
+            {
+                if (child_node->name == "Geometry") model_geometry[parent] = child_node;
+                if (child_node->name == "Material") model_materials[parent].push_back(child_node);
+            }
+            else if (type == "OP" && parent_node && parent_node->name == "Material" && child_node->name == "Texture" &&
+                     connection.properties.size() > 3 && connection.properties[3].string() == "DiffuseColor")
+            {
+                material_diffuse_texture[parent] = child_node;
+            }
+        }
+
+        for (const Fbx_Node& object : objects->children)
+        {
+            if (object.name == "Model" && model_geometry.count(object.id())) models.push_back(&object);
+        }
+
+        auto material = [&](const Fbx_Node* node)
+        {
+            Mesh_Material result;
+            result.name = node->object_name();
+
+            glm::vec3 color;
+            if (read_vec3(*node, "DiffuseColor", color) || read_vec3(*node, "Diffuse", color)) result.diffuse = {{ color.x, color.y, color.z }};
+            if (read_vec3(*node, "AmbientColor", color) || read_vec3(*node, "Ambient", color)) result.ambient = {{ color.x, color.y, color.z }};
+            if (read_vec3(*node, "SpecularColor", color) || read_vec3(*node, "Specular", color)) result.specular = {{ color.x, color.y, color.z }};
+
+            if (!read_scalar(*node, "ShininessExponent", result.shininess)) read_scalar(*node, "Shininess", result.shininess);
+
+            GLfloat transparency;
+            if (!read_scalar(*node, "Opacity", result.opacity) && read_scalar(*node, "TransparencyFactor", transparency))
+            {
+                result.opacity = 1.0f - transparency;
+            }
+
+            auto texture = material_diffuse_texture.find(node->id());
+            if (texture != material_diffuse_texture.end())
+            {
+                const Fbx_Property* relative = texture->second->value("RelativeFilename");
+                const Fbx_Property* absolute = texture->second->value("FileName");
+
+                if (relative && !relative->string().empty())
+                {
+                    result.diffuse_map = (fs::path(fbx_file_path).parent_path() / relative->string()).string();
+                }
+                else if (absolute)
+                {
+                    result.diffuse_map = absolute->string();
+                }
+            }
+
+            return result;
+        };
+
+        std::function<glm::mat4(std::int64_t, int)> world_transform = [&](std::int64_t model, int depth) -> glm::mat4
+        {
+            glm::mat4 local = local_transform(*object_ids.at(model));
+            auto parent = model_parent.find(model);
+            if (parent == model_parent.end() || depth > 64) return local;
+            return world_transform(parent->second, depth + 1) * local;
+        };
+
+        // meshes are shared by models that use the same geometry with the same materials
+        std::map<std::vector<std::int64_t>, std::shared_ptr<Mesh>> meshes;
+        std::vector<Mesh_Instance> instances;
+
+        for (const Fbx_Node* model : models)
+        {
+            const Fbx_Node* geometry = model_geometry[model->id()];
+            const std::vector<const Fbx_Node*>& material_nodes = model_materials[model->id()];
+
+            std::vector<std::int64_t> key(1, geometry->id());
+            for (const Fbx_Node* node : material_nodes) key.push_back(node->id());
+
+            std::shared_ptr<Mesh>& mesh = meshes[key];
+            if (!mesh)
+            {
+                std::vector<Mesh_Material> materials;
+                for (const Fbx_Node* node : material_nodes) materials.push_back(material(node));
+
+                mesh = std::make_shared<Mesh>(geometry_data(*geometry, materials), GL_STATIC_DRAW, storage, optimize);
+            }
+
+            instances.push_back({ mesh, world_transform(model->id(), 0) });
+        }
+
+        return instances;
+    }
+    catch (const std::runtime_error& e)
+    {
+        throw std::runtime_error(fmt::format("Failed to load FBX file \"{}\": {}", fbx_file_path, e.what()));
+    }
+}
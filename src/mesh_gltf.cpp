@@ -0,0 +1,687 @@
+#include "mesh.hpp"
+
+#include <cmath>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <experimental/filesystem>
+
+#include <fmt/format.h>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "json.hpp"
+#include "util.hpp"
+#include "mapped_file.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    const std::uint32_t glb_magic = 0x46546c67;         // "glTF"
+    const std::uint32_t glb_chunk_json = 0x4e4f534a;    // "JSON"
+    const std::uint32_t glb_chunk_bin = 0x004e4942;     // "BIN\0"
+
+    // glTF attribute semantics and the vertex.hpp attribute names they map onto
+    const char* const semantics[][2] =
+    {
+        { "POSITION",   "position" },
+        { "NORMAL",     "normal" },
+        { "TEXCOORD_0", "texcoord" },
+        { "COLOR_0",    "color" }
+    };
+
+    struct Gltf_Buffer
+    {
+        const GLubyte* data;
+        std::size_t size;
+    };
+
+    // typed view of accessor elements; the component types share their values with the GL enums
+    struct Gltf_Accessor
+    {
+        const GLubyte* data;        // first element
+        const GLubyte* buffer_end;  // end of the underlying buffer
+        std::size_t count;
+        GLsizei stride;             // bytes from one element to the next
+        GLenum component_type;      // GL_BYTE, GL_UNSIGNED_BYTE, GL_SHORT, GL_UNSIGNED_SHORT, GL_UNSIGNED_INT or GL_FLOAT
+        GLint components;
+        GLboolean normalized;
+        GLint view;
+        const Json* min;
+        const Json* max;
+
+        // element i converted to floats, normalized integers mapped to [0, 1] or [-1, 1]
+        void read(std::size_t i, GLfloat* out, GLint n) const
+        {
+            const GLubyte* element = data + i * stride;
+
+            for (GLint c = 0; c < n; ++c)
+            {
+                if (c >= components)
+                {
+                    out[c] = 0.0f;
+                    continue;
+                }
+
+                switch (component_type)
+                {
+                case GL_FLOAT:          std::memcpy(&out[c], element + c * 4, 4); break;
+                case GL_UNSIGNED_BYTE:  out[c] = normalized ? element[c] / 255.0f : GLfloat(element[c]); break;
+                case GL_BYTE:           out[c] = normalized ? std::max(GLbyte(element[c]) / 127.0f, -1.0f) : GLfloat(GLbyte(element[c])); break;
+                case GL_UNSIGNED_SHORT: { GLushort v; std::memcpy(&v, element + c * 2, 2); out[c] = normalized ? v / 65535.0f : GLfloat(v); break; }
+                case GL_SHORT:          { GLshort v; std::memcpy(&v, element + c * 2, 2); out[c] = normalized ? std::max(v / 32767.0f, -1.0f) : GLfloat(v); break; }
+                case GL_UNSIGNED_INT:   { GLuint v; std::memcpy(&v, element + c * 4, 4); out[c] = GLfloat(v); break; }
+                default:                out[c] = 0.0f; break;
+                }
+            }
+        }
+
+        GLuint read_index(std::size_t i) const
+        {
+            const GLubyte* element = data + i * stride;
+
+            switch (component_type)
+            {
+            case GL_UNSIGNED_BYTE:  return element[0];
+            case GL_UNSIGNED_SHORT: { GLushort v; std::memcpy(&v, element, 2); return v; }
+            default:                { GLuint v; std::memcpy(&v, element, 4); return v; }
+            }
+        }
+    };
+
+    GLsizei component_size(GLenum component_type)
+    {
+        switch (component_type)
+        {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:  return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT: return 2;
+        case GL_UNSIGNED_INT:
+        case GL_FLOAT:          return 4;
+        default:                throw std::runtime_error(fmt::format("unsupported component type {}", component_type));
+        }
+    }
+
+    GLint component_count(const std::string& type)
+    {
+        if (type == "SCALAR") return 1;
+        if (type == "VEC2") return 2;
+        if (type == "VEC3") return 3;
+        if (type == "VEC4") return 4;
+        throw std::runtime_error(fmt::format("unsupported accessor type \"{}\"", type));
+    }
+
+    std::vector<GLubyte> decode_base64(const char* p, const char* end)
+    {
+        auto value = [](char c) -> int
+        {
+            if (c >= 'A' && c <= 'Z') return c - 'A';
+            if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+            if (c >= '0' && c <= '9') return c - '0' + 52;
+            if (c == '+' || c == '-') return 62;
+            if (c == '/' || c == '_') return 63;
+            return -1;
+        };
+
+        std::vector<GLubyte> out;
+        out.reserve(std::size_t(end - p) / 4 * 3);
+
+        std::uint32_t bits = 0;
+        int count = 0;
+
+        for (; p < end && *p != '='; ++p)
+        {
+            int v = value(*p);
+            if (v < 0) throw std::runtime_error("invalid base64 data");
+
+            bits = (bits << 6) | std::uint32_t(v);
+            if (++count == 4)
+            {
+                out.push_back(GLubyte(bits >> 16));
+                out.push_back(GLubyte(bits >> 8));
+                out.push_back(GLubyte(bits));
+                bits = 0;
+                count = 0;
+            }
+        }
+
+        if (count == 2) out.push_back(GLubyte(bits >> 4));
+        if (count == 3) { out.push_back(GLubyte(bits >> 10)); out.push_back(GLubyte(bits >> 2)); }
+        return out;
+    }
+
+    std::string decode_uri(const std::string& uri)
+    {
+        std::string out;
+        for (std::size_t i = 0; i < uri.size(); ++i)
+        {
+            if (uri[i] == '%' && i + 2 < uri.size() && std::isxdigit((unsigned char)uri[i + 1]) && std::isxdigit((unsigned char)uri[i + 2]))
+            {
+                out += char(std::strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16));
+                i += 2;
+            }
+            else
+            {
+                out += uri[i];
+            }
+        }
+        return out;
+    }
+
+    class Gltf_Document
+    {
+    private:
+        fs::path directory;
+        std::unique_ptr<Mapped_File> file;
+        std::vector<std::unique_ptr<Mapped_File>> mapped_buffers;
+        std::vector<std::vector<GLubyte>> decoded_buffers;  // embedded data: uris
+        std::vector<Gltf_Buffer> buffers;
+
+    public:
+        Json json;
+
+        explicit Gltf_Document(const std::string& path)
+        : directory(fs::path(path).parent_path()), file(new Mapped_File(path))
+        {
+            const char* data = file->data();
+            const std::size_t size = file->size();
+
+            Gltf_Buffer binary_chunk = { nullptr, 0 };
+
+            auto read32 = [&](std::size_t offset)
+            {
+                std::uint32_t value;
+                std::memcpy(&value, data + offset, 4);
+                return value;
+            };
+
+            if (size >= 12 && read32(0) == glb_magic)
+            {
+                if (read32(4) != 2)
+                {
+                    throw std::runtime_error(fmt::format("unsupported GLB version {}", read32(4)));
+                }
+
+                std::size_t length = std::min<std::size_t>(read32(8), size);
+                bool has_json = false;
+
+                for (std::size_t offset = 12; offset + 8 <= length; )
+                {
+                    std::size_t chunk_length = read32(offset);
+                    std::uint32_t chunk_type = read32(offset + 4);
+                    const char* chunk = data + offset + 8;
+
+                    if (chunk_length > length - offset - 8)
+                    {
+                        throw std::runtime_error("truncated GLB chunk");
+                    }
+
+                    if (chunk_type == glb_chunk_json && !has_json)
+                    {
+                        json = Json::parse(chunk, chunk + chunk_length);
+                        has_json = true;
+                    }
+                    else if (chunk_type == glb_chunk_bin && !binary_chunk.data)
+                    {
+                        binary_chunk = { reinterpret_cast<const GLubyte*>(chunk), chunk_length };
+                    }
+
+                    offset += 8 + ((chunk_length + 3) & ~std::size_t(3));
+                }
+
+                if (!has_json)
+                {
+                    throw std::runtime_error("GLB file has no JSON chunk");
+                }
+            }
+            else
+            {
+                json = Json::parse(data, data + size);
+            }
+
+            const std::string& version = json["asset"]["version"].as_string();
+            if (version.empty() || version[0] != '2')
+            {
+                throw std::runtime_error(fmt::format("unsupported glTF version \"{}\"", version));
+            }
+
+            for (const Json& buffer : json["buffers"].array())
+            {
+                std::size_t byte_length = std::size_t(buffer["byteLength"].as_integer());
+                Gltf_Buffer view = { nullptr, 0 };
+
+                if (!buffer.has("uri"))
+                {
+                    view = binary_chunk; // the GLB binary chunk
+                }
+                else
+                {
+                    const std::string& uri = buffer["uri"].as_string();
+
+                    if (uri.compare(0, 5, "data:") == 0)
+                    {
+                        std::size_t comma = uri.find(',');
+                        if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+                        {
+                            throw std::runtime_error("unsupported data uri");
+                        }
+
+                        decoded_buffers.push_back(decode_base64(uri.data() + comma + 1, uri.data() + uri.size()));
+                        view = { decoded_buffers.back().data(), decoded_buffers.back().size() };
+                    }
+                    else
+                    {
+                        // large .bin files are mapped, not read; the pages are pulled in as they are uploaded
+                        mapped_buffers.emplace_back(new Mapped_File((directory / decode_uri(uri)).string()));
+                        view = { reinterpret_cast<const GLubyte*>(mapped_buffers.back()->data()), mapped_buffers.back()->size() };
+                    }
+                }
+
+                if (view.size < byte_length)
+                {
+                    throw std::runtime_error(fmt::format("buffer {} is shorter than its byteLength", buffers.size()));
+                }
+
+                buffers.push_back({ view.data, byte_length });
+            }
+        }
+
+        Gltf_Accessor accessor(long long index) const
+        {
+            const Json& accessor = json["accessors"][std::size_t(index)];
+            if (!accessor.is_object())
+            {
+                throw std::runtime_error(fmt::format("accessor {} does not exist", index));
+            }
+
+            if (accessor.has("sparse") || !accessor.has("bufferView"))
+            {
+                throw std::runtime_error(fmt::format("accessor {}: sparse and buffer-less accessors are not supported", index));
+            }
+
+            GLint view_index = GLint(accessor["bufferView"].as_integer());
+            const Json& view = json["bufferViews"][std::size_t(view_index)];
+            std::size_t buffer_index = std::size_t(view["buffer"].as_integer(-1));
+
+            if (!view.is_object() || buffer_index >= buffers.size())
+            {
+                throw std::runtime_error(fmt::format("accessor {} references a missing buffer", index));
+            }
+
+            Gltf_Accessor result;
+            result.component_type = GLenum(accessor["componentType"].as_integer());
+            result.components = component_count(accessor["type"].as_string());
+            result.normalized = accessor["normalized"].as_bool() ? GL_TRUE : GL_FALSE;
+            result.count = std::size_t(accessor["count"].as_integer());
+            result.view = view_index;
+            result.min = &accessor["min"];
+            result.max = &accessor["max"];
+
+            GLsizei element_size = component_size(result.component_type) * result.components;
+            result.stride = GLsizei(view["byteStride"].as_integer(element_size));
+
+            std::size_t view_offset = std::size_t(view["byteOffset"].as_integer());
+            std::size_t view_length = std::size_t(view["byteLength"].as_integer());
+            std::size_t offset = std::size_t(accessor["byteOffset"].as_integer());
+
+            const Gltf_Buffer& buffer = buffers[buffer_index];
+            if (view_offset + view_length > buffer.size ||
+                (result.count > 0 && offset + (result.count - 1) * std::size_t(result.stride) + std::size_t(element_size) > view_length))
+            {
+                throw std::runtime_error(fmt::format("accessor {} exceeds its buffer view", index));
+            }
+
+            result.data = buffer.data + view_offset + offset;
+            result.buffer_end = buffer.data + buffer.size;
+            return result;
+        }
+
+        Mesh_Material material(long long index) const
+        {
+            const Json& source = json["materials"][std::size_t(index)];
+            const Json& pbr = source["pbrMetallicRoughness"];
+
+            Mesh_Material material;
+            material.name = source["name"].as_string();
+
+            // base color stands in for the diffuse term; metallic-roughness has no equivalent here
+            const Json& factor = pbr["baseColorFactor"];
+            if (factor.size() == 4)
+            {
+                material.diffuse = {{ GLfloat(factor[0].as_number()), GLfloat(factor[1].as_number()), GLfloat(factor[2].as_number()) }};
+                material.opacity = GLfloat(factor[3].as_number());
+            }
+
+            const Json& texture = pbr["baseColorTexture"];
+            if (texture.has("index"))
+            {
+                const Json& image = json["images"][std::size_t(json["textures"][std::size_t(texture["index"].as_integer())]["source"].as_integer(-1))];
+                const std::string& uri = image["uri"].as_string();
+
+                if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+                {
+                    material.diffuse_map = (directory / decode_uri(uri)).string();
+                }
+            }
+
+            return material;
+        }
+    };
+
+    // the layout from vertex.hpp whose attributes sit exactly where the accessors put them, if any
+    const Vertex_Format* matching_layout(const std::vector<std::pair<const char*, Gltf_Accessor>>& attributes)
+    {
+        const Gltf_Accessor& first = attributes.front().second;
+        const GLubyte* base = first.data;
+
+        for (const std::pair<const char*, Gltf_Accessor>& attribute : attributes)
+        {
+            const Gltf_Accessor& accessor = attribute.second;
+            if (accessor.view != first.view || accessor.stride != first.stride || accessor.count != first.count)
+            {
+                return nullptr;
+            }
+
+            base = std::min(base, accessor.data);
+        }
+
+        // the whole last vertex has to be inside the buffer, as GL sizes the buffer by vertex_count * stride
+        if (base + first.count * std::size_t(first.stride) > first.buffer_end)
+        {
+            return nullptr;
+        }
+
+        for (const Vertex_Format* format : vertex_formats())
+        {
+            if (format->stride != first.stride || format->attrib_count != attributes.size()) continue;
+
+            bool match = true;
+            for (GLuint i = 0; i < format->attrib_count && match; ++i)
+            {
+                const Vertex_Attrib& attrib = format->attribs[i];
+
+                auto it = std::find_if(attributes.begin(), attributes.end(), [&](const std::pair<const char*, Gltf_Accessor>& a)
+                {
+                    return std::strcmp(a.first, attrib.name) == 0;
+                });
+
+                match = it != attributes.end() &&
+                        it->second.component_type == attrib.type &&
+                        it->second.components == attrib.size &&
+                        it->second.normalized == attrib.normalized &&
+                        GLsizei(it->second.data - base) == attrib.offset;
+            }
+
+            if (match) return format;
+        }
+
+        return nullptr;
+    }
+
+    glm::mat4 node_transform(const Json& node)
+    {
+        const Json& matrix = node["matrix"];
+        if (matrix.size() == 16)
+        {
+            glm::mat4 result;
+            for (int i = 0; i < 16; ++i)
+            {
+                glm::value_ptr(result)[i] = GLfloat(matrix[std::size_t(i)].as_number()); // column major, like glm
+            }
+            return result;
+        }
+
+        const Json& t = node["translation"];
+        const Json& r = node["rotation"];
+        const Json& s = node["scale"];
+
+        glm::mat4 result(1.0f);
+        if (t.size() == 3) result = glm::translate(result, glm::vec3(t[0].as_number(), t[1].as_number(), t[2].as_number()));
+        if (r.size() == 4) result *= glm::mat4_cast(glm::quat(GLfloat(r[3].as_number()), GLfloat(r[0].as_number()), GLfloat(r[1].as_number()), GLfloat(r[2].as_number())));
+        if (s.size() == 3) result = glm::scale(result, glm::vec3(s[0].as_number(), s[1].as_number(), s[2].as_number()));
+        return result;
+    }
+}
+
+std::vector<Mesh_Instance> Mesh::load_gltf(const std::string& gltf_file_path, GLbitfield optimize, Mesh_Storage storage)
+{
+    if (!fs::exists(gltf_file_path))
+    {
+        throw std::runtime_error(fmt::format("Failed to load mesh file \"{}\"; path does not exist", gltf_file_path));
+    }
+
+    try
+    {
+        Gltf_Document document(gltf_file_path);
+        const Json& json = document.json;
+
+        auto load_primitive = [&](const Json& primitive) -> std::shared_ptr<Mesh>
+        {
+            std::vector<std::pair<const char*, Gltf_Accessor>> attributes;
+            for (const auto& semantic : semantics)
+            {
+                const Json& index = primitive["attributes"][semantic[0]];
+                if (!index.is_null())
+                {
+                    attributes.emplace_back(semantic[1], document.accessor(index.as_integer()));
+                }
+            }
+
+            if (attributes.empty() || std::strcmp(attributes.front().first, "position") != 0)
+            {
+                throw std::runtime_error("primitive has no POSITION attribute");
+            }
+
+            const Gltf_Accessor& positions = attributes.front().second;
+            const GLsizei vertex_count = GLsizei(positions.count);
+            const GLenum mode = GLenum(primitive["mode"].as_integer(GL_TRIANGLES)); // glTF modes are the GL primitive types
+
+            if (vertex_count < 1)
+            {
+                throw std::runtime_error("primitive has no vertices");
+            }
+
+            Gltf_Accessor indices = {};
+            const bool indexed = primitive.has("indices");
+            if (indexed)
+            {
+                indices = document.accessor(primitive["indices"].as_integer());
+                if (indices.components != 1 || (indices.component_type != GL_UNSIGNED_BYTE && indices.component_type != GL_UNSIGNED_SHORT && indices.component_type != GL_UNSIGNED_INT))
+                {
+                    throw std::runtime_error("index accessors must be unsigned integer scalars");
+                }
+            }
+
+            std::vector<Mesh_Material> materials;
+            GLint material = -1;
+            if (primitive.has("material"))
+            {
+                materials.push_back(document.material(primitive["material"].as_integer()));
+                material = 0;
+            }
+
+            const Vertex_Format* layout = matching_layout(attributes);
+            const GLubyte* vertex_block = nullptr;
+            if (layout)
+            {
+                vertex_block = positions.data;
+                for (const auto& attribute : attributes) vertex_block = std::min(vertex_block, attribute.second.data);
+            }
+
+            // fast path: buffer views go to the GPU as they are
+            if (layout && optimize == MESH_OPTIMIZE_NONE)
+            {
+                std::shared_ptr<Mesh> mesh(new Mesh(*layout, mode, GL_STATIC_DRAW, storage));
+                mesh->vertex_count = vertex_count;
+                mesh->index_count = indexed ? GLsizei(indices.count) : 0;
+                mesh->materials = std::move(materials);
+                mesh->submeshes.push_back({ 0, indexed ? mesh->index_count : vertex_count, material });
+
+                if (positions.min->size() == 3 && positions.max->size() == 3)
+                {
+                    const Json& min = *positions.min;
+                    const Json& max = *positions.max;
+                    mesh->bounds.min = glm::vec3(min[0].as_number(), min[1].as_number(), min[2].as_number());
+                    mesh->bounds.max = glm::vec3(max[0].as_number(), max[1].as_number(), max[2].as_number());
+                }
+
+                std::vector<GLuint> index_list;
+                if (indexed && indices.stride == component_size(indices.component_type))
+                {
+                    mesh->index_type = indices.component_type;
+                    mesh->create_buffers(vertex_block, indices.data, GLsizeiptr(indices.count) * indices.stride);
+                }
+                else
+                {
+                    for (std::size_t i = 0; indexed && i < indices.count; ++i) index_list.push_back(indices.read_index(i));
+                    mesh->create_buffers(vertex_block, index_list);
+                }
+
+                if (storage == MESH_STORAGE_GPU_AND_CPU)
+                {
+                    mesh->vertices.assign(vertex_block, vertex_block + std::size_t(vertex_count) * layout->stride);
+                    for (std::size_t i = 0; indexed && index_list.empty() && i < indices.count; ++i) index_list.push_back(indices.read_index(i));
+                    mesh->indices = std::move(index_list);
+                }
+
+                return mesh;
+            }
+
+            Mesh_Data data;
+            data.vertex_count = vertex_count;
+            data.topology = mode;
+            data.materials = std::move(materials);
+
+            if (layout)
+            {
+                // already interleaved as one of our layouts; only copied because it is optimized in place
+                data.format = *layout;
+                data.vertices.assign(vertex_block, vertex_block + std::size_t(vertex_count) * layout->stride);
+            }
+            else
+            {
+                auto find = [&](const char* name) -> const Gltf_Accessor*
+                {
+                    for (const auto& attribute : attributes)
+                    {
+                        if (std::strcmp(attribute.first, name) == 0 && attribute.second.count == positions.count) return &attribute.second;
+                    }
+                    return nullptr;
+                };
+
+                const Gltf_Accessor* normals = find("normal");
+                const Gltf_Accessor* texcoords = find("texcoord");
+                const Gltf_Accessor* colors = find("color");
+
+                if (normals && texcoords) data.format = Vertex_Position_Normal_Texcoord::format();
+                else if (normals) data.format = Vertex_Position_Normal::format();
+                else if (texcoords) data.format = Vertex_Position_Texcoord::format();
+                else if (colors) data.format = Vertex_Position_Color::format();
+                else data.format = Vertex_Position::format();
+
+                data.vertices.resize(std::size_t(vertex_count) * data.format.stride);
+
+                util::parallel_for(std::size_t(vertex_count), [&](std::size_t first, std::size_t last, std::size_t)
+                {
+                    for (std::size_t v = first; v < last; ++v)
+                    {
+                        for (GLuint a = 0; a < data.format.attrib_count; ++a)
+                        {
+                            const Vertex_Attrib& attrib = data.format.attribs[a];
+
+                            GLfloat values[4];
+                            find(attrib.name)->read(v, values, attrib.size);
+                            std::memcpy(&data.vertices[v * data.format.stride + attrib.offset], values, std::size_t(attrib.size) * sizeof(GLfloat));
+                        }
+                    }
+                }, 4096);
+            }
+
+            for (std::size_t i = 0; indexed && i < indices.count; ++i)
+            {
+                data.indices.push_back(indices.read_index(i));
+            }
+
+            data.submeshes.push_back({ 0, indexed ? GLsizei(data.indices.size()) : vertex_count, material });
+            return std::make_shared<Mesh>(std::move(data), GL_STATIC_DRAW, storage, optimize);
+        };
+
+        // primitives are loaded once per mesh, however many nodes instance them
+        std::vector<std::vector<std::shared_ptr<Mesh>>> meshes(json["meshes"].size());
+        auto mesh_primitives = [&](std::size_t mesh_index) -> const std::vector<std::shared_ptr<Mesh>>&
+        {
+            if (mesh_index >= meshes.size())
+            {
+                throw std::runtime_error(fmt::format("mesh {} does not exist", mesh_index));
+            }
+
+            std::vector<std::shared_ptr<Mesh>>& primitives = meshes[mesh_index];
+            if (primitives.empty())
+            {
+                for (const Json& primitive : json["meshes"][mesh_index]["primitives"].array())
+                {
+                    primitives.push_back(load_primitive(primitive));
+                }
+            }
+            return primitives;
+        };
+
+        std::vector<Mesh_Instance> instances;
+        const Json& nodes = json["nodes"];
+
+        std::function<void(std::size_t, const glm::mat4&, int)> visit = [&](std::size_t node_index, const glm::mat4& parent, int depth)
+        {
+            const Json& node = nodes[node_index];
+            if (!node.is_object() || depth > 64)
+            {
+                throw std::runtime_error(fmt::format("node {} does not exist or the hierarchy has a cycle", node_index));
+            }
+
+            glm::mat4 transform = parent * node_transform(node);
+
+            if (node.has("mesh"))
+            {
+                for (const std::shared_ptr<Mesh>& mesh : mesh_primitives(std::size_t(node["mesh"].as_integer())))
+                {
+                    instances.push_back({ mesh, transform });
+                }
+            }
+
+            for (const Json& child : node["children"].array())
+            {
+                visit(std::size_t(child.as_integer()), transform, depth + 1);
+            }
+        };
+
+        const Json& scene = json["scenes"][std::size_t(json["scene"].as_integer(0))];
+        if (scene.is_object())
+        {
+            for (const Json& root : scene["nodes"].array())
+            {
+                visit(std::size_t(root.as_integer()), glm::mat4(1.0f), 0);
+            }
+        }
+        else
+        {
+            // no scene: every mesh once, untransformed
+            for (std::size_t m = 0; m < meshes.size(); ++m)
+            {
+                for (const std::shared_ptr<Mesh>& mesh : mesh_primitives(m))
+                {
+                    instances.push_back({ mesh, glm::mat4(1.0f) });
+                }
+            }
+        }
+
+        return instances;
+    }
+    catch (const std::runtime_error& e)
+    {
+        throw std::runtime_error(fmt::format("Failed to load glTF file \"{}\": {}", gltf_file_path, e.what()));
+    }
+}
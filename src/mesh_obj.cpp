@@ -0,0 +1,637 @@
+#include "mesh.hpp"
+
+#include <cmath>
+#include <limits>
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <experimental/filesystem>
+
+#include <fmt/format.h>
+
+#include "util.hpp"
+#include "mapped_file.hpp"
+#include "corner_table.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    // negative (relative) references can only be resolved once the counts of earlier chunks are known
+    struct Obj_Fixup
+    {
+        std::size_t corner;
+        int component;      // 0 = v, 1 = vt, 2 = vn
+        GLint local_index;  // relative to the first element of the chunk; may be negative
+    };
+
+    struct Obj_Material_Use
+    {
+        std::size_t first_triangle; // chunk-local
+        std::string name;
+    };
+
+    struct Obj_Chunk
+    {
+        std::vector<GLfloat> positions;
+        std::vector<GLfloat> texcoords;
+        std::vector<GLfloat> normals;
+        std::vector<Corner> corners;
+        std::vector<Obj_Fixup> fixups;
+        std::vector<Obj_Material_Use> material_uses;
+        std::vector<std::string> material_libraries;
+
+        std::size_t line; // first line number, for error messages
+    };
+
+    inline bool is_space(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline const char* skip_space(const char* p, const char* end)
+    {
+        while (p < end && is_space(*p)) ++p;
+        return p;
+    }
+
+    inline const char* skip_line(const char* p, const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', std::size_t(end - p)));
+        return newline ? newline + 1 : end;
+    }
+
+    inline const char* line_end(const char* p, const char* end)
+    {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', std::size_t(end - p)));
+        return newline ? newline : end;
+    }
+
+    // decimal float without locale or allocation; exact powers of ten cover all common obj output
+    const char* parse_float(const char* p, const char* end, GLfloat& value)
+    {
+        static const double powers[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        p = skip_space(p, end);
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        std::uint64_t mantissa = 0;
+        int exponent = 0;
+        int significant = 0;
+        bool digits = false;
+
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            digits = true;
+            if (significant < 19)
+            {
+                mantissa = mantissa * 10 + std::uint64_t(*p - '0');
+                significant += (mantissa != 0);
+            }
+            else
+            {
+                exponent++;
+            }
+        }
+
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && *p >= '0' && *p <= '9'; ++p)
+            {
+                digits = true;
+                if (significant < 19)
+                {
+                    mantissa = mantissa * 10 + std::uint64_t(*p - '0');
+                    significant += (mantissa != 0);
+                    exponent--;
+                }
+            }
+        }
+
+        if (!digits)
+        {
+            throw std::runtime_error("Malformed number");
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            ++p;
+            bool negative_exponent = false;
+            if (p < end && (*p == '-' || *p == '+'))
+            {
+                negative_exponent = (*p == '-');
+                ++p;
+            }
+
+            int e = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; ++p)
+            {
+                e = std::min(e * 10 + (*p - '0'), 1000);
+            }
+            exponent += negative_exponent ? -e : e;
+        }
+
+        double result = double(mantissa);
+        if (exponent >= 0)
+        {
+            result = (exponent <= 22) ? result * powers[exponent] : result * std::pow(10.0, exponent);
+        }
+        else
+        {
+            result = (exponent >= -22) ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+        }
+
+        value = GLfloat(negative ? -result : result);
+        return p;
+    }
+
+    const char* parse_int(const char* p, const char* end, GLint& value)
+    {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        if (p >= end || *p < '0' || *p > '9')
+        {
+            throw std::runtime_error("Malformed index");
+        }
+
+        GLint result = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p)
+        {
+            result = result * 10 + (*p - '0');
+        }
+
+        value = negative ? -result : result;
+        return p;
+    }
+
+    inline bool keyword(const char* p, const char* end, const char* word)
+    {
+        std::size_t length = std::strlen(word);
+        return std::size_t(end - p) > length && std::memcmp(p, word, length) == 0 && is_space(p[length]);
+    }
+
+    std::string rest_of_line(const char* p, const char* end)
+    {
+        p = skip_space(p, end);
+        const char* e = line_end(p, end);
+        while (e > p && is_space(e[-1])) --e;
+        return std::string(p, e);
+    }
+
+    void parse_chunk(const char* p, const char* end, Obj_Chunk& chunk)
+    {
+        std::vector<Corner> face;
+        std::size_t line = chunk.line;
+
+        try
+        {
+            for (; p < end; p = skip_line(p, end), ++line)
+            {
+                p = skip_space(p, end);
+                if (p >= end) break;
+
+                if (p[0] == 'v' && p + 1 < end)
+                {
+                    if (is_space(p[1]))
+                    {
+                        GLfloat x, y, z;
+                        p = parse_float(p + 1, end, x);
+                        p = parse_float(p, end, y);
+                        p = parse_float(p, end, z);
+                        chunk.positions.insert(chunk.positions.end(), { x, y, z });
+                    }
+                    else if (p[1] == 't' && p + 2 < end && is_space(p[2]))
+                    {
+                        GLfloat u, v = 0.0f;
+                        p = parse_float(p + 2, end, u);
+                        const char* q = skip_space(p, end);
+                        if (q < end && *q != '\n') p = parse_float(q, end, v);
+                        chunk.texcoords.insert(chunk.texcoords.end(), { u, v });
+                    }
+                    else if (p[1] == 'n' && p + 2 < end && is_space(p[2]))
+                    {
+                        GLfloat x, y, z;
+                        p = parse_float(p + 2, end, x);
+                        p = parse_float(p, end, y);
+                        p = parse_float(p, end, z);
+                        chunk.normals.insert(chunk.normals.end(), { x, y, z });
+                    }
+                }
+                else if (p[0] == 'f' && p + 1 < end && is_space(p[1]))
+                {
+                    face.clear();
+                    std::vector<Obj_Fixup> face_fixups;
+
+                    const char* e = line_end(p, end);
+                    p = skip_space(p + 1, e);
+
+                    while (p < e && *p != '#')
+                    {
+                        Corner corner = { corner_missing, corner_missing, corner_missing };
+                        GLuint* components[3] = { &corner.v, &corner.vt, &corner.vn };
+                        const std::size_t counts[3] = { chunk.positions.size() / 3, chunk.texcoords.size() / 2, chunk.normals.size() / 3 };
+
+                        for (int c = 0; c < 3; ++c)
+                        {
+                            if (c > 0)
+                            {
+                                if (p >= e || *p != '/') break;
+                                ++p;
+                                if (p < e && *p == '/') continue; // v//vn
+                            }
+
+                            GLint index;
+                            p = parse_int(p, e, index);
+
+                            if (index > 0)
+                            {
+                                *components[c] = GLuint(index - 1);
+                            }
+                            else if (index < 0)
+                            {
+                                face_fixups.push_back({ face.size(), c, GLint(counts[c]) + index });
+                            }
+                            else
+                            {
+                                throw std::runtime_error("Index 0 is not valid");
+                            }
+                        }
+
+                        face.push_back(corner);
+                        p = skip_space(p, e);
+                    }
+
+                    if (face.size() < 3)
+                    {
+                        throw std::runtime_error("Face with less than three vertices");
+                    }
+
+                    // triangulate as a fan around the first corner
+                    for (std::size_t i = 1; i + 1 < face.size(); ++i)
+                    {
+                        std::size_t first = chunk.corners.size();
+                        const std::size_t source[3] = { 0, i, i + 1 };
+
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            chunk.corners.push_back(face[source[k]]);
+                            for (const Obj_Fixup& fixup : face_fixups)
+                            {
+                                if (fixup.corner == source[k])
+                                {
+                                    chunk.fixups.push_back({ first + k, fixup.component, fixup.local_index });
+                                }
+                            }
+                        }
+                    }
+                }
+                else if (keyword(p, end, "usemtl"))
+                {
+                    chunk.material_uses.push_back({ chunk.corners.size() / 3, rest_of_line(p + 6, end) });
+                }
+                else if (keyword(p, end, "mtllib"))
+                {
+                    chunk.material_libraries.push_back(rest_of_line(p + 6, end));
+                }
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            throw std::runtime_error(fmt::format("{} on line {}", e.what(), line));
+        }
+    }
+
+    void parse_mtl(const fs::path& mtl_path, std::vector<Mesh_Material>& materials)
+    {
+        if (!fs::exists(mtl_path))
+        {
+            return; // materials fall back to defaults
+        }
+
+        Mapped_File file(mtl_path.string());
+        const char* p = file.data();
+        const char* end = p + file.size();
+
+        Mesh_Material* material = nullptr;
+
+        auto read3 = [&](const char* q, std::array<GLfloat, 3>& out)
+        {
+            q = parse_float(q, end, out[0]);
+            const char* r = skip_space(q, end);
+            if (r < end && *r != '\n')
+            {
+                q = parse_float(q, end, out[1]);
+                q = parse_float(q, end, out[2]);
+            }
+            else
+            {
+                out[1] = out[2] = out[0];
+            }
+        };
+
+        for (; p < end; p = skip_line(p, end))
+        {
+            p = skip_space(p, end);
+            if (p >= end) break;
+
+            if (keyword(p, end, "newmtl"))
+            {
+                materials.push_back(Mesh_Material());
+                material = &materials.back();
+                material->name = rest_of_line(p + 6, end);
+            }
+            else if (!material)
+            {
+                continue;
+            }
+            else if (keyword(p, end, "Ka"))
+            {
+                read3(p + 2, material->ambient);
+            }
+            else if (keyword(p, end, "Kd"))
+            {
+                read3(p + 2, material->diffuse);
+            }
+            else if (keyword(p, end, "Ks"))
+            {
+                read3(p + 2, material->specular);
+            }
+            else if (keyword(p, end, "Ns"))
+            {
+                parse_float(p + 2, end, material->shininess);
+            }
+            else if (keyword(p, end, "d"))
+            {
+                parse_float(p + 1, end, material->opacity);
+            }
+            else if (keyword(p, end, "map_Kd"))
+            {
+                material->diffuse_map = (mtl_path.parent_path() / rest_of_line(p + 6, end)).string();
+            }
+        }
+    }
+
+    GLsizei attrib_offset(const Vertex_Format& format, const char* name)
+    {
+        for (GLuint i = 0; i < format.attrib_count; ++i)
+        {
+            if (std::strcmp(format.attribs[i].name, name) == 0) return format.attribs[i].offset;
+        }
+        return -1;
+    }
+}
+
+Mesh_Data Mesh::parse_obj(const std::string& obj_file_path)
+{
+    if (!fs::exists(obj_file_path))
+    {
+        throw std::runtime_error(fmt::format("Failed to load mesh file \"{}\"; path does not exist", obj_file_path));
+    }
+
+    Mapped_File file(obj_file_path);
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // split into line-aligned chunks, one per worker
+    const std::size_t min_chunk = 1 << 20;
+    std::size_t chunk_count = std::max<std::size_t>(1, std::min(util::worker_count(), file.size() / min_chunk));
+
+    std::vector<const char*> bounds(1, begin);
+    for (std::size_t i = 1; i < chunk_count; ++i)
+    {
+        const char* split = std::max(bounds.back(), begin + file.size() * i / chunk_count);
+        bounds.push_back(split < end ? skip_line(split, end) : end);
+    }
+    bounds.push_back(end);
+
+    std::vector<Obj_Chunk> chunks(chunk_count);
+
+    try
+    {
+        util::parallel_for(chunk_count, [&](std::size_t first, std::size_t last, std::size_t)
+        {
+            for (std::size_t c = first; c < last; ++c)
+            {
+                // line numbers are only needed for errors; count them lazily per chunk
+                chunks[c].line = 1 + std::size_t(std::count(begin, bounds[c], '\n'));
+                parse_chunk(bounds[c], bounds[c + 1], chunks[c]);
+            }
+        });
+    }
+    catch (const std::runtime_error& e)
+    {
+        throw std::runtime_error(fmt::format("Failed to parse mesh file \"{}\": {}", obj_file_path, e.what()));
+    }
+
+    // merge: attribute offsets per chunk, then resolve relative references and validate
+    std::vector<std::size_t> position_base(chunk_count + 1, 0), texcoord_base(chunk_count + 1, 0), normal_base(chunk_count + 1, 0), corner_base(chunk_count + 1, 0);
+    for (std::size_t c = 0; c < chunk_count; ++c)
+    {
+        position_base[c + 1] = position_base[c] + chunks[c].positions.size() / 3;
+        texcoord_base[c + 1] = texcoord_base[c] + chunks[c].texcoords.size() / 2;
+        normal_base[c + 1] = normal_base[c] + chunks[c].normals.size() / 3;
+        corner_base[c + 1] = corner_base[c] + chunks[c].corners.size();
+    }
+
+    const std::size_t position_count = position_base[chunk_count];
+    const std::size_t texcoord_count = texcoord_base[chunk_count];
+    const std::size_t normal_count = normal_base[chunk_count];
+    const std::size_t corner_count = corner_base[chunk_count];
+
+    if (corner_count == 0)
+    {
+        throw std::runtime_error(fmt::format("Mesh file \"{}\" contains no faces", obj_file_path));
+    }
+
+    bool has_texcoords = false, has_normals = false;
+    std::vector<char> chunk_texcoords(chunk_count, 0), chunk_normals(chunk_count, 0);
+
+    util::parallel_for(chunk_count, [&](std::size_t first, std::size_t last, std::size_t)
+    {
+        for (std::size_t c = first; c < last; ++c)
+        {
+            Obj_Chunk& chunk = chunks[c];
+            const std::size_t bases[3] = { position_base[c], texcoord_base[c], normal_base[c] };
+
+            for (const Obj_Fixup& fixup : chunk.fixups)
+            {
+                GLint resolved = GLint(bases[fixup.component]) + fixup.local_index;
+                GLuint* components[3] = { &chunk.corners[fixup.corner].v, &chunk.corners[fixup.corner].vt, &chunk.corners[fixup.corner].vn };
+                *components[fixup.component] = (resolved >= 0) ? GLuint(resolved) : corner_missing - 1; // out of range below
+            }
+
+            for (const Corner& corner : chunk.corners)
+            {
+                if (corner.v >= position_count ||
+                    (corner.vt != corner_missing && corner.vt >= texcoord_count) ||
+                    (corner.vn != corner_missing && corner.vn >= normal_count))
+                {
+                    throw std::runtime_error(fmt::format("Mesh file \"{}\" references a vertex attribute that does not exist", obj_file_path));
+                }
+
+                chunk_texcoords[c] |= (corner.vt != corner_missing);
+                chunk_normals[c] |= (corner.vn != corner_missing);
+            }
+        }
+    });
+
+    for (std::size_t c = 0; c < chunk_count; ++c)
+    {
+        has_texcoords |= (chunk_texcoords[c] != 0);
+        has_normals |= (chunk_normals[c] != 0);
+    }
+
+    Mesh_Data data;
+
+    // materials, in library order; usemtl names without a definition get default materials
+    std::unordered_map<std::string, GLint> material_ids;
+    for (const Obj_Chunk& chunk : chunks)
+    {
+        for (const std::string& library : chunk.material_libraries)
+        {
+            fs::path mtl_path = fs::path(obj_file_path).parent_path() / library;
+            parse_mtl(mtl_path, data.materials);
+            data.dependencies.push_back(mtl_path.string());
+        }
+    }
+
+    for (std::size_t m = 0; m < data.materials.size(); ++m)
+    {
+        material_ids.emplace(data.materials[m].name, GLint(m));
+    }
+
+    // material runs over the global triangle sequence
+    struct Run { std::size_t first_triangle; GLint material; };
+    std::vector<Run> runs(1, Run{ 0, -1 });
+
+    for (std::size_t c = 0; c < chunk_count; ++c)
+    {
+        for (const Obj_Material_Use& use : chunks[c].material_uses)
+        {
+            auto it = material_ids.find(use.name);
+            if (it == material_ids.end())
+            {
+                Mesh_Material material;
+                material.name = use.name;
+                data.materials.push_back(material);
+                it = material_ids.emplace(use.name, GLint(data.materials.size() - 1)).first;
+            }
+
+            runs.push_back({ corner_base[c] / 3 + use.first_triangle, it->second });
+        }
+    }
+    runs.push_back({ corner_count / 3, -1 });
+
+    // group triangles by material (in order of first use) so each material becomes one submesh
+    std::vector<GLint> material_order;
+    for (std::size_t r = 0; r + 1 < runs.size(); ++r)
+    {
+        if (runs[r].first_triangle == runs[r + 1].first_triangle) continue;
+        if (std::find(material_order.begin(), material_order.end(), runs[r].material) == material_order.end())
+        {
+            material_order.push_back(runs[r].material);
+        }
+    }
+
+    auto corner_at = [&](std::size_t global) -> const Corner&
+    {
+        std::size_t c = std::size_t(std::upper_bound(corner_base.begin(), corner_base.end(), global) - corner_base.begin()) - 1;
+        return chunks[c].corners[global - corner_base[c]];
+    };
+
+    // weld identical corners into shared vertices; the table grows past the guess when positions are
+    // shared by many texcoord/normal combinations
+    Corner_Table table(std::min(corner_count, position_count * 4 + 16));
+    std::vector<Corner> unique;
+    unique.reserve(position_count);
+    data.indices.reserve(corner_count);
+
+    for (GLint material : material_order)
+    {
+        GLsizei first = GLsizei(data.indices.size());
+
+        for (std::size_t r = 0; r + 1 < runs.size(); ++r)
+        {
+            if (runs[r].material != material) continue;
+
+            for (std::size_t corner = runs[r].first_triangle * 3; corner < runs[r + 1].first_triangle * 3; ++corner)
+            {
+                const Corner& key = corner_at(corner);
+                GLuint index = table.insert(key, GLuint(unique.size()));
+                if (index == unique.size()) unique.push_back(key);
+                data.indices.push_back(index);
+            }
+        }
+
+        data.submeshes.push_back({ first, GLsizei(data.indices.size()) - first, material });
+    }
+
+    // interleave the welded vertices
+    if (has_normals && has_texcoords) data.format = Vertex_Position_Normal_Texcoord::format();
+    else if (has_normals) data.format = Vertex_Position_Normal::format();
+    else if (has_texcoords) data.format = Vertex_Position_Texcoord::format();
+    else data.format = Vertex_Position::format();
+
+    data.vertex_count = GLsizei(unique.size());
+    data.vertices.resize(unique.size() * data.format.stride);
+
+    const GLsizei stride = data.format.stride;
+    const GLsizei normal_offset = attrib_offset(data.format, "normal");
+    const GLsizei texcoord_offset = attrib_offset(data.format, "texcoord");
+
+    auto attribute = [&](const std::vector<std::size_t>& base, std::size_t global, std::vector<GLfloat> Obj_Chunk::* array, std::size_t size) -> const GLfloat*
+    {
+        std::size_t c = std::size_t(std::upper_bound(base.begin(), base.end(), global) - base.begin()) - 1;
+        return &((chunks[c].*array)[(global - base[c]) * size]);
+    };
+
+    util::parallel_for(unique.size(), [&](std::size_t first, std::size_t last, std::size_t)
+    {
+        const GLfloat zero[3] = { 0.0f, 0.0f, 0.0f };
+
+        for (std::size_t v = first; v < last; ++v)
+        {
+            GLubyte* out = &data.vertices[v * stride];
+            const Corner& corner = unique[v];
+
+            std::memcpy(out, attribute(position_base, corner.v, &Obj_Chunk::positions, 3), 3 * sizeof(GLfloat));
+
+            if (normal_offset >= 0)
+            {
+                const GLfloat* normal = (corner.vn != corner_missing) ? attribute(normal_base, corner.vn, &Obj_Chunk::normals, 3) : zero;
+                std::memcpy(out + normal_offset, normal, 3 * sizeof(GLfloat));
+            }
+
+            if (texcoord_offset >= 0)
+            {
+                const GLfloat* texcoord = (corner.vt != corner_missing) ? attribute(texcoord_base, corner.vt, &Obj_Chunk::texcoords, 2) : zero;
+                std::memcpy(out + texcoord_offset, texcoord, 2 * sizeof(GLfloat));
+            }
+        }
+    }, 4096);
+
+    data.topology = GL_TRIANGLES;
+    return data;
+}
+
+std::shared_ptr<Mesh> Mesh::load_obj(const std::string& obj_file_path, GLbitfield optimize, Mesh_Storage storage)
+{
+    return load_cached(obj_file_path, [&]() { return parse_obj(obj_file_path); }, optimize, storage);
+}
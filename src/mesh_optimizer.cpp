@@ -0,0 +1,1043 @@
+#include "mesh_optimizer.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+
+#include "vertex.hpp"
+
+namespace
+{
+    // triangles adjacent to each vertex, stored as one flat list with per-vertex offsets
+    struct Adjacency
+    {
+        std::vector<GLuint> offsets;
+        std::vector<GLuint> counts;
+        std::vector<GLuint> triangles;
+
+        Adjacency(const std::vector<GLuint>& indices, GLsizei vertex_count)
+        : offsets(vertex_count), counts(vertex_count, 0), triangles(indices.size())
+        {
+            for (GLuint index : indices)
+            {
+                counts[index]++;
+            }
+
+            GLuint offset = 0;
+            for (GLsizei v = 0; v < vertex_count; ++v)
+            {
+                offsets[v] = offset;
+                offset += counts[v];
+            }
+
+            std::vector<GLuint> fill(offsets);
+            for (std::size_t i = 0; i < indices.size(); ++i)
+            {
+                triangles[fill[indices[i]]++] = GLuint(i / 3);
+            }
+        }
+    };
+
+    // fifo cache simulation with timestamps; returns the number of misses for the triangle
+    GLuint update_cache(const GLuint* triangle, GLuint cache_size, std::vector<GLuint>& timestamps, GLuint& time)
+    {
+        GLuint misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (time - timestamps[triangle[k]] > cache_size)
+            {
+                timestamps[triangle[k]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    // symmetric plane distance quadric (Garland and Heckbert 1997), normalized by its total weight so the
+    // error is a weighted mean squared distance
+    struct Quadric
+    {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+        double b0 = 0.0, b1 = 0.0, b2 = 0.0;
+        double c = 0.0;
+        double weight = 0.0;
+
+        // plane n.p + d = 0 with unit normal n
+        void add_plane(const double* n, double d, double w)
+        {
+            a00 += w * n[0] * n[0]; a01 += w * n[0] * n[1]; a02 += w * n[0] * n[2];
+            a11 += w * n[1] * n[1]; a12 += w * n[1] * n[2]; a22 += w * n[2] * n[2];
+            b0 += w * n[0] * d; b1 += w * n[1] * d; b2 += w * n[2] * d;
+            c += w * d * d;
+            weight += w;
+        }
+
+        void add(const Quadric& q)
+        {
+            a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+            b0 += q.b0; b1 += q.b1; b2 += q.b2;
+            c += q.c;
+            weight += q.weight;
+        }
+
+        double error(const GLfloat* p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                     + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+            return weight > 0.0 ? std::max(e, 0.0) / weight : 0.0;
+        }
+    };
+
+    enum Simplify_Vertex
+    {
+        SIMPLIFY_VERTEX_MANIFOLD,   // free to collapse onto any neighbour
+        SIMPLIFY_VERTEX_BORDER,     // only collapses along the open border
+        SIMPLIFY_VERTEX_LOCKED      // never moves: attribute seams, non-manifold edges and locked borders
+    };
+
+    void cross(const GLfloat* a, const GLfloat* b, const GLfloat* c, double* n)
+    {
+        double u[3] = { double(b[0]) - a[0], double(b[1]) - a[1], double(b[2]) - a[2] };
+        double v[3] = { double(c[0]) - a[0], double(c[1]) - a[1], double(c[2]) - a[2] };
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+    }
+
+    std::uint64_t edge_key(GLuint a, GLuint b)
+    {
+        return (std::uint64_t(a) << 32) | b;
+    }
+
+    void validate(const std::vector<GLuint>& indices, GLsizei vertex_count)
+    {
+        if (indices.size() % 3 != 0)
+        {
+            throw std::runtime_error("Mesh optimization requires an indexed triangle list");
+        }
+
+        for (GLuint index : indices)
+        {
+            if (index >= GLuint(vertex_count))
+            {
+                throw std::runtime_error("Mesh index out of range of the vertex buffer");
+            }
+        }
+    }
+}
+
+namespace mesh_optimizer
+{
+    Vertex_Cache_Statistics analyze_vertex_cache(const std::vector<GLuint>& indices, GLsizei vertex_count, GLuint cache_size)
+    {
+        Vertex_Cache_Statistics stats;
+        stats.triangle_count = GLuint(indices.size() / 3);
+
+        if (indices.empty()) return stats;
+
+        std::vector<GLuint> timestamps(vertex_count, 0);
+        std::vector<bool> referenced(vertex_count, false);
+        GLuint time = cache_size + 1;
+
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            stats.vertices_transformed += update_cache(&indices[i], cache_size, timestamps, time);
+        }
+
+        GLuint unique = 0;
+        for (GLuint index : indices)
+        {
+            if (!referenced[index])
+            {
+                referenced[index] = true;
+                unique++;
+            }
+        }
+
+        stats.acmr = float(stats.vertices_transformed) / float(std::max(stats.triangle_count, 1u));
+        stats.atvr = float(stats.vertices_transformed) / float(std::max(unique, 1u));
+        return stats;
+    }
+
+    void optimize_vertex_cache(std::vector<GLuint>& indices, GLsizei vertex_count, GLuint cache_size)
+    {
+        validate(indices, vertex_count);
+        if (indices.empty()) return;
+
+        Adjacency adjacency(indices, vertex_count);
+
+        std::vector<GLuint> live(adjacency.counts);
+        std::vector<GLuint> timestamps(vertex_count, 0);
+        std::vector<bool> emitted(indices.size() / 3, false);
+
+        std::vector<GLuint> dead_end;
+        dead_end.reserve(indices.size());
+
+        std::vector<GLuint> candidates;
+        std::vector<GLuint> result;
+        result.reserve(indices.size());
+
+        GLuint time = cache_size + 1;
+        GLsizei cursor = 1;
+        GLint fanning = 0;
+
+        while (fanning >= 0)
+        {
+            candidates.clear();
+
+            // emit all remaining triangles around the fanning vertex
+            const GLuint* adjacent = &adjacency.triangles[adjacency.offsets[fanning]];
+            for (GLuint a = 0; a < adjacency.counts[fanning]; ++a)
+            {
+                GLuint triangle = adjacent[a];
+                if (emitted[triangle]) continue;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    GLuint v = indices[triangle * 3 + k];
+                    result.push_back(v);
+                    dead_end.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+
+                    if (time - timestamps[v] > cache_size)
+                    {
+                        timestamps[v] = time++;
+                    }
+                }
+
+                emitted[triangle] = true;
+            }
+
+            // next fanning vertex: the candidate that will still be in the cache after emitting its triangles
+            GLint next = -1;
+            GLint best_priority = -1;
+
+            for (GLuint v : candidates)
+            {
+                if (live[v] == 0) continue;
+
+                GLint priority = 0;
+                if (time - timestamps[v] + 2 * live[v] <= cache_size)
+                {
+                    priority = GLint(time - timestamps[v]);
+                }
+
+                if (priority > best_priority)
+                {
+                    best_priority = priority;
+                    next = GLint(v);
+                }
+            }
+
+            // dead end; backtrack through recently used vertices, then scan for any vertex with triangles left
+            while (next < 0 && !dead_end.empty())
+            {
+                GLuint v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0) next = GLint(v);
+            }
+
+            while (next < 0 && cursor < vertex_count)
+            {
+                if (live[cursor] > 0) next = cursor;
+                cursor++;
+            }
+
+            fanning = next;
+        }
+
+        indices.swap(result);
+    }
+
+    void optimize_overdraw(std::vector<GLuint>& indices, const GLfloat* positions, GLsizei position_stride, GLsizei vertex_count, float threshold, GLuint cache_size)
+    {
+        validate(indices, vertex_count);
+
+        const std::size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) return;
+
+        auto position = [&](GLuint v) -> const GLfloat*
+        {
+            return reinterpret_cast<const GLfloat*>(reinterpret_cast<const GLubyte*>(positions) + std::size_t(v) * position_stride);
+        };
+
+        std::vector<GLuint> timestamps(vertex_count, 0);
+        GLuint time = cache_size + 1;
+
+        // hard boundaries: a triangle with three cache misses usually starts a disjoint patch
+        std::vector<GLuint> hard;
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            GLuint misses = update_cache(&indices[t * 3], cache_size, timestamps, time);
+            if (t == 0 || misses == 3) hard.push_back(GLuint(t));
+        }
+        hard.push_back(GLuint(triangle_count));
+
+        // soft boundaries: split a patch as soon as its running ACMR drops under the threshold, flushing
+        // the simulated cache at every split so each cluster pays for its own vertices
+        std::vector<GLuint> clusters;
+        for (std::size_t h = 0; h + 1 < hard.size(); ++h)
+        {
+            GLuint begin = hard[h], end = hard[h + 1];
+
+            time += cache_size + 1;
+            GLuint cluster_misses = 0;
+            for (GLuint t = begin; t < end; ++t)
+            {
+                cluster_misses += update_cache(&indices[t * 3], cache_size, timestamps, time);
+            }
+
+            float cluster_threshold = threshold * float(cluster_misses) / float(end - begin);
+
+            clusters.push_back(begin);
+            time += cache_size + 1;
+
+            GLuint running_misses = 0, running_triangles = 0;
+            for (GLuint t = begin; t < end; ++t)
+            {
+                running_misses += update_cache(&indices[t * 3], cache_size, timestamps, time);
+                running_triangles++;
+
+                if (float(running_misses) / float(running_triangles) <= cluster_threshold && t + 1 < end)
+                {
+                    clusters.push_back(t + 1);
+                    time += cache_size + 1;
+                    running_misses = running_triangles = 0;
+                }
+            }
+
+            // the tail did not reach the target ACMR on its own; merge it into the previous cluster
+            if (running_triangles > 0 && clusters.back() != begin && float(running_misses) / float(running_triangles) > cluster_threshold)
+            {
+                clusters.pop_back();
+            }
+        }
+        clusters.push_back(GLuint(triangle_count));
+
+        // mesh centroid
+        double mesh_center[3] = { 0.0, 0.0, 0.0 };
+        for (GLuint index : indices)
+        {
+            const GLfloat* p = position(index);
+            for (int k = 0; k < 3; ++k) mesh_center[k] += p[k];
+        }
+        for (int k = 0; k < 3; ++k) mesh_center[k] /= double(indices.size());
+
+        // sort key: how far the cluster faces away from the mesh center
+        std::size_t cluster_count = clusters.size() - 1;
+        std::vector<float> keys(cluster_count);
+
+        for (std::size_t c = 0; c < cluster_count; ++c)
+        {
+            double center[3] = { 0.0, 0.0, 0.0 };
+            double normal[3] = { 0.0, 0.0, 0.0 };
+            double area = 0.0;
+
+            for (GLuint t = clusters[c]; t < clusters[c + 1]; ++t)
+            {
+                const GLfloat* p0 = position(indices[t * 3 + 0]);
+                const GLfloat* p1 = position(indices[t * 3 + 1]);
+                const GLfloat* p2 = position(indices[t * 3 + 2]);
+
+                double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                double twice_area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    center[k] += (p0[k] + p1[k] + p2[k]) / 3.0 * twice_area;
+                    normal[k] += n[k];
+                }
+                area += twice_area;
+            }
+
+            double inv_area = (area > 0.0) ? 1.0 / area : 0.0;
+            double normal_length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            double inv_normal = (normal_length > 0.0) ? 1.0 / normal_length : 0.0;
+
+            double key = 0.0;
+            for (int k = 0; k < 3; ++k)
+            {
+                key += (center[k] * inv_area - mesh_center[k]) * normal[k] * inv_normal;
+            }
+            keys[c] = float(key);
+        }
+
+        std::vector<GLuint> order(cluster_count);
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](GLuint a, GLuint b) { return keys[a] > keys[b]; });
+
+        std::vector<GLuint> result;
+        result.reserve(indices.size());
+
+        for (GLuint c : order)
+        {
+            result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+        }
+
+        indices.swap(result);
+    }
+
+    GLsizei optimize_vertex_fetch(void* vertices, GLsizei vertex_count, GLsizei stride, std::vector<GLuint>& indices)
+    {
+        validate(indices, vertex_count);
+
+        const GLuint unused = ~0u;
+        std::vector<GLuint> remap(vertex_count, unused);
+        GLuint next = 0;
+
+        for (GLuint& index : indices)
+        {
+            if (remap[index] == unused) remap[index] = next++;
+            index = remap[index];
+        }
+
+        GLubyte* data = static_cast<GLubyte*>(vertices);
+        std::vector<GLubyte> reordered(std::size_t(next) * stride);
+
+        for (GLsizei v = 0; v < vertex_count; ++v)
+        {
+            if (remap[v] != unused)
+            {
+                std::memcpy(&reordered[std::size_t(remap[v]) * stride], data + std::size_t(v) * stride, stride);
+            }
+        }
+
+        std::memcpy(data, reordered.data(), reordered.size());
+        return GLsizei(next);
+    }
+
+    std::vector<GLuint> build_triangle_strips(const std::vector<GLuint>& indices, GLsizei vertex_count)
+    {
+        validate(indices, vertex_count);
+
+        const std::size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) return std::vector<GLuint>();
+
+        // directed edge -> triangles that contain it in their winding order
+        auto edge_key = [](GLuint a, GLuint b) { return (std::uint64_t(a) << 32) | b; };
+        std::unordered_multimap<std::uint64_t, GLuint> edges;
+        edges.reserve(indices.size());
+
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            const GLuint* tri = &indices[t * 3];
+            for (int k = 0; k < 3; ++k)
+            {
+                edges.emplace(edge_key(tri[k], tri[(k + 1) % 3]), GLuint(t));
+            }
+        }
+
+        std::vector<bool> used(triangle_count, false);
+
+        // finds an unused triangle with directed edge a -> b and returns its third vertex
+        auto take_neighbor = [&](GLuint a, GLuint b, GLuint& third) -> bool
+        {
+            auto range = edges.equal_range(edge_key(a, b));
+            for (auto it = range.first; it != range.second; ++it)
+            {
+                GLuint t = it->second;
+                if (used[t]) continue;
+
+                const GLuint* tri = &indices[t * 3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    if (tri[k] == a && tri[(k + 1) % 3] == b)
+                    {
+                        third = tri[(k + 2) % 3];
+                        used[t] = true;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        };
+
+        std::vector<GLuint> strips;
+        strips.reserve(indices.size());
+
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            if (used[t]) continue;
+            used[t] = true;
+
+            // start with the rotation whose second triangle (odd, so edge c -> b) continues the strip
+            const GLuint* tri = &indices[t * 3];
+            GLuint start[3] = { tri[0], tri[1], tri[2] };
+            for (int r = 0; r < 3; ++r)
+            {
+                GLuint a = tri[r], b = tri[(r + 1) % 3], c = tri[(r + 2) % 3];
+                if (edges.count(edge_key(c, b)) > 0)
+                {
+                    start[0] = a;
+                    start[1] = b;
+                    start[2] = c;
+                    break;
+                }
+            }
+
+            if (!strips.empty()) strips.push_back(restart_index);
+
+            std::size_t strip_begin = strips.size();
+            strips.insert(strips.end(), start, start + 3);
+
+            // triangle k of a strip is (s[k], s[k+1], s[k+2]) for even k and (s[k+1], s[k], s[k+2]) for odd k
+            for (std::size_t k = 1; ; ++k)
+            {
+                GLuint s0 = strips[strip_begin + k];
+                GLuint s1 = strips[strip_begin + k + 1];
+                GLuint third;
+
+                bool found = (k % 2 == 0) ? take_neighbor(s0, s1, third) : take_neighbor(s1, s0, third);
+                if (!found) break;
+
+                strips.push_back(third);
+            }
+        }
+
+        return strips;
+    }
+
+    GLenum index_type(GLsizei vertex_count)
+    {
+        if (vertex_count <= 0xff) return GL_UNSIGNED_BYTE;
+        if (vertex_count <= 0xffff) return GL_UNSIGNED_SHORT;
+        return GL_UNSIGNED_INT;
+    }
+
+    GLsizei index_size(GLenum index_type)
+    {
+        switch (index_type)
+        {
+            case GL_UNSIGNED_BYTE: return sizeof(GLubyte);
+            case GL_UNSIGNED_SHORT: return sizeof(GLushort);
+            default: return sizeof(GLuint);
+        }
+    }
+
+    std::vector<GLubyte> pack_indices(const std::vector<GLuint>& indices, GLenum index_type)
+    {
+        std::vector<GLubyte> packed(indices.size() * index_size(index_type));
+
+        switch (index_type)
+        {
+            case GL_UNSIGNED_BYTE:
+                for (std::size_t i = 0; i < indices.size(); ++i)
+                {
+                    packed[i] = GLubyte(indices[i]); // restart_index truncates to 0xff
+                }
+            break;
+
+            case GL_UNSIGNED_SHORT:
+                for (std::size_t i = 0; i < indices.size(); ++i)
+                {
+                    GLushort index = GLushort(indices[i]);
+                    std::memcpy(&packed[i * sizeof(GLushort)], &index, sizeof(index));
+                }
+            break;
+
+            default:
+                std::memcpy(packed.data(), indices.data(), packed.size());
+            break;
+        }
+
+        return packed;
+    }
+
+    std::vector<GLfloat> read_positions(const Vertex_Format& format, const void* vertices, GLsizei vertex_count)
+    {
+        return read_attribute(format, vertices, vertex_count, "position", 3);
+    }
+
+    std::vector<GLfloat> read_attribute(const Vertex_Format& format, const void* vertices, GLsizei vertex_count, const char* name, GLint components)
+    {
+        std::vector<GLfloat> values;
+
+        for (GLuint i = 0; i < format.attrib_count; ++i)
+        {
+            const Vertex_Attrib& attrib = format.attribs[i];
+            if (std::strcmp(attrib.name, name) != 0) continue;
+            if (attrib.type != GL_FLOAT && attrib.type != GL_HALF_FLOAT) break;
+
+            values.assign(std::size_t(vertex_count) * components, 0.0f);
+            const GLubyte* data = static_cast<const GLubyte*>(vertices) + attrib.offset;
+            GLint size = std::min(attrib.size, components);
+
+            for (GLsizei v = 0; v < vertex_count; ++v, data += format.stride)
+            {
+                for (GLint k = 0; k < size; ++k)
+                {
+                    if (attrib.type == GL_FLOAT)
+                    {
+                        std::memcpy(&values[v * components + k], data + k * sizeof(GLfloat), sizeof(GLfloat));
+                    }
+                    else
+                    {
+                        GLhalf h;
+                        std::memcpy(&h, data + k * sizeof(GLhalf), sizeof(GLhalf));
+                        values[v * components + k] = vertex_encode::half_to_float(h);
+                    }
+                }
+            }
+            break;
+        }
+
+        return values;
+    }
+
+    std::vector<GLuint> simplify(const std::vector<GLuint>& indices, const GLfloat* positions, GLsizei vertex_count,
+                                 std::size_t target_index_count, float target_error, bool lock_border,
+                                 const GLfloat* attributes, GLsizei attribute_count, float attribute_weight, float* result_error)
+    {
+        validate(indices, vertex_count);
+
+        std::vector<GLuint> result(indices);
+        if (result_error) *result_error = 0.0f;
+        if (target_index_count >= indices.size() || vertex_count < 1) return result;
+
+        // positions in a unit box, so errors are relative to the mesh extent
+        std::vector<GLfloat> unit(positions, positions + std::size_t(vertex_count) * 3);
+        {
+            GLfloat low[3] = { unit[0], unit[1], unit[2] }, high[3] = { unit[0], unit[1], unit[2] };
+            for (std::size_t i = 0; i < unit.size(); ++i)
+            {
+                low[i % 3] = std::min(low[i % 3], unit[i]);
+                high[i % 3] = std::max(high[i % 3], unit[i]);
+            }
+
+            GLfloat extent = std::max(high[0] - low[0], std::max(high[1] - low[1], high[2] - low[2]));
+            GLfloat scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+            for (std::size_t i = 0; i < unit.size(); ++i) unit[i] = (unit[i] - low[i % 3]) * scale;
+        }
+
+        // vertices that only differ in their attributes share one position id
+        std::vector<GLuint> position_id(vertex_count);
+        std::vector<GLuint> wedges(vertex_count, 0);
+        {
+            std::vector<GLuint> order(vertex_count);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b)
+            {
+                return std::lexicographical_compare(&unit[a * 3], &unit[a * 3] + 3, &unit[b * 3], &unit[b * 3] + 3);
+            });
+
+            for (std::size_t i = 0; i < order.size(); ++i)
+            {
+                bool same = i > 0 && std::equal(&unit[order[i] * 3], &unit[order[i] * 3] + 3, &unit[order[i - 1] * 3]);
+                position_id[order[i]] = same ? position_id[order[i - 1]] : order[i];
+                wedges[position_id[order[i]]]++;
+            }
+        }
+
+        // classify positions by their edges: an edge without its opposite is on the border, an edge used
+        // twice in the same direction is non-manifold
+        std::vector<std::uint64_t> edges(indices.size());
+        for (std::size_t i = 0; i < indices.size(); ++i)
+        {
+            edges[i] = edge_key(position_id[indices[i]], position_id[indices[i - i % 3 + (i + 1) % 3]]);
+        }
+        std::sort(edges.begin(), edges.end());
+
+        auto edge_count = [&](GLuint a, GLuint b)
+        {
+            auto range = std::equal_range(edges.begin(), edges.end(), edge_key(a, b));
+            return std::size_t(range.second - range.first);
+        };
+
+        std::vector<GLubyte> kind(vertex_count, SIMPLIFY_VERTEX_MANIFOLD);
+        {
+            for (std::size_t i = 0; i < edges.size(); ++i)
+            {
+                if (i > 0 && edges[i] == edges[i - 1]) continue;
+
+                GLuint a = GLuint(edges[i] >> 32), b = GLuint(edges[i] & 0xffffffffu);
+                std::size_t count = edge_count(a, b), opposite = edge_count(b, a);
+
+                if (count > 1 || opposite > 1)
+                {
+                    kind[a] = kind[b] = SIMPLIFY_VERTEX_LOCKED;
+                }
+                else if (opposite == 0)
+                {
+                    GLubyte border = lock_border ? SIMPLIFY_VERTEX_LOCKED : SIMPLIFY_VERTEX_BORDER;
+                    kind[a] = std::max(kind[a], border);
+                    kind[b] = std::max(kind[b], border);
+                }
+            }
+
+            for (GLsizei v = 0; v < vertex_count; ++v)
+            {
+                kind[v] = (wedges[position_id[v]] > 1) ? GLubyte(SIMPLIFY_VERTEX_LOCKED) : kind[position_id[v]];
+            }
+        }
+
+        // area weighted face planes, plus planes perpendicular to open borders that keep their outline
+        std::vector<Quadric> quadrics(vertex_count);
+
+        for (std::size_t t = 0; t < indices.size(); t += 3)
+        {
+            double n[3];
+            cross(&unit[indices[t] * 3], &unit[indices[t + 1] * 3], &unit[indices[t + 2] * 3], n);
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0) continue;
+
+            n[0] /= length; n[1] /= length; n[2] /= length;
+            const GLfloat* p0 = &unit[indices[t] * 3];
+            double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+
+            for (int k = 0; k < 3; ++k)
+            {
+                quadrics[position_id[indices[t + k]]].add_plane(n, d, length * 0.5);
+
+                GLuint a = position_id[indices[t + k]], b = position_id[indices[t + (k + 1) % 3]];
+                if (edge_count(b, a) > 0) continue;
+
+                const GLfloat* pa = &unit[a * 3];
+                const GLfloat* pb = &unit[b * 3];
+                double e[3] = { double(pb[0]) - pa[0], double(pb[1]) - pa[1], double(pb[2]) - pa[2] };
+                double m[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2], e[0] * n[1] - e[1] * n[0] };
+                double m_length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+                if (m_length == 0.0) continue;
+
+                m[0] /= m_length; m[1] /= m_length; m[2] /= m_length;
+                double md = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+                double weight = (e[0] * e[0] + e[1] * e[1] + e[2] * e[2]) * 10.0;
+                quadrics[a].add_plane(m, md, weight);
+                quadrics[b].add_plane(m, md, weight);
+            }
+        }
+
+        struct Collapse
+        {
+            GLuint from, to;
+            double cost;        // geometric plus weighted attribute error
+            double error;       // geometric error alone
+        };
+
+        const double error_limit = double(target_error) * target_error;
+        double max_error = 0.0;
+
+        std::vector<GLuint> remap(vertex_count);
+        std::vector<char> touched(vertex_count);
+        std::vector<Collapse> collapses;
+
+        // collapses in passes: the cheapest edges first, at most one per neighbourhood and pass
+        while (result.size() > target_index_count)
+        {
+            Adjacency adjacency(result, vertex_count);
+
+            // number of triangles around from that use the edge to its neighbour at the position of to
+            auto edge_uses = [&](GLuint from, GLuint to)
+            {
+                GLuint uses = 0;
+                for (GLuint i = 0; i < adjacency.counts[from]; ++i)
+                {
+                    const GLuint* triangle = &result[adjacency.triangles[adjacency.offsets[from] + i] * 3];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        uses += (triangle[k] != from && position_id[triangle[k]] == position_id[to]);
+                    }
+                }
+                return uses;
+            };
+
+            auto allowed = [&](GLuint from, GLuint to)
+            {
+                switch (kind[from])
+                {
+                case SIMPLIFY_VERTEX_LOCKED:
+                    return false;
+
+                case SIMPLIFY_VERTEX_BORDER:
+                {
+                    // only along a border edge, onto another border (or locked) vertex
+                    return kind[to] != SIMPLIFY_VERTEX_MANIFOLD && edge_uses(from, to) == 1;
+                }
+
+                default:
+                    return true;
+                }
+            };
+
+            auto evaluate = [&](GLuint from, GLuint to)
+            {
+                Quadric q = quadrics[position_id[from]];
+                q.add(quadrics[position_id[to]]);
+
+                Collapse collapse = { from, to, 0.0, q.error(&unit[to * 3]) };
+
+                double attribute_error = 0.0;
+                for (GLsizei k = 0; k < attribute_count; ++k)
+                {
+                    double delta = double(attributes[from * attribute_count + k]) - attributes[to * attribute_count + k];
+                    attribute_error += delta * delta;
+                }
+
+                collapse.cost = collapse.error + attribute_weight * attribute_error;
+                return collapse;
+            };
+
+            collapses.clear();
+            for (std::size_t i = 0; i < result.size(); ++i)
+            {
+                GLuint a = result[i], b = result[i - i % 3 + (i + 1) % 3];
+
+                // interior edges show up once per direction; border edges only once
+                if (a > b && kind[a] != SIMPLIFY_VERTEX_BORDER && kind[b] != SIMPLIFY_VERTEX_BORDER) continue;
+
+                bool forward = allowed(a, b), backward = allowed(b, a);
+                if (!forward && !backward) continue;
+
+                Collapse ab = forward ? evaluate(a, b) : Collapse();
+                Collapse ba = backward ? evaluate(b, a) : Collapse();
+                const Collapse& cheaper = (!backward || (forward && ab.cost <= ba.cost)) ? ab : ba;
+                if (cheaper.cost <= error_limit) collapses.push_back(cheaper);
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            // moving from onto to must not turn any remaining triangle around
+            auto flips = [&](GLuint from, GLuint to)
+            {
+                for (GLuint i = 0; i < adjacency.counts[from]; ++i)
+                {
+                    const GLuint* triangle = &result[adjacency.triangles[adjacency.offsets[from] + i] * 3];
+                    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) continue;
+
+                    const GLfloat* p[3];
+                    for (int k = 0; k < 3; ++k) p[k] = &unit[triangle[k] * 3];
+
+                    double before[3], after[3];
+                    cross(p[0], p[1], p[2], before);
+                    for (int k = 0; k < 3; ++k) if (triangle[k] == from) p[k] = &unit[to * 3];
+                    cross(p[0], p[1], p[2], after);
+
+                    double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+                    double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                               (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+                    if (lengths == 0.0 || dot < 0.1 * lengths) return true;
+                }
+                return false;
+            };
+
+            std::iota(remap.begin(), remap.end(), 0);
+            std::fill(touched.begin(), touched.end(), 0);
+
+            const std::size_t excess = (result.size() - target_index_count) / 3;
+            std::size_t removed = 0;
+            std::size_t applied = 0;
+
+            for (const Collapse& collapse : collapses)
+            {
+                if (removed >= excess) break;
+                if (touched[collapse.from] || touched[collapse.to] || flips(collapse.from, collapse.to)) continue;
+
+                remap[collapse.from] = collapse.to;
+                quadrics[position_id[collapse.to]].add(quadrics[position_id[collapse.from]]);
+                max_error = std::max(max_error, collapse.error);
+
+                // the neighbourhood of the moved vertex changed; its flip tests are stale for this pass
+                for (GLuint i = 0; i < adjacency.counts[collapse.from]; ++i)
+                {
+                    const GLuint* triangle = &result[adjacency.triangles[adjacency.offsets[collapse.from] + i] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+                }
+
+                removed += (kind[collapse.from] == SIMPLIFY_VERTEX_BORDER) ? 1 : 2;
+                applied++;
+            }
+
+            if (applied == 0) break;
+
+            std::size_t write = 0;
+            for (std::size_t t = 0; t < result.size(); t += 3)
+            {
+                GLuint a = remap[result[t]], b = remap[result[t + 1]], c = remap[result[t + 2]];
+                if (a == b || b == c || c == a) continue;
+
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+            result.resize(write);
+        }
+
+        if (result_error) *result_error = float(std::sqrt(max_error));
+        return result;
+    }
+
+    std::vector<Meshlet> build_meshlets(std::vector<GLuint>& indices, const GLfloat* positions, GLsizei vertex_count,
+                                        GLuint max_vertices, GLuint max_triangles)
+    {
+        validate(indices, vertex_count);
+
+        if (max_vertices < 3 || max_triangles < 1)
+        {
+            throw std::runtime_error("Meshlets need room for at least one triangle");
+        }
+
+        const std::size_t triangle_count = indices.size() / 3;
+        Adjacency adjacency(indices, vertex_count);
+
+        std::vector<GLfloat> normals(triangle_count * 3, 0.0f);
+        for (std::size_t t = 0; t < triangle_count; ++t)
+        {
+            double n[3];
+            cross(&positions[indices[t * 3] * 3], &positions[indices[t * 3 + 1] * 3], &positions[indices[t * 3 + 2] * 3], n);
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0) continue;
+
+            for (int k = 0; k < 3; ++k) normals[t * 3 + k] = GLfloat(n[k] / length);
+        }
+
+        std::vector<GLuint> ordered;
+        ordered.reserve(indices.size());
+        std::vector<Meshlet> meshlets;
+
+        std::vector<char> emitted(triangle_count, 0);
+        std::vector<GLuint> vertex_stamp(vertex_count, 0);     // meshlet number + 1 that last referenced the vertex
+        std::vector<GLuint> triangle_stamp(triangle_count, 0); // meshlet number + 1 that last listed the triangle as candidate
+        std::size_t next_seed = 0;
+
+        std::vector<GLuint> meshlet_vertices;
+        std::vector<GLuint> meshlet_triangles;
+        std::vector<GLuint> candidates;
+
+        while (ordered.size() < indices.size())
+        {
+            const GLuint stamp = GLuint(meshlets.size() + 1);
+            Meshlet meshlet = { GLsizei(ordered.size()), 0, 0, { 0.0f, 0.0f, 0.0f }, 0.0f, { 0.0f, 0.0f, 0.0f }, 1.0f };
+            GLfloat normal[3] = { 0.0f, 0.0f, 0.0f };
+
+            meshlet_vertices.clear();
+            meshlet_triangles.clear();
+            candidates.clear();
+
+            auto new_vertices = [&](std::size_t t)
+            {
+                GLuint count = 0;
+                for (int k = 0; k < 3; ++k) count += (vertex_stamp[indices[t * 3 + k]] != stamp);
+                return count;
+            };
+
+            auto add = [&](std::size_t t)
+            {
+                emitted[t] = 1;
+                meshlet_triangles.push_back(GLuint(t));
+                ordered.insert(ordered.end(), &indices[t * 3], &indices[t * 3] + 3);
+                meshlet.count += 3;
+
+                for (int k = 0; k < 3; ++k)
+                {
+                    normal[k] += normals[t * 3 + k];
+
+                    GLuint v = indices[t * 3 + k];
+                    if (vertex_stamp[v] == stamp) continue;
+
+                    vertex_stamp[v] = stamp;
+                    meshlet_vertices.push_back(v);
+
+                    // triangles sharing a vertex with the meshlet are where it grows next
+                    for (GLuint i = 0; i < adjacency.counts[v]; ++i)
+                    {
+                        GLuint neighbour = adjacency.triangles[adjacency.offsets[v] + i];
+                        if (emitted[neighbour] || triangle_stamp[neighbour] == stamp) continue;
+
+                        triangle_stamp[neighbour] = stamp;
+                        candidates.push_back(neighbour);
+                    }
+                }
+            };
+
+            while (GLuint(meshlet.count / 3) < max_triangles)
+            {
+                // fewest new vertices first, then the best agreement with the meshlet's normal so the
+                // normal cone stays narrow
+                std::size_t best = triangle_count;
+                GLuint best_new = 4;
+                GLfloat best_dot = 0.0f;
+
+                for (std::size_t i = 0; i < candidates.size(); )
+                {
+                    GLuint t = candidates[i];
+                    if (emitted[t])
+                    {
+                        candidates[i] = candidates.back();
+                        candidates.pop_back();
+                        continue;
+                    }
+
+                    GLuint added = new_vertices(t);
+                    GLfloat dot = normal[0] * normals[t * 3] + normal[1] * normals[t * 3 + 1] + normal[2] * normals[t * 3 + 2];
+
+                    if (added < best_new || (added == best_new && dot > best_dot))
+                    {
+                        best = t;
+                        best_new = added;
+                        best_dot = dot;
+                    }
+                    ++i;
+                }
+
+                // disconnected parts continue in the original order
+                if (best == triangle_count)
+                {
+                    while (next_seed < triangle_count && emitted[next_seed]) ++next_seed;
+                    if (next_seed == triangle_count) break;
+
+                    best = next_seed;
+                    best_new = new_vertices(best);
+                }
+
+                if (meshlet_vertices.size() + best_new > max_vertices) break;
+                add(best);
+            }
+
+            meshlet.vertex_count = GLuint(meshlet_vertices.size());
+
+            // bounding sphere around the centroid of the vertices
+            for (GLuint v : meshlet_vertices)
+            {
+                for (int k = 0; k < 3; ++k) meshlet.center[k] += positions[v * 3 + k] / GLfloat(meshlet_vertices.size());
+            }
+
+            for (GLuint v : meshlet_vertices)
+            {
+                GLfloat d[3] = { positions[v * 3] - meshlet.center[0], positions[v * 3 + 1] - meshlet.center[1], positions[v * 3 + 2] - meshlet.center[2] };
+                meshlet.radius = std::max(meshlet.radius, std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+            }
+
+            // normal cone: the averaged normal as axis, opened up to the triangle normal furthest from it
+            GLfloat length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            if (length > 0.0f)
+            {
+                for (int k = 0; k < 3; ++k) meshlet.cone_axis[k] = normal[k] / length;
+
+                // degenerate triangles have no normal and never rasterize
+                GLfloat min_dot = 1.0f;
+                for (GLuint t : meshlet_triangles)
+                {
+                    const GLfloat* n = &normals[t * 3];
+                    if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) continue;
+
+                    min_dot = std::min(min_dot, meshlet.cone_axis[0] * n[0] + meshlet.cone_axis[1] * n[1] + meshlet.cone_axis[2] * n[2]);
+                }
+
+                // wider than a hemisphere: some triangle faces every viewer
+                meshlet.cone_cutoff = (min_dot <= 0.0f) ? 1.0f : std::sqrt(1.0f - min_dot * min_dot);
+            }
+
+            meshlets.push_back(meshlet);
+        }
+
+        indices.swap(ordered);
+        return meshlets;
+    }
+}
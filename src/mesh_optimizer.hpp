@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+
+struct Vertex_Format;
+
+// post-transform cache behaviour of an indexed triangle list, simulated with a fifo cache
+struct Vertex_Cache_Statistics
+{
+    GLuint vertices_transformed = 0;
+    GLuint triangle_count = 0;
+    float acmr = 0.0f;  // average cache miss ratio; transformed vertices per triangle (0.5 - 3.0)
+    float atvr = 0.0f;  // average transformed vertex ratio; transformed vertices per referenced vertex (1.0 is optimal)
+};
+
+// Cluster of at most a few dozen vertices and about twice as many triangles, contiguous in the index list.
+// A meshlet is backfacing from every point of the view when
+//     dot(center - eye, cone_axis) >= cone_cutoff * length(center - eye) + radius
+struct Meshlet
+{
+    GLsizei first;              // index range of its triangles
+    GLsizei count;
+    GLuint vertex_count;        // distinct vertices referenced
+    GLfloat center[3];          // bounding sphere
+    GLfloat radius;
+    GLfloat cone_axis[3];       // average triangle normal
+    GLfloat cone_cutoff;        // sine of the normal cone's half angle; 1 when the cone cannot cull
+};
+
+// Index and vertex reordering for indexed triangle lists. All functions take the mesh's 32-bit index
+// list and operate in place; they do not change the rendered geometry, only its order.
+namespace mesh_optimizer
+{
+    const GLuint default_cache_size = 16;
+
+    Vertex_Cache_Statistics analyze_vertex_cache(const std::vector<GLuint>& indices, GLsizei vertex_count, GLuint cache_size = default_cache_size);
+
+    // Tipsify (Sander et al. 2007): reorders triangles to fan around recently used vertices
+    void optimize_vertex_cache(std::vector<GLuint>& indices, GLsizei vertex_count, GLuint cache_size = default_cache_size);
+
+    // Splits an already cache-optimized index list into clusters and sorts them so that outward facing
+    // clusters come first, reducing overdraw from any viewpoint. Clusters are only split where the ACMR
+    // stays within threshold times the original, so the cache efficiency is mostly retained.
+    // positions points at xyz floats, position_stride bytes apart.
+    void optimize_overdraw(std::vector<GLuint>& indices, const GLfloat* positions, GLsizei position_stride, GLsizei vertex_count,
+                           float threshold = 1.05f, GLuint cache_size = default_cache_size);
+
+    // Renumbers vertices in order of first use and moves their data accordingly, so that vertex fetch
+    // walks the vertex buffer linearly. Unreferenced vertices are dropped; returns the new vertex count.
+    GLsizei optimize_vertex_fetch(void* vertices, GLsizei vertex_count, GLsizei stride, std::vector<GLuint>& indices);
+
+    // Converts a triangle list into strips joined by primitive restart indices (restart_index). The
+    // winding of every triangle is preserved. Callers should keep the list when the strips are not smaller.
+    const GLuint restart_index = 0xffffffffu;
+    std::vector<GLuint> build_triangle_strips(const std::vector<GLuint>& indices, GLsizei vertex_count);
+
+    // Smallest index type able to address vertex_count vertices. The all-ones value of each type is
+    // reserved for primitive restart, which the renderer keeps enabled (GL_PRIMITIVE_RESTART_FIXED_INDEX).
+    GLenum index_type(GLsizei vertex_count);
+    GLsizei index_size(GLenum index_type);
+
+    // narrows 32-bit indices to index_type; restart_index maps to the all-ones value of that type
+    std::vector<GLubyte> pack_indices(const std::vector<GLuint>& indices, GLenum index_type);
+
+    // Quadric error metric simplification (Garland and Heckbert 1997). Edges are collapsed onto one of
+    // their endpoints, cheapest first, until the list has at most target_index_count indices or the next
+    // collapse would exceed target_error. No vertex moves, so the result indexes the same vertex buffer.
+    // Attribute seams and non-manifold edges never move; open borders only collapse along themselves,
+    // or not at all with lock_border (which keeps separately simplified submeshes crack free).
+    // attributes holds attribute_count floats per vertex (e.g. normal and texcoord), whose squared
+    // difference, times attribute_weight, is added to the cost of a collapse. Errors are relative to the
+    // largest extent of the positions' bounding box; result_error receives the largest error introduced.
+    std::vector<GLuint> simplify(const std::vector<GLuint>& indices, const GLfloat* positions, GLsizei vertex_count,
+                                 std::size_t target_index_count, float target_error, bool lock_border = true,
+                                 const GLfloat* attributes = nullptr, GLsizei attribute_count = 0, float attribute_weight = 0.01f,
+                                 float* result_error = nullptr);
+
+    // Reorders the triangles into meshlets of at most max_vertices distinct vertices and max_triangles
+    // triangles and returns their ranges and culling bounds. Meshlets grow over shared vertices from the
+    // first unused triangle in the given order, preferring triangles whose normal agrees with theirs.
+    // positions holds packed xyz floats.
+    std::vector<Meshlet> build_meshlets(std::vector<GLuint>& indices, const GLfloat* positions, GLsizei vertex_count,
+                                        GLuint max_vertices = 64, GLuint max_triangles = 124);
+
+    // positions of a vertex block as tightly packed xyz floats, from its float or half-float
+    // "position" attribute; empty when the format has none
+    std::vector<GLfloat> read_positions(const Vertex_Format& format, const void* vertices, GLsizei vertex_count);
+
+    // named float or half-float attribute as components tightly packed floats per vertex (missing ones
+    // zero); empty when the format has no such attribute or stores it in another type
+    std::vector<GLfloat> read_attribute(const Vertex_Format& format, const void* vertices, GLsizei vertex_count, const char* name, GLint components);
+}
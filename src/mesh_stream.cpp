@@ -0,0 +1,538 @@
+#include "mesh_stream.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <experimental/filesystem>
+
+#include <fmt/format.h>
+
+#include "shader.hpp"
+#include "mesh_cache.hpp"
+#include "mapped_file.hpp"
+
+namespace fs = std::experimental::filesystem;
+
+namespace
+{
+    struct Stream_Header
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t format;           // index into vertex_formats()
+        std::uint32_t stride;
+        std::uint32_t chunk_count;
+        std::uint32_t cells_per_axis;
+        float bounds_min[3];
+        float bounds_max[3];
+        std::uint64_t chunk_offset;
+        std::uint64_t file_size;
+    };
+
+    struct Chunk_Record
+    {
+        float bounds_min[3];
+        float bounds_max[3];
+        std::uint32_t vertex_count;
+        std::uint32_t index_count;
+        std::uint32_t index_type;
+        std::uint32_t reserved;
+        std::uint64_t offset;           // vertices, followed by the packed indices
+        std::uint64_t vertex_bytes;
+        std::uint64_t index_bytes;
+    };
+
+    static_assert(std::is_trivially_copyable<Stream_Header>::value && sizeof(Stream_Header) == 64, "Stream header layout changed");
+    static_assert(sizeof(Chunk_Record) == 64, "Stream chunk layout changed");
+
+    // triangles are moved between the temporary files in blocks of about this size
+    const std::size_t block_size = 4 << 20;
+
+    std::uint64_t page_align(std::uint64_t offset)
+    {
+        return (offset + mesh_stream::page_size - 1) / mesh_stream::page_size * mesh_stream::page_size;
+    }
+
+    GLfloat distance(const glm::vec3& point, const Mesh_Bounds& bounds)
+    {
+        return glm::length(glm::max(glm::max(bounds.min - point, point - bounds.max), glm::vec3(0.0f)));
+    }
+
+    // reads count records of size bytes starting at record first, in blocks, calling
+    // visit(const char* record, std::uint64_t index) for each
+    template <typename Visit>
+    void for_each_record(std::ifstream& in, std::uint64_t first, std::uint64_t count, std::size_t size, Visit visit)
+    {
+        std::vector<char> block(std::max<std::size_t>(1, block_size / size) * size);
+        in.seekg(std::streamoff(first * size));
+
+        for (std::uint64_t done = 0; done < count; )
+        {
+            std::uint64_t batch = std::min<std::uint64_t>(count - done, block.size() / size);
+            if (!in.read(block.data(), std::streamsize(batch * size)))
+            {
+                throw std::runtime_error("Failed to read back spilled stream triangles");
+            }
+
+            for (std::uint64_t i = 0; i < batch; ++i)
+            {
+                visit(block.data() + i * size, done + i);
+            }
+            done += batch;
+        }
+    }
+}
+
+Mesh_Stream_Writer::Mesh_Stream_Writer(const std::string& path, const Vertex_Format& format, GLuint cells_per_axis, GLbitfield optimize)
+: path(path), format(&format), cells_per_axis(cells_per_axis), optimize(optimize & MESH_OPTIMIZE_ALL), triangle_count(0), finished(false)
+{
+    if (std::find(vertex_formats().begin(), vertex_formats().end(), &format) == vertex_formats().end())
+    {
+        throw std::runtime_error("Mesh streams need one of the vertex layouts in vertex.hpp");
+    }
+
+    if (cells_per_axis < 1)
+    {
+        throw std::runtime_error("Mesh streams need at least one cell per axis");
+    }
+
+    spill.open(path + ".spill", std::ios::binary | std::ios::trunc);
+    if (!spill)
+    {
+        throw std::runtime_error(fmt::format("Cannot create temporary file \"{}.spill\"", path));
+    }
+}
+
+Mesh_Stream_Writer::~Mesh_Stream_Writer()
+{
+    if (!finished)
+    {
+        spill.close();
+
+        std::error_code error;
+        fs::remove(path + ".spill", error);
+        fs::remove(path + ".sorted", error);
+    }
+}
+
+void Mesh_Stream_Writer::add(const void* vertices, GLsizei vertex_count, const std::vector<GLuint>& indices)
+{
+    if (indices.size() % 3 != 0)
+    {
+        throw std::runtime_error("Mesh streams are built from indexed triangle lists");
+    }
+
+    std::vector<GLfloat> positions = mesh_optimizer::read_positions(*format, vertices, vertex_count);
+    const GLubyte* bytes = static_cast<const GLubyte*>(vertices);
+    const std::size_t record_size = 3 * sizeof(GLfloat) + 3 * std::size_t(format->stride);
+    std::vector<char> record(record_size);
+
+    for (std::size_t t = 0; t < indices.size(); t += 3)
+    {
+        glm::vec3 centroid(0.0f);
+
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[t + k];
+            if (v >= GLuint(vertex_count))
+            {
+                throw std::runtime_error("Mesh index out of range of the vertex buffer");
+            }
+
+            glm::vec3 p = positions.empty() ? glm::vec3(0.0f) : glm::vec3(positions[v * 3], positions[v * 3 + 1], positions[v * 3 + 2]);
+            centroid += p / 3.0f;
+
+            bool first = (triangle_count == 0 && t == 0 && k == 0);
+            bounds.min = first ? p : glm::min(bounds.min, p);
+            bounds.max = first ? p : glm::max(bounds.max, p);
+
+            std::memcpy(record.data() + 3 * sizeof(GLfloat) + k * format->stride, bytes + std::size_t(v) * format->stride, format->stride);
+        }
+
+        centroid_bounds.min = (triangle_count == 0 && t == 0) ? centroid : glm::min(centroid_bounds.min, centroid);
+        centroid_bounds.max = (triangle_count == 0 && t == 0) ? centroid : glm::max(centroid_bounds.max, centroid);
+
+        std::memcpy(record.data(), &centroid[0], 3 * sizeof(GLfloat));
+        spill.write(record.data(), std::streamsize(record.size()));
+    }
+
+    triangle_count += indices.size() / 3;
+
+    if (!spill)
+    {
+        throw std::runtime_error(fmt::format("Failed to write temporary file \"{}.spill\"", path));
+    }
+}
+
+std::size_t Mesh_Stream_Writer::finish()
+{
+    if (finished)
+    {
+        throw std::runtime_error("Mesh stream was already written");
+    }
+
+    if (triangle_count == 0)
+    {
+        throw std::runtime_error("Cannot write a mesh stream without triangles");
+    }
+
+    spill.close();
+
+    const std::size_t stride = std::size_t(format->stride);
+    const std::size_t spill_record = 3 * sizeof(GLfloat) + 3 * stride;
+    const std::size_t triangle_size = 3 * stride;
+
+    // cells by triangle centroid, so every triangle lands in exactly one chunk; shorter axes get fewer
+    // cells so chunks stay roughly cubic on flat data
+    const glm::vec3 extent = centroid_bounds.max - centroid_bounds.min;
+    const GLfloat longest = std::max(extent.x, std::max(extent.y, extent.z));
+    GLuint cells[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        cells[k] = longest > 0.0f ? std::max(1u, GLuint(std::lround(cells_per_axis * extent[k] / longest))) : 1u;
+    }
+
+    const std::size_t cell_count = std::size_t(cells[0]) * cells[1] * cells[2];
+
+    auto cell_of = [&](const char* record)
+    {
+        glm::vec3 centroid;
+        std::memcpy(&centroid[0], record, 3 * sizeof(GLfloat));
+
+        std::size_t cell = 0;
+        for (int k = 2; k >= 0; --k)
+        {
+            GLfloat t = extent[k] > 0.0f ? (centroid[k] - centroid_bounds.min[k]) / extent[k] : 0.0f;
+            GLuint c = std::min(cells[k] - 1, GLuint(std::max(0.0f, t * GLfloat(cells[k]))));
+            cell = cell * cells[k] + c;
+        }
+        return cell;
+    };
+
+    // counting pass, then a scatter pass that groups the triangles of each cell in a second file
+    std::vector<std::uint64_t> counts(cell_count, 0);
+    {
+        std::ifstream in(path + ".spill", std::ios::binary);
+        for_each_record(in, 0, triangle_count, spill_record, [&](const char* record, std::uint64_t) { counts[cell_of(record)]++; });
+    }
+
+    std::vector<std::uint64_t> starts(cell_count, 0);
+    for (std::size_t c = 1; c < cell_count; ++c)
+    {
+        starts[c] = starts[c - 1] + counts[c - 1];
+    }
+
+    {
+        std::ifstream in(path + ".spill", std::ios::binary);
+        std::ofstream sorted(path + ".sorted", std::ios::binary | std::ios::trunc);
+
+        // every cell collects triangles in a small buffer that is written out when full
+        const std::size_t buffered = std::max<std::size_t>(1, (std::size_t(16) << 20) / cell_count / triangle_size);
+        std::vector<std::vector<char>> buffers(cell_count);
+        std::vector<std::uint64_t> written(starts);
+
+        auto flush = [&](std::size_t cell)
+        {
+            sorted.seekp(std::streamoff(written[cell] * triangle_size));
+            sorted.write(buffers[cell].data(), std::streamsize(buffers[cell].size()));
+            written[cell] += buffers[cell].size() / triangle_size;
+            buffers[cell].clear();
+        };
+
+        for_each_record(in, 0, triangle_count, spill_record, [&](const char* record, std::uint64_t)
+        {
+            std::size_t cell = cell_of(record);
+            buffers[cell].insert(buffers[cell].end(), record + 3 * sizeof(GLfloat), record + spill_record);
+            if (buffers[cell].size() >= buffered * triangle_size) flush(cell);
+        });
+
+        for (std::size_t cell = 0; cell < cell_count; ++cell)
+        {
+            if (!buffers[cell].empty()) flush(cell);
+        }
+
+        if (!sorted)
+        {
+            throw std::runtime_error(fmt::format("Failed to write temporary file \"{}.sorted\"", path));
+        }
+    }
+
+    std::vector<Chunk_Record> records;
+    for (std::size_t cell = 0; cell < cell_count; ++cell)
+    {
+        if (counts[cell] > 0) records.push_back(Chunk_Record());
+    }
+
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc);
+    std::ifstream sorted(path + ".sorted", std::ios::binary);
+
+    Stream_Header header = {};
+    header.magic = mesh_stream::magic;
+    header.version = mesh_stream::version;
+    header.format = std::uint32_t(std::find(vertex_formats().begin(), vertex_formats().end(), format) - vertex_formats().begin());
+    header.stride = std::uint32_t(stride);
+    header.chunk_count = std::uint32_t(records.size());
+    header.cells_per_axis = cells_per_axis;
+    header.chunk_offset = sizeof(Stream_Header);
+
+    for (int k = 0; k < 3; ++k)
+    {
+        header.bounds_min[k] = bounds.min[k];
+        header.bounds_max[k] = bounds.max[k];
+    }
+
+    // one chunk in memory at a time: its triangle soup is welded back into an indexed list and prepared
+    std::uint64_t offset = page_align(sizeof(Stream_Header) + records.size() * sizeof(Chunk_Record));
+    std::size_t chunk = 0;
+
+    for (std::size_t cell = 0; cell < cell_count; ++cell)
+    {
+        if (counts[cell] == 0) continue;
+
+        std::vector<char> soup(std::size_t(counts[cell]) * triangle_size);
+        sorted.seekg(std::streamoff(starts[cell] * triangle_size));
+        if (!sorted.read(soup.data(), std::streamsize(soup.size())))
+        {
+            throw std::runtime_error(fmt::format("Failed to read temporary file \"{}.sorted\"", path));
+        }
+
+        const std::size_t corner_count = soup.size() / stride;
+        std::vector<GLuint> order(corner_count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](GLuint a, GLuint b)
+        {
+            int difference = std::memcmp(&soup[a * stride], &soup[b * stride], stride);
+            return difference < 0 || (difference == 0 && a < b);
+        });
+
+        Mesh_Data data;
+        data.format = *format;
+        data.indices.resize(corner_count);
+
+        for (std::size_t i = 0; i < corner_count; ++i)
+        {
+            if (i == 0 || std::memcmp(&soup[order[i] * stride], &soup[order[i - 1] * stride], stride) != 0)
+            {
+                data.vertices.insert(data.vertices.end(), &soup[order[i] * stride], &soup[order[i] * stride] + stride);
+                data.vertex_count++;
+            }
+            data.indices[order[i]] = GLuint(data.vertex_count - 1);
+        }
+
+        std::vector<char>().swap(soup);
+        Mesh::prepare(data, optimize);
+
+        GLenum index_type = mesh_optimizer::index_type(data.vertex_count);
+        std::vector<GLubyte> packed = mesh_optimizer::pack_indices(data.indices, index_type);
+
+        Chunk_Record& record = records[chunk++];
+        for (int k = 0; k < 3; ++k)
+        {
+            record.bounds_min[k] = data.bounds.min[k];
+            record.bounds_max[k] = data.bounds.max[k];
+        }
+        record.vertex_count = std::uint32_t(data.vertex_count);
+        record.index_count = std::uint32_t(data.indices.size());
+        record.index_type = index_type;
+        record.offset = offset;
+        record.vertex_bytes = data.vertices.size();
+        record.index_bytes = packed.size();
+
+        out.seekp(std::streamoff(offset));
+        out.write(reinterpret_cast<const char*>(data.vertices.data()), std::streamsize(data.vertices.size()));
+        out.write(reinterpret_cast<const char*>(packed.data()), std::streamsize(packed.size()));
+        offset = page_align(offset + record.vertex_bytes + record.index_bytes);
+    }
+
+    // the last chunk is padded too, so every chunk can be read in whole pages
+    header.file_size = offset;
+    out.seekp(std::streamoff(offset - 1));
+    out.put(0);
+
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(Chunk_Record)));
+
+    if (!out)
+    {
+        throw std::runtime_error(fmt::format("Failed to write mesh stream \"{}\"", path));
+    }
+
+    sorted.close();
+    finished = true;
+
+    std::error_code error;
+    fs::remove(path + ".spill", error);
+    fs::remove(path + ".sorted", error);
+
+    return records.size();
+}
+
+Mesh_Stream::Mesh_Stream(const std::string& path, Asset_Loader& loader, std::size_t memory_budget, std::size_t max_loads)
+: file(std::make_shared<Mapped_File>(path)), loader(loader), format(nullptr), budget(memory_budget), used(0),
+  max_loads(std::max<std::size_t>(1, max_loads)), frame(0)
+{
+    Stream_Header header;
+    if (file->size() < sizeof(header))
+    {
+        throw std::runtime_error(fmt::format("\"{}\" is no mesh stream", path));
+    }
+
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (header.magic != mesh_stream::magic || header.version != mesh_stream::version || header.file_size != file->size())
+    {
+        throw std::runtime_error(fmt::format("\"{}\" is no mesh stream of version {}", path, mesh_stream::version));
+    }
+
+    if (header.format >= vertex_formats().size() || GLuint(vertex_formats()[header.format]->stride) != header.stride ||
+        header.chunk_offset > file->size() || header.chunk_count > (file->size() - header.chunk_offset) / sizeof(Chunk_Record))
+    {
+        throw std::runtime_error(fmt::format("Mesh stream \"{}\" is damaged", path));
+    }
+
+    format = vertex_formats()[header.format];
+    bounds.min = glm::vec3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]);
+    bounds.max = glm::vec3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]);
+
+    for (std::uint32_t i = 0; i < header.chunk_count; ++i)
+    {
+        Chunk_Record record;
+        std::memcpy(&record, file->data() + header.chunk_offset + i * sizeof(Chunk_Record), sizeof(record));
+
+        std::uint64_t bytes = record.vertex_bytes + record.index_bytes;
+        if (record.offset > file->size() || bytes > file->size() - record.offset ||
+            record.vertex_bytes != std::uint64_t(record.vertex_count) * header.stride ||
+            record.index_bytes != std::uint64_t(record.index_count) * mesh_optimizer::index_size(record.index_type))
+        {
+            throw std::runtime_error(fmt::format("Mesh stream \"{}\" is damaged", path));
+        }
+
+        Chunk chunk;
+        chunk.bounds.min = glm::vec3(record.bounds_min[0], record.bounds_min[1], record.bounds_min[2]);
+        chunk.bounds.max = glm::vec3(record.bounds_max[0], record.bounds_max[1], record.bounds_max[2]);
+        chunk.offset = record.offset;
+        chunk.vertex_count = GLsizei(record.vertex_count);
+        chunk.index_count = GLsizei(record.index_count);
+        chunk.index_type = record.index_type;
+        chunk.bytes = std::size_t(bytes);
+        chunk.last_wanted = 0;
+        chunks.push_back(chunk);
+    }
+
+    order.resize(chunks.size());
+    std::iota(order.begin(), order.end(), 0);
+}
+
+void Mesh_Stream::evict(Chunk& chunk)
+{
+    // a load still in flight is dropped by the loader once nobody holds its handle
+    chunk.asset.reset();
+    used -= chunk.bytes;
+}
+
+void Mesh_Stream::update(const glm::vec3& eye)
+{
+    frame++;
+
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b)
+    {
+        return distance(eye, chunks[a].bounds) < distance(eye, chunks[b].bounds);
+    });
+
+    // the nearest chunks that fit the budget together are wanted this frame
+    std::size_t wanted_bytes = 0;
+    std::size_t wanted = 0;
+    std::size_t loads = 0;
+
+    for (std::size_t i : order)
+    {
+        Chunk& chunk = chunks[i];
+        if (wanted_bytes + chunk.bytes > budget) break;
+
+        wanted_bytes += chunk.bytes;
+        chunk.last_wanted = frame;
+        wanted++;
+    }
+
+    for (Chunk& chunk : chunks)
+    {
+        // rethrows the error of a failed load
+        if (chunk.asset && !chunk.asset->ready()) loads++;
+    }
+
+    for (std::size_t n = 0; n < wanted && loads < max_loads; ++n)
+    {
+        Chunk& chunk = chunks[order[n]];
+        if (chunk.asset) continue;
+
+        // space is made by evicting chunks that are not wanted, least recently wanted first; the wanted
+        // ones fit the budget together, so this always succeeds
+        while (used + chunk.bytes > budget)
+        {
+            Chunk* victim = nullptr;
+            for (Chunk& candidate : chunks)
+            {
+                if (candidate.asset && candidate.last_wanted != frame && (!victim || candidate.last_wanted < victim->last_wanted))
+                {
+                    victim = &candidate;
+                }
+            }
+
+            if (!victim) return;
+            evict(*victim);
+        }
+
+        std::shared_ptr<Mapped_File> source = file;
+        const Vertex_Format* chunk_format = format;
+        const Chunk info = chunk;
+
+        chunk.asset = loader.load_mesh([source, chunk_format, info]()
+        {
+            const GLubyte* bytes = reinterpret_cast<const GLubyte*>(source->data()) + info.offset;
+            const std::size_t vertex_bytes = std::size_t(info.vertex_count) * chunk_format->stride;
+
+            Mesh_Data data;
+            data.format = *chunk_format;
+            data.vertex_count = info.vertex_count;
+            data.vertices.assign(bytes, bytes + vertex_bytes);
+
+            Mesh_Cache_View view;
+            view.index_count = info.index_count;
+            view.index_type = info.index_type;
+            view.indices = bytes + vertex_bytes;
+            data.indices = mesh_cache::unpack_indices(view);
+            return data;
+        });
+
+        used += chunk.bytes;
+        loads++;
+    }
+}
+
+void Mesh_Stream::draw(Gl_State& state, Shader& shader)
+{
+    state.use_program(shader);
+
+    for (Chunk& chunk : chunks)
+    {
+        if (!chunk.asset || chunk.asset->state != ASSET_STATE_READY) continue;
+
+        Mesh& mesh = *chunk.asset->value;
+        mesh.bind(state, shader);
+        glDrawElementsBaseVertex(mesh.topology, mesh.index_count, mesh.index_type, mesh.index_offset(), mesh.base_vertex());
+    }
+}
+
+std::size_t Mesh_Stream::resident_count() const
+{
+    std::size_t count = 0;
+    for (const Chunk& chunk : chunks)
+    {
+        count += (chunk.asset && chunk.asset->state == ASSET_STATE_READY);
+    }
+    return count;
+}
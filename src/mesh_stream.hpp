@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+#include "asset_loader.hpp"
+
+class Shader;
+class Mapped_File;
+
+// Paged file of spatial chunks. A header and the chunk table come first; every chunk is an indexed
+// triangle list (vertices, then indices packed to the chunk's index type) starting on a page boundary,
+// so one chunk is read without touching its neighbours. Only hosts with little endian byte order are
+// supported.
+namespace mesh_stream
+{
+    const std::uint32_t magic = 0x4d525453;  // "STRM"
+    const std::uint32_t version = 1;
+    const std::uint64_t page_size = 4096;
+}
+
+// Builds a stream file from geometry that does not have to fit in memory. Triangles are spilled to a
+// temporary file as they are added; finish() partitions them into a grid of up to cells_per_axis chunks
+// along each axis of their bounds and prepares one chunk at a time (welding, optimize), so memory use is bounded by
+// the largest chunk rather than the whole data set.
+class Mesh_Stream_Writer
+{
+private:
+    std::string path;
+    const Vertex_Format* format;
+    GLuint cells_per_axis;
+    GLbitfield optimize;
+
+    std::ofstream spill;        // per triangle: centroid, then its three vertices
+    std::uint64_t triangle_count;
+    Mesh_Bounds bounds;         // of all vertices
+    Mesh_Bounds centroid_bounds;
+    bool finished;
+
+public:
+    // format has to be one of the layouts in vertex.hpp; only the vertex cache, overdraw and vertex
+    // fetch bits of optimize apply to chunks
+    Mesh_Stream_Writer(const std::string& path, const Vertex_Format& format, GLuint cells_per_axis = 16,
+                       GLbitfield optimize = MESH_OPTIMIZE_ALL);
+    ~Mesh_Stream_Writer();
+
+    Mesh_Stream_Writer(const Mesh_Stream_Writer&) = delete;
+    Mesh_Stream_Writer& operator=(const Mesh_Stream_Writer&) = delete;
+
+    // appends a batch of indexed triangles in the writer's vertex format
+    void add(const void* vertices, GLsizei vertex_count, const std::vector<GLuint>& indices);
+
+    // writes the stream file and removes the temporary files; returns the number of chunks
+    std::size_t finish();
+};
+
+// Mesh too large for memory, drawn from the chunks of a stream file that are resident at the time.
+// Every update() ranks the chunks by distance to the eye and keeps the nearest ones that fit in
+// memory_budget bytes wanted; wanted chunks are loaded through the asset loader (file access on its
+// workers, budgeted incremental upload), nearest first. Chunks that are no longer wanted stay
+// resident until their space is needed and are then evicted least recently wanted first.
+class Mesh_Stream
+{
+private:
+    struct Chunk
+    {
+        Mesh_Bounds bounds;
+        std::uint64_t offset;
+        GLsizei vertex_count;
+        GLsizei index_count;
+        GLenum index_type;
+        std::size_t bytes;      // vertex and index data, as uploaded
+
+        std::shared_ptr<Asset<Mesh>> asset;     // set while loading or resident
+        std::uint64_t last_wanted;
+    };
+
+    std::shared_ptr<Mapped_File> file;
+    Asset_Loader& loader;
+    const Vertex_Format* format;
+    Mesh_Bounds bounds;
+    std::vector<Chunk> chunks;
+    std::vector<std::size_t> order;     // chunk indices by distance to the eye, reused
+
+    std::size_t budget;
+    std::size_t used;                   // bytes of chunks that are loading or resident
+    std::size_t max_loads;
+    std::uint64_t frame;
+
+    void evict(Chunk& chunk);
+
+public:
+    // max_loads bounds the chunks loading at once, so a fast moving eye does not queue up loads that
+    // are stale by the time they finish
+    Mesh_Stream(const std::string& path, Asset_Loader& loader, std::size_t memory_budget, std::size_t max_loads = 4);
+
+    Mesh_Stream(const Mesh_Stream&) = delete;
+    Mesh_Stream& operator=(const Mesh_Stream&) = delete;
+
+    // once per frame; eye in the stream's model space
+    void update(const glm::vec3& eye);
+
+    // draws the resident chunks with shader, which the caller has set up
+    void draw(Gl_State& state, Shader& shader);
+
+    const Mesh_Bounds& bounding_box() const { return bounds; }
+    std::size_t chunk_count() const { return chunks.size(); }
+    std::size_t resident_count() const;
+    std::size_t used_bytes() const { return used; }
+};
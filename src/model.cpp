@@ -1,5 +1,10 @@
 #include "model.hpp"
 
+#include <cstdint>
+#include <stdexcept>
+
+#include <glm/gtc/type_ptr.hpp>
+
 #include "mesh.hpp"
 #include "shader.hpp"
 //#include "texture.hpp"
@@ -7,29 +12,196 @@
 Model::Model(std::shared_ptr<Mesh>& mesh, std::shared_ptr<Shader>& shader)
 : mesh(mesh), shader(shader), texture(nullptr)
 {
-    vao = mesh->vao;
+    mesh->vertex_array(*shader);
     topology = mesh->topology;
-    index_count = (mesh->indices.size() > 0) ? mesh->indices.size() : mesh->vertices.size();
-    index_type = GL_UNSIGNED_INT;
+    index_count = (mesh->index_count > 0) ? mesh->index_count : mesh->vertex_count;
+    index_type = mesh->index_type;
 }
 
 Model::Model(std::shared_ptr<Mesh>& mesh, std::shared_ptr<Shader>& shader, std::shared_ptr<Texture>& texture)
 : mesh(mesh), shader(shader), texture(texture)
 {
-    vao = mesh->vao;
+    mesh->vertex_array(*shader);
     topology = mesh->topology;
-    index_count = (mesh->indices.size() > 0) ? mesh->indices.size() : mesh->vertices.size();
-    index_type = GL_UNSIGNED_INT;
+    index_count = (mesh->index_count > 0) ? mesh->index_count : mesh->vertex_count;
+    index_type = mesh->index_type;
 }
 
 Model::Model(std::vector<Body>& bodies)
-: bodies(bodies)
+: bodies(bodies), topology(GL_TRIANGLES), index_type(GL_UNSIGNED_INT), index_count(0)
 {
-    
+    for (Body& body : this->bodies)
+    {
+        if (!body.mesh || !body.shader)
+        {
+            throw std::runtime_error("Model bodies need a mesh and a shader");
+        }
+
+        body.mesh->vertex_array(*body.shader);
+    }
 }
 
 Model::Model(std::vector<Body>& bodies, std::shared_ptr<Shader>& shader)
-: bodies(bodies), shader(shader)
+: bodies(bodies), shader(shader), topology(GL_TRIANGLES), index_type(GL_UNSIGNED_INT), index_count(0)
 {
+    for (Body& body : this->bodies)
+    {
+        if (!body.mesh)
+        {
+            throw std::runtime_error("Model bodies need a mesh");
+        }
+
+        body.shader = shader;
+        body.mesh->vertex_array(*shader);
+    }
+}
+
+namespace
+{
+    std::vector<Body> instance_bodies(const std::vector<Mesh_Instance>& instances)
+    {
+        std::vector<Body> bodies;
+
+        for (const Mesh_Instance& instance : instances)
+        {
+            Body body;
+            body.mesh = instance.mesh;
+            body.transform = instance.transform;
+            bodies.push_back(body);
+        }
+
+        return bodies;
+    }
+}
+
+std::shared_ptr<Model> Model::load_gltf(const std::string& gltf_file_path, std::shared_ptr<Shader>& shader, GLbitfield optimize, Mesh_Storage storage)
+{
+    std::vector<Body> bodies = instance_bodies(Mesh::load_gltf(gltf_file_path, optimize, storage));
+    return std::make_shared<Model>(bodies, shader);
+}
+
+std::shared_ptr<Model> Model::load_fbx(const std::string& fbx_file_path, std::shared_ptr<Shader>& shader, GLbitfield optimize, Mesh_Storage storage)
+{
+    std::vector<Body> bodies = instance_bodies(Mesh::load_fbx(fbx_file_path, optimize, storage));
+    return std::make_shared<Model>(bodies, shader);
+}
+
+Draw_Packet Model::packet() const
+{
+    if (!mesh)
+    {
+        throw std::runtime_error("Models made of bodies are drawn through Model::packets()");
+    }
+
+    Draw_Packet packet;
+    packet.shader = shader.get();
+    packet.mesh = mesh.get();
+    packet.count = index_count;
+    return packet;
+}
+
+Draw_Packet Model::packet(const Instance_Range& instances) const
+{
+    Draw_Packet packet = this->packet();
+    packet.base_instance = instances.first;
+    packet.instance_count = instances.count;
+    packet.instance_format = instances.format;
+    packet.instance_buffer = instances.buffer;
+    return packet;
+}
+
+void Model::packets(std::vector<Draw_Packet>& packets, const glm::mat4& model_matrix, Object_Uniforms* objects, GLuint first_object,
+                    const Lod_View* view, const Cull_View* cull)
+{
+    if (bodies.empty())
+    {
+        objects[0].model = model_matrix;
+        mesh_packets(packets, *mesh, *shader, model_matrix, first_object, view, cull);
+        return;
+    }
+
+    for (std::size_t i = 0; i < bodies.size(); ++i)
+    {
+        const Body& body = bodies[i];
+        glm::mat4 transform = model_matrix * body.transform;
+
+        objects[i].model = transform;
+        mesh_packets(packets, *body.mesh, *body.shader, transform, first_object + GLuint(i), view, cull);
+    }
+}
+
+void Model::mesh_packets(std::vector<Draw_Packet>& packets, Mesh& mesh, Shader& shader, const glm::mat4& transform, GLuint object,
+                         const Lod_View* view, const Cull_View* cull)
+{
+    Draw_Packet packet;
+    packet.shader = &shader;
+    packet.mesh = &mesh;
+    packet.count = (mesh.index_count > 0) ? mesh.index_count : mesh.vertex_count;
+    packet.base_instance = object;
+
+    // all levels live in the one index buffer; only the selected range is drawn
+    GLsizei level = (view && mesh.index_count > 0) ? mesh.select_lod(transform, *view) : 0;
+    if (level > 0)
+    {
+        std::pair<GLsizei, GLsizei> range = mesh.lod_range(level);
+        packet.first = range.first;
+        packet.count = range.second;
+    }
+
+    // meshlets only cover the full detail triangles
+    if (level > 0 || !cull || mesh.meshlets.empty())
+    {
+        packets.push_back(packet);
+        return;
+    }
+
+    meshlet_ranges.clear();
+    mesh.cull_meshlets(transform, *cull, meshlet_ranges);
+
+    for (const std::pair<GLsizei, GLsizei>& range : meshlet_ranges)
+    {
+        packets.push_back(packet);
+        packets.back().first = range.first;
+        packets.back().count = range.second;
+    }
+}
+
+void Model::draw_instanced(Gl_State& state, const Instance_Range& instances)
+{
+    if (instances.count == 0) return;
+
+    auto draw_mesh = [&instances](const Mesh& mesh)
+    {
+        if (mesh.index_count > 0)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(mesh.topology, mesh.index_count, mesh.index_type, mesh.index_offset(0),
+                                                          instances.count, mesh.base_vertex(), instances.first);
+        }
+        else
+        {
+            glDrawArraysInstancedBaseInstance(mesh.topology, mesh.base_vertex(), mesh.vertex_count, instances.count, instances.first);
+        }
+    };
+
+    if (bodies.empty())
+    {
+        state.use_program(*shader);
+        mesh->bind(state, *shader, instances.format, instances.buffer);
+        draw_mesh(*mesh);
+        return;
+    }
+
+    for (const Body& body : bodies)
+    {
+        state.use_program(*body.shader);
+
+        const Shader_Variable* uniform = body.shader->find_uniform("model");
+        if (uniform && uniform->type == GL_FLOAT_MAT4)
+        {
+            glProgramUniformMatrix4fv(*body.shader, uniform->location, 1, GL_FALSE, glm::value_ptr(body.transform));
+        }
 
+        body.mesh->bind(state, *body.shader, instances.format, instances.buffer);
+        draw_mesh(*body.mesh);
+    }
 }
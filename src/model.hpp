@@ -1,13 +1,19 @@
 #pragma once
 
 #include <tuple>
+#include <string>
 #include <vector>
 #include <memory>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include "mesh.hpp"
+#include "gpu_ring.hpp"
+#include "uniforms.hpp"
+#include "render_queue.hpp"
 
-class Mesh;
 class Shader;
 class Texture;
 
@@ -16,6 +22,34 @@ struct Body // model parts
     std::shared_ptr<Mesh> mesh;
     std::shared_ptr<Shader> shader;
     std::shared_ptr<Texture> texture;
+    glm::mat4 transform = glm::mat4(1.0f); // body space to model space
+};
+
+// Per-instance records for an instanced draw: count records of format, starting at record first of
+// buffer. The first record is reached through the draw's base instance, so instanced shaders read no
+// object records.
+struct Instance_Range
+{
+    const Vertex_Format* format = nullptr;
+    GLuint buffer = 0;
+    GLuint first = 0;
+    GLsizei count = 0;
+
+    // count records of type Instance (an instance layout from vertex.hpp) in the current frame of
+    // ring, for the caller to fill through records before the draw is issued
+    template <typename Instance>
+    static Instance_Range allocate(Gpu_Ring& ring, GLsizei count, Instance*& records)
+    {
+        Gpu_Ring_Allocation allocation = ring.allocate(GLsizeiptr(count) * Instance::stride, Instance::stride);
+        records = static_cast<Instance*>(allocation.data);
+
+        Instance_Range range;
+        range.format = &Instance::format();
+        range.buffer = allocation.buffer;
+        range.first = GLuint(allocation.offset / Instance::stride);
+        range.count = count;
+        return range;
+    }
 };
 
 class Model
@@ -23,14 +57,19 @@ class Model
 friend class Renderer;
 
 private:
-    GLuint vao;
-
     std::vector<Body> bodies; // TODO: remove mesh, shader, texture pointers
 
+    // visible meshlet ranges, reused from call to call
+    std::vector<std::pair<GLsizei, GLsizei>> meshlet_ranges;
+
     std::shared_ptr<Mesh> mesh;
     std::shared_ptr<Shader> shader;
     std::shared_ptr<Texture> texture;
 
+    // the draws of one mesh placed by transform, reading object record object
+    void mesh_packets(std::vector<Draw_Packet>& packets, Mesh& mesh, Shader& shader, const glm::mat4& transform, GLuint object,
+                      const Lod_View* view, const Cull_View* cull);
+
 public:
     GLenum topology;
     GLenum index_type;
@@ -43,5 +82,47 @@ public:
     Model(std::vector<Body>& bodies);
     Model(std::vector<Body>& bodies, std::shared_ptr<Shader>& shader); // one shader for all bodies
 
-    operator GLuint() { return vao; }
+    // one body per mesh primitive of the glTF/GLB scene, placed by its node transform
+    static std::shared_ptr<Model> load_gltf(const std::string& gltf_file_path,
+                                            std::shared_ptr<Shader>& shader,
+                                            GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                            Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // one body per FBX model with geometry, placed by its world transform
+    static std::shared_ptr<Model> load_fbx(const std::string& fbx_file_path,
+                                           std::shared_ptr<Shader>& shader,
+                                           GLbitfield optimize = MESH_OPTIMIZE_NONE,
+                                           Mesh_Storage storage = MESH_STORAGE_GPU);
+
+    // Draws instances.count copies of every body, each reading one record of instances through the
+    // attributes of its layout; bodies still get body.transform as their "model" uniform. No levels of
+    // detail or meshlet culling: the records place the copies, so only the shader knows where they are.
+    void draw_instanced(Gl_State& state, const Instance_Range& instances);
+
+    // full detail draw of a single-mesh model with its shader, for the render queue; reads object
+    // record 0 unless the caller sets base_instance
+    Draw_Packet packet() const;
+
+    // instanced full detail draw of a single-mesh model, for the render queue
+    Draw_Packet packet(const Instance_Range& instances) const;
+
+    // object records packets() fills: one per body, or one for a single-mesh model
+    GLsizei object_count() const { return bodies.empty() ? 1 : GLsizei(bodies.size()); }
+
+    // Appends the draws of the model placed by model_matrix, for the render queue: those of every body,
+    // or of the mesh of a single-mesh model. objects[i], record first_object + i of the frame's Objects
+    // block, receives the model matrix of body i, which its draws read through their base instance.
+    // With a view, meshes with levels of detail draw the coarsest one that is accurate enough there.
+    // With cull, a full detail draw of a mesh with meshlets becomes one copy per range of visible
+    // meshlets (none if all are culled); the copies share their state, so the queue joins them into
+    // one multi-draw.
+    void packets(std::vector<Draw_Packet>& packets, const glm::mat4& model_matrix, Object_Uniforms* objects, GLuint first_object,
+                 const Lod_View* view = nullptr, const Cull_View* cull = nullptr);
+
+    // binds the vertex array of a single-mesh model for its shader
+    void bind(Gl_State& state) { mesh->bind(state, *shader); }
+
+    // where the indices and vertices of a single-mesh model start in the buffers bind() attaches
+    const void* index_offset() const { return mesh ? mesh->index_offset() : nullptr; }
+    GLint base_vertex() const { return mesh ? mesh->base_vertex() : 0; }
 };
@@ -0,0 +1,248 @@
+#include "render_queue.hpp"
+
+#include <array>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "mesh.hpp"
+#include "shader.hpp"
+
+namespace
+{
+    const int program_bits = 12;
+    const int material_bits = 12;
+    const int geometry_bits = 11;
+    const int depth_bits = 24;
+
+    // id in order of first use; looked up before inserting, as emplace allocates a node every call
+    template <typename Map, typename Key>
+    std::uint32_t dense_id(Map& ids, const Key& key)
+    {
+        auto it = ids.find(key);
+        if (it != ids.end()) return it->second;
+
+        std::uint32_t id = std::uint32_t(ids.size());
+        ids.emplace(key, id);
+        return id;
+    }
+
+    // saturated to the field width
+    std::uint64_t field(std::uint32_t id, int bits)
+    {
+        return std::min(id, (1u << bits) - 1);
+    }
+
+    // positive floats order like their bit patterns; the top bits below the sign are kept
+    std::uint32_t quantize_depth(GLfloat depth)
+    {
+        depth = std::max(depth, 0.0f);
+
+        std::uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> (31 - depth_bits);
+    }
+}
+
+bool Render_Queue::Geometry::operator==(const Geometry& other) const
+{
+    return vertex_array == other.vertex_array && vertex_buffer == other.vertex_buffer && index_buffer == other.index_buffer &&
+           instance_buffer == other.instance_buffer && topology == other.topology && index_type == other.index_type;
+}
+
+std::size_t Render_Queue::Geometry_Hash::operator()(const Geometry& geometry) const
+{
+    std::uint64_t hash = geometry.vertex_array;
+    hash = hash * 0x9E3779B97F4A7C15ull + geometry.vertex_buffer;
+    hash = hash * 0x9E3779B97F4A7C15ull + geometry.index_buffer;
+    hash = hash * 0x9E3779B97F4A7C15ull + geometry.instance_buffer;
+    hash = hash * 0x9E3779B97F4A7C15ull + (geometry.topology << 16 ^ geometry.index_type);
+    return std::size_t(hash ^ (hash >> 29));
+}
+
+void Render_Queue::submit(const Draw_Packet& packet)
+{
+    if (!packet.shader || !packet.mesh || packet.layer > 15)
+    {
+        throw std::runtime_error("Draw packets need a shader, a mesh and a layer from 0 to 15");
+    }
+
+    const Mesh& mesh = *packet.mesh;
+    Geometry geometry = { packet.mesh->vertex_array(*packet.shader, packet.instance_format), mesh.vertex_range.buffer, mesh.index_range.buffer,
+                          packet.instance_buffer, mesh.topology, mesh.index_type };
+
+    Packet_State state;
+    state.program = dense_id(program_ids, GLuint(*packet.shader));
+    state.material = dense_id(material_ids, packet.texture);
+    state.geometry = dense_id(geometry_ids, geometry);
+
+    std::uint64_t program = field(state.program, program_bits);
+    std::uint64_t material = field(state.material, material_bits);
+    std::uint64_t vertices = field(state.geometry, geometry_bits);
+    std::uint64_t depth = quantize_depth(packet.depth);
+
+    std::uint64_t key = std::uint64_t(packet.layer) << 60;
+    if (!packet.transparent)
+    {
+        key |= program << (material_bits + geometry_bits + depth_bits);
+        key |= material << (geometry_bits + depth_bits);
+        key |= vertices << depth_bits;
+        key |= depth;
+    }
+    else
+    {
+        // back to front first; state only orders draws at the same depth
+        key |= std::uint64_t(1) << 59;
+        key |= (~depth & ((std::uint64_t(1) << depth_bits) - 1)) << (program_bits + material_bits + geometry_bits);
+        key |= program << (material_bits + geometry_bits);
+        key |= material << geometry_bits;
+        key |= vertices;
+    }
+
+    items.push_back({ key, std::uint32_t(packets.size()) });
+    packets.push_back(packet);
+    packet_states.push_back(state);
+}
+
+void Render_Queue::sort()
+{
+    // the histograms of all bytes in one read of the keys
+    std::vector<std::array<std::uint32_t, 256>> counts(8);
+    for (auto& digit : counts) digit.fill(0);
+
+    for (const Item& item : items)
+    {
+        for (int byte = 0; byte < 8; ++byte)
+        {
+            counts[byte][(item.key >> (byte * 8)) & 0xFF]++;
+        }
+    }
+
+    scratch.resize(items.size());
+
+    for (int byte = 0; byte < 8; ++byte)
+    {
+        const int shift = byte * 8;
+        std::array<std::uint32_t, 256>& digit = counts[byte];
+
+        // every key has the same byte here: the pass would not move anything
+        if (digit[(items.front().key >> shift) & 0xFF] == items.size()) continue;
+
+        std::uint32_t offset = 0;
+        for (std::uint32_t& count : digit)
+        {
+            std::uint32_t next = offset + count;
+            count = offset;
+            offset = next;
+        }
+
+        // stable, so the order of the lower bytes from earlier passes is kept
+        for (const Item& item : items)
+        {
+            scratch[digit[(item.key >> shift) & 0xFF]++] = item;
+        }
+
+        items.swap(scratch);
+        stats.sort_passes++;
+    }
+}
+
+void Render_Queue::execute(Gl_State& state, Gpu_Ring& ring)
+{
+    stats = Render_Queue_Statistics();
+    stats.packets = packets.size();
+
+    if (items.empty()) return;
+    sort();
+
+    // one command per packet, of either kind
+    Gpu_Ring_Allocation commands = ring.allocate(GLsizeiptr(items.size() * sizeof(Draw_Elements_Indirect_Command)), 4);
+    GLubyte* command = static_cast<GLubyte*>(commands.data);
+    state.bind_buffer(GL_DRAW_INDIRECT_BUFFER, commands.buffer);
+
+    const Packet_State* previous = nullptr;
+    for (std::size_t begin = 0; begin < items.size();)
+    {
+        const Draw_Packet& packet = packets[items[begin].packet];
+        const Packet_State& batch = packet_states[items[begin].packet];
+        Mesh& mesh = *packet.mesh;
+
+        if (!previous || previous->program != batch.program) stats.program_changes++;
+        if (!previous || previous->material != batch.material) stats.material_changes++;
+        if (!previous || previous->geometry != batch.geometry) stats.geometry_changes++;
+
+        state.use_program(*packet.shader);
+        mesh.bind(state, *packet.shader, packet.instance_format, packet.instance_buffer);
+        if (packet.texture) state.bind_texture(0, packet.texture);
+
+        if (packet.transparent)
+        {
+            state.enable(GL_BLEND);
+            state.blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            state.depth_mask(GL_FALSE);
+        }
+        else
+        {
+            state.disable(GL_BLEND);
+            state.depth_mask(GL_TRUE);
+        }
+
+        const bool indexed = mesh.index_count > 0;
+        const GLintptr offset = commands.offset + (command - static_cast<GLubyte*>(commands.data));
+
+        // the run: packets whose draws only differ in ranges and object records
+        std::size_t end = begin;
+        for (; end < items.size(); ++end)
+        {
+            const Draw_Packet& next = packets[items[end].packet];
+            const Packet_State& next_batch = packet_states[items[end].packet];
+
+            if (next_batch.program != batch.program || next_batch.material != batch.material ||
+                next_batch.geometry != batch.geometry || next.transparent != packet.transparent) break;
+
+            const Mesh& next_mesh = *next.mesh;
+            if (indexed)
+            {
+                Draw_Elements_Indirect_Command draw;
+                draw.count = GLuint(next.count);
+                draw.instance_count = GLuint(next.instance_count);
+                draw.first_index = GLuint(next_mesh.index_range.offset / mesh_optimizer::index_size(next_mesh.index_type) + next.first);
+                draw.base_vertex = next_mesh.base_vertex();
+                draw.base_instance = next.base_instance;
+                std::memcpy(command, &draw, sizeof(draw));
+                command += sizeof(draw);
+            }
+            else
+            {
+                Draw_Arrays_Indirect_Command draw;
+                draw.count = GLuint(next.count);
+                draw.instance_count = GLuint(next.instance_count);
+                draw.first = GLuint(next_mesh.base_vertex() + next.first);
+                draw.base_instance = next.base_instance;
+                std::memcpy(command, &draw, sizeof(draw));
+                command += sizeof(draw);
+            }
+        }
+
+        if (indexed)
+        {
+            glMultiDrawElementsIndirect(mesh.topology, mesh.index_type, (const void*)std::uintptr_t(offset), GLsizei(end - begin), 0);
+        }
+        else
+        {
+            glMultiDrawArraysIndirect(mesh.topology, (const void*)std::uintptr_t(offset), GLsizei(end - begin), 0);
+        }
+
+        stats.batches++;
+        previous = &batch;
+        begin = end;
+    }
+
+    packets.clear();
+    packet_states.clear();
+    items.clear();
+    program_ids.clear();
+    material_ids.clear();
+    geometry_ids.clear();
+}
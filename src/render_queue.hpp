@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+#include <glad/glad.h>
+
+#include "gl_state.hpp"
+#include "gpu_ring.hpp"
+
+class Mesh;
+class Shader;
+struct Vertex_Format;
+
+// one draw submitted to the render queue; the mesh and shader have to stay alive until the queue ran
+struct Draw_Packet
+{
+    Shader* shader = nullptr;
+    Mesh* mesh = nullptr;
+    GLsizei first = 0;              // index range, or vertex range for non-indexed meshes
+    GLsizei count = 0;
+    GLuint texture = 0;             // the material: bound to texture unit 0 (0 for none)
+    GLuint base_instance = 0;       // first object record (gl_BaseInstanceARB), or first instance record
+    GLsizei instance_count = 1;
+    const Vertex_Format* instance_format = nullptr;     // per-instance attributes read from instance_buffer
+    GLuint instance_buffer = 0;
+    GLfloat depth = 0.0f;           // view space distance; negative values count as 0
+    std::uint8_t layer = 0;         // 0 to 15; layers are drawn in increasing order
+    bool transparent = false;       // blended, without depth writes, after the opaque draws of its layer
+};
+
+// layouts glMultiDraw*Indirect reads
+struct Draw_Elements_Indirect_Command
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;         // in indices from the start of the element buffer
+    GLint base_vertex;
+    GLuint base_instance;
+};
+
+struct Draw_Arrays_Indirect_Command
+{
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+struct Render_Queue_Statistics
+{
+    std::size_t packets = 0;
+    std::size_t batches = 0;            // multi-draw calls
+    std::size_t program_changes = 0;
+    std::size_t material_changes = 0;
+    std::size_t geometry_changes = 0;   // vertex array or attached buffers
+    int sort_passes = 0;                // radix passes that were not skipped
+};
+
+// Draws of a frame, collected first and then issued in the order of a 64-bit key per packet:
+//
+//   opaque       layer:4 | 0:1 | program:12 | material:12 | geometry:11 | depth:24
+//   transparent  layer:4 | 1:1 | ~depth:24  | program:12  | material:12 | geometry:11
+//
+// Opaque draws are grouped by program, then texture, then vertex array and buffers, and go front to
+// back within a group; transparent ones go strictly back to front. Programs, materials and geometry
+// get dense ids in order of first submission each frame (ids past the field width share the last
+// value, which only costs grouping). Depth is the upper bits of the float, which order like the
+// value for positive floats. The keys are sorted with an 8-bit LSD radix sort that skips the passes
+// over bytes all keys share.
+//
+// Sorted runs of packets with the same program, texture, vertex array, buffers (instance buffers
+// included), topology and blending
+// are drawn with one glMultiDrawElementsIndirect (or glMultiDrawArraysIndirect) call whose commands
+// are written to the frame ring. Per-draw data comes from the object records through the command's
+// base instance (gl_BaseInstanceARB + gl_InstanceID), so shaders need no gl_DrawIDARB lookup table.
+// GL thread only.
+class Render_Queue
+{
+private:
+    struct Item
+    {
+        std::uint64_t key;
+        std::uint32_t packet;
+    };
+
+    // what a multi-draw shares; packets with equal ids and blending can join one
+    struct Packet_State
+    {
+        std::uint32_t program;
+        std::uint32_t material;
+        std::uint32_t geometry;     // vertex array, attached buffers, topology and index type
+    };
+
+    struct Geometry
+    {
+        GLuint vertex_array;
+        GLuint vertex_buffer;
+        GLuint index_buffer;        // 0 for non-indexed meshes
+        GLuint instance_buffer;     // 0 when not instanced
+        GLenum topology;
+        GLenum index_type;
+
+        bool operator==(const Geometry& other) const;
+    };
+
+    struct Geometry_Hash
+    {
+        std::size_t operator()(const Geometry& geometry) const;
+    };
+
+    std::vector<Draw_Packet> packets;
+    std::vector<Packet_State> packet_states;
+    std::vector<Item> items;
+    std::vector<Item> scratch;
+
+    std::unordered_map<GLuint, std::uint32_t> program_ids;
+    std::unordered_map<GLuint, std::uint32_t> material_ids;
+    std::unordered_map<Geometry, std::uint32_t, Geometry_Hash> geometry_ids;
+
+    Render_Queue_Statistics stats;
+
+    void sort();
+
+public:
+    void submit(const Draw_Packet& packet);
+
+    // sorts and draws everything submitted since the last call, then starts over; the indirect
+    // commands are allocated from ring, which has to stay in its frame until the draws were issued
+    void execute(Gl_State& state, Gpu_Ring& ring);
+
+    std::size_t size() const { return packets.size(); }
+
+    // of the last execute()
+    const Render_Queue_Statistics& statistics() const { return stats; }
+};
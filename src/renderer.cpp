@@ -1,15 +1,33 @@
 #include "renderer.hpp"
 
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <fmt/format.h>
 
+#include "util.hpp"
 #include "constants.hpp"
+#include "gpu_object.hpp"
 
 Renderer::Renderer(GLFWwindow* glfwWindow)
 {
     m_window = glfwWindow;
 
+    m_vertex_arena = Gpu_Arena::shared(GPU_ARENA_VERTICES);
+    m_index_arena = Gpu_Arena::shared(GPU_ARENA_INDICES);
+    m_vertex_arrays = Vertex_Array_Cache::shared();
+    m_assets.reset(new Asset_Loader());
+    m_registry.reset(new Asset_Registry(*m_assets));
+    m_frame_ring.reset(new Gpu_Ring(constants::frame_ring_size));
+
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uniform_alignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_storage_alignment);
+
     m_active_scene = nullptr;
+    m_loading_scene = nullptr;
 	m_active_scene_id = SCENE_ID_NONE;
 
     m_buffer_width = constants::window_width;
@@ -20,7 +38,32 @@ Renderer::Renderer(GLFWwindow* glfwWindow)
     m_time_delta = 0;
     m_time_prev = glfwGetTime();
 
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    m_average_time = 0;
+    m_average_frames = 0;
+
+    m_object_count = 0;
+
+    m_state.clear_color(0.0f, 0.0f, 0.0f, 1.0f);
+
+    // meshes use the all-ones index of their index type to restart strips
+    m_state.enable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+}
+
+Renderer::~Renderer()
+{
+    // everything that owns GL objects goes first, then the deletion queue is drained while the
+    // context still exists
+    m_loading_scene = nullptr;
+    m_active_scene = nullptr;
+    m_registry.reset();
+    m_assets.reset();
+    m_frame_ring.reset();
+    m_instance_ring.reset();
+    m_vertex_arena = nullptr;
+    m_index_arena = nullptr;
+    m_vertex_arrays = nullptr;
+
+    gpu_objects::flush();
 }
 
 void Renderer::update()
@@ -29,6 +72,21 @@ void Renderer::update()
     m_time_delta = m_time_elapsed - m_time_prev;
     m_time_prev = m_time_elapsed;
 
+    m_statistics.frames++;
+    m_statistics.frame_time = m_time_delta;
+    m_average_time += m_time_delta;
+    m_average_frames++;
+    if (m_average_time >= 1.0)
+    {
+        m_statistics.average_frame_time = m_average_time / double(m_average_frames);
+        m_average_time = 0;
+        m_average_frames = 0;
+    }
+
+    // the ring region of the frame that used it frames_in_flight frames ago becomes writable
+    m_frame_ring->begin_frame();
+    if (m_instance_ring) m_instance_ring->begin_frame();
+
     int width, height;
     glfwGetFramebufferSize(m_window, &width, &height);
 
@@ -36,23 +94,173 @@ void Renderer::update()
     m_buffer_height = constants::window_height;
     m_aspect_ratio = float(m_buffer_width) / float(m_buffer_height);
 
+    double mouse_x, mouse_y;
+    glfwGetCursorPos(m_window, &mouse_x, &mouse_y);
+
+    m_frame_uniforms.resolution = glm::vec2(float(m_buffer_width), float(m_buffer_height));
+    m_frame_uniforms.mouse = glm::vec2(float(mouse_x), float(mouse_y));
+    m_frame_uniforms.time = float(m_time_elapsed);
+    m_frame_uniforms.time_delta = float(m_time_delta);
+
+    m_assets->update();
+
+    // compacts the arenas a little every frame, so blocks emptied by scene switches are released
+    m_vertex_arena->defragment(constants::arena_defragment_budget);
+    m_index_arena->defragment(constants::arena_defragment_budget);
+
+    if (m_loading_scene && m_loading_scene->load() == SCENE_STATE_READY)
+    {
+        m_active_scene = m_loading_scene;
+        m_loading_scene = nullptr;
+    }
+
     if (m_active_scene)
     {
         m_active_scene->update(this);
     }
 }
 
+Lod_View Renderer::lod_view(const glm::vec3& eye, float fovy, float pixel_error) const
+{
+    Lod_View view;
+    view.eye = eye;
+    view.projection_scale = float(m_buffer_height) / (2.0f * std::tan(fovy * 0.5f));
+    view.pixel_error = pixel_error;
+    return view;
+}
+
+Cull_View Renderer::cull_view() const
+{
+    Cull_View view;
+    view.view_projection = m_frame_uniforms.view_projection;
+    view.eye = glm::vec3(m_frame_uniforms.eye);
+    return view;
+}
+
+void Renderer::set_camera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye)
+{
+    m_frame_uniforms.view = view;
+    m_frame_uniforms.projection = projection;
+    m_frame_uniforms.view_projection = projection * view;
+    m_frame_uniforms.eye = glm::vec4(eye, 1.0f);
+}
+
+float Renderer::view_depth(const glm::vec3& position) const
+{
+    return -(m_frame_uniforms.view * glm::vec4(position, 1.0f)).z;
+}
+
+Object_Uniforms* Renderer::object_uniforms(GLsizei count, GLuint& first)
+{
+    // every caller gets a part of the same block, so render() binds it once and all base instances stay valid
+    if (!m_objects.data)
+    {
+        m_objects = m_frame_ring->allocate(GLsizeiptr(constants::frame_object_capacity) * GLsizeiptr(sizeof(Object_Uniforms)), m_storage_alignment);
+        m_object_count = 0;
+    }
+
+    if (count > constants::frame_object_capacity - m_object_count)
+    {
+        throw std::runtime_error(fmt::format("More than {} object records in one frame", constants::frame_object_capacity));
+    }
+
+    first = GLuint(m_object_count);
+    m_object_count += count;
+
+    Object_Uniforms* records = static_cast<Object_Uniforms*>(m_objects.data) + first;
+    std::fill(records, records + count, Object_Uniforms());
+    return records;
+}
+
+Gpu_Ring& Renderer::instance_ring()
+{
+    // instance data of a benchmark does not fit the frame ring, and most scenes never need the memory
+    if (!m_instance_ring)
+    {
+        m_instance_ring.reset(new Gpu_Ring(constants::instance_ring_size));
+        m_instance_ring->begin_frame();
+    }
+
+    return *m_instance_ring;
+}
+
+void Renderer::record(std::size_t count, const std::function<void(std::size_t job, Command_Buffer& commands)>& record)
+{
+    if (m_command_buffers.size() < count) m_command_buffers.resize(count);
+
+    m_workers.parallel_for(count, [&](std::size_t first, std::size_t last, std::size_t)
+    {
+        for (std::size_t job = first; job < last; ++job)
+        {
+            m_command_buffers[job].clear();
+            record(job, m_command_buffers[job]);
+        }
+    });
+
+    replay(m_command_buffers.data(), count);
+}
+
+void Renderer::replay(const Command_Buffer* buffers, std::size_t count)
+{
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < count; ++i) total += buffers[i].objects().size();
+
+    // each buffer takes the records after those of the previous ones
+    GLuint first = 0;
+    Object_Uniforms* records = nullptr;
+    if (total > 0) records = object_uniforms(GLsizei(total), first);
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const std::vector<Object_Uniforms>& objects = buffers[i].objects();
+        std::copy(objects.begin(), objects.end(), records);
+
+        buffers[i].replay(m_queue, first);
+        first += GLuint(objects.size());
+        records += objects.size();
+    }
+}
+
 void Renderer::render()
 {
+    // one block write and one bind per frame, however many programs read it
+    Gpu_Ring_Allocation frame = m_frame_ring->write(&m_frame_uniforms, sizeof(Frame_Uniforms), m_uniform_alignment);
+    m_state.bind_buffer_range(GL_UNIFORM_BUFFER, uniforms::frame_binding, frame.buffer, frame.offset, frame.size);
+
+    // likewise the object records of every object_uniforms() and replay() call of the frame
+    if (m_object_count > 0)
+    {
+        m_state.bind_buffer_range(GL_SHADER_STORAGE_BUFFER, uniforms::object_binding, m_objects.buffer, m_objects.offset,
+                                  GLsizeiptr(m_object_count) * GLsizeiptr(sizeof(Object_Uniforms)));
+    }
+
+    // frames start without depth test and culling; scenes that need them enable them in render()
+    m_state.disable(GL_DEPTH_TEST);
+    m_state.disable(GL_CULL_FACE);
+
     if (m_active_scene)
     {
-        m_active_scene->render();
+        m_active_scene->render(m_state);
     }
     else
     {
+        m_state.clear_color(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
     }
 
+    m_queue.execute(m_state, *m_frame_ring);
+
+    // objects released during the frame are deleted once the GPU is past it; deleted names may be
+    // handed out again, so the state cache must not assume they are still bound
+    m_frame_ring->end_frame();
+    if (m_instance_ring) m_instance_ring->end_frame();
+    m_objects = Gpu_Ring_Allocation();
+    m_object_count = 0;
+    std::size_t deleted = gpu_objects::statistics().deleted;
+    gpu_objects::end_frame();
+    if (gpu_objects::statistics().deleted != deleted) m_state.invalidate_bindings();
+    m_state.end_frame();
+
     glfwSwapBuffers(m_window);
 }
 
@@ -108,24 +316,30 @@ void Renderer::switch_scene()
 
 void Renderer::load_scene(Scene_ID id)
 {
+    // the active scene stays on screen until the new one has its assets; a scene that is still
+    // loading when another one is requested is dropped along with its pending loads
     switch (id)
     {
         default:
         case SCENE_ID_NONE:
             m_active_scene = nullptr;
-            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            m_loading_scene = nullptr;
         break;
 
         case SCENE_ID_RANDOM_COLOR:
-            m_active_scene = std::make_shared<Scene_Random_Color>();
+            m_loading_scene = std::make_shared<Scene_Random_Color>();
         break;
 
         case SCENE_ID_CURSOR_COLOR:
-            m_active_scene = std::make_shared<Scene_Cursor_Color>();
+            m_loading_scene = std::make_shared<Scene_Cursor_Color>(*m_registry);
         break;
 
         case SCENE_ID_QUADRILATERAL:
-            m_active_scene = std::make_shared<Scene_Quadrilateral>();
+            m_loading_scene = std::make_shared<Scene_Quadrilateral>(*m_registry);
+        break;
+
+        case SCENE_ID_INSTANCES:
+            m_loading_scene = std::make_shared<Scene_Instances>(*m_registry);
         break;
     }
 }
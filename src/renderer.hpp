@@ -1,18 +1,53 @@
 #pragma once
 
 #include <memory>
+#include <cstdint>
+#include <vector>
+#include <functional>
 
+#include "model.hpp"
 #include "scene.hpp"
+#include "gpu_ring.hpp"
+#include "uniforms.hpp"
+#include "worker_pool.hpp"
+#include "render_queue.hpp"
+#include "command_buffer.hpp"
 
 struct GLFWwindow;
 
+struct Renderer_Statistics
+{
+    std::uint64_t frames = 0;
+    double frame_time = 0.0;            // seconds between the last two updates
+    double average_frame_time = 0.0;    // over the last complete second
+};
+
 class Renderer
 {
 private: // fields
     GLFWwindow* m_window;
+    Gl_State m_state;                             // every state change of the frame goes through it
+    Render_Queue m_queue;                         // draws submitted by the active scene, issued in render()
+    std::vector<Command_Buffer> m_command_buffers;   // one per record() job; kept for their memory
+    Worker_Pool m_workers;                        // record() jobs; apart from the asset loader's, which may be busy parsing
+
+    std::shared_ptr<Gpu_Arena> m_vertex_arena;    // mesh data of all scenes; kept across scene switches
+    std::shared_ptr<Gpu_Arena> m_index_arena;
+    std::shared_ptr<Vertex_Array_Cache> m_vertex_arrays;  // one per vertex layout, shared by all meshes
+    std::unique_ptr<Asset_Loader> m_assets;
+    std::unique_ptr<Asset_Registry> m_registry;   // scenes share their assets through it
+    std::unique_ptr<Gpu_Ring> m_frame_ring;       // per-frame dynamic data, written between update() and the end of render()
+    std::unique_ptr<Gpu_Ring> m_instance_ring;    // per-frame instance records; created by the first instances() call
+
+    Frame_Uniforms m_frame_uniforms;
+    Gpu_Ring_Allocation m_objects;                // the frame's Objects block; taken by the first object_uniforms() call
+    GLsizei m_object_count;                       // records of it handed out so far
+    GLint m_uniform_alignment;                    // offset alignments of buffer ranges bound as blocks
+    GLint m_storage_alignment;
 
     Scene_ID m_active_scene_id;
     std::shared_ptr<Scene> m_active_scene;
+    std::shared_ptr<Scene> m_loading_scene;    // replaces the active scene once it is ready
 
     int m_buffer_width;
     int m_buffer_height;
@@ -22,8 +57,19 @@ private: // fields
     double m_time_delta;
     double m_time_prev;
 
+    Renderer_Statistics m_statistics;
+    double m_average_time;            // frame times summed since the average was last taken
+    std::uint64_t m_average_frames;
+
 public: // accessors
     GLFWwindow* window() { return m_window; }
+    Asset_Loader& assets() { return *m_assets; }
+    Asset_Registry& registry() { return *m_registry; }
+    Gpu_Arena& vertex_arena() { return *m_vertex_arena; }
+    Gpu_Arena& index_arena() { return *m_index_arena; }
+    Vertex_Array_Cache& vertex_arrays() { return *m_vertex_arrays; }
+    Gpu_Ring& frame_ring() { return *m_frame_ring; }
+    Gl_State& state() { return m_state; }     // frame_statistics() has the calls filtered last frame
 
     const int buffer_width() { return m_buffer_width; }
     const int buffer_height() { return m_buffer_height; }
@@ -33,8 +79,49 @@ public: // accessors
     const double time_delta() { return m_time_delta; }
     const double time_prev() { return m_time_prev; }
 
+    const Renderer_Statistics& statistics() const { return m_statistics; }
+
+    // camera of the frame uniforms; set by the active scene in update()
+    void set_camera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& eye);
+
+    // count consecutive records of the frame's Objects storage block, starting at record first; a draw
+    // with base instance first + i reads record i. Valid until the end of render().
+    Object_Uniforms* object_uniforms(GLsizei count, GLuint& first);
+
+    // count instance records of type Instance in this frame's part of the instance ring, filled by the
+    // caller through records; for Model::draw_instanced or Model::packet. Valid until the end of render().
+    template <typename Instance>
+    Instance_Range instances(GLsizei count, Instance*& records)
+    {
+        return Instance_Range::allocate(instance_ring(), count, records);
+    }
+
+    // queues a draw for this frame; packets are sorted by state and depth and drawn after the scene's
+    // render(), which only clears and draws what has to come first
+    void submit(const Draw_Packet& packet) { m_queue.submit(packet); }
+    const Render_Queue& queue() const { return m_queue; }
+
+    // Runs record(job, commands) for every job from 0 to count - 1 on the renderer's worker threads and
+    // the GL thread, each job into its own command buffer, then replays the buffers in job order. Jobs
+    // must not make GL calls or change the renderer; reading it (view_depth(), frame data set before the
+    // call) and writing instance records allocated beforehand is fine. From update(), on the GL thread.
+    void record(std::size_t count, const std::function<void(std::size_t job, Command_Buffer& commands)>& record);
+
+    // submits command buffers in order; their object records are copied into the frame's Objects block
+    void replay(const Command_Buffer* buffers, std::size_t count);
+
+    // distance in front of the camera set with set_camera(), as Draw_Packet::depth
+    float view_depth(const glm::vec3& position) const;
+
+    // level of detail selection for a perspective camera at eye with vertical field of view fovy (radians)
+    Lod_View lod_view(const glm::vec3& eye, float fovy, float pixel_error = 1.0f) const;
+
+    // meshlet culling against the camera set with set_camera()
+    Cull_View cull_view() const;
+
 public: // functions
     Renderer(GLFWwindow*);
+    ~Renderer();
 
     void update();
     void render();
@@ -47,4 +134,5 @@ private: // functions
     void switch_scene();
     void load_scene(Scene_ID id);
     void reset_scene();
+    Gpu_Ring& instance_ring();
 };
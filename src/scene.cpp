@@ -1,12 +1,15 @@
 #include "scene.hpp"
 
+#include <cmath>
 #include <chrono>
 #include <random>
 #include <vector>
+#include <cstring>
 #include <iostream>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "mesh.hpp"
@@ -14,6 +17,7 @@
 #include "shader.hpp"
 #include "vertex.hpp"
 #include "renderer.hpp"
+#include "constants.hpp"
 
 Scene_Random_Color::Scene_Random_Color() : Scene()
 {
@@ -26,7 +30,7 @@ void Scene_Random_Color::random_clear_color()
     static std::mt19937 mt(time(0)); // mersenne twister generator engine seeded with time
     static std::uniform_real_distribution<float> distr(0.0f, 1.0f); // random distribution
 
-    glClearColor(distr(mt), distr(mt), distr(mt), 1.0f);
+    clear_color = glm::vec4(distr(mt), distr(mt), distr(mt), 1.0f);
 }
 
 void Scene_Random_Color::update(Renderer* renderer)
@@ -38,17 +42,16 @@ void Scene_Random_Color::update(Renderer* renderer)
     }
 }
 
-void Scene_Random_Color::render()
+void Scene_Random_Color::render(Gl_State& state)
 {
+    state.clear_color(clear_color.r, clear_color.g, clear_color.b, clear_color.a);
     glClear(GL_COLOR_BUFFER_BIT);
 }
 
 
-Scene_Cursor_Color::Scene_Cursor_Color() : Scene()
+Scene_Cursor_Color::Scene_Cursor_Color(Asset_Registry& assets) : Scene()
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-    std::vector<Vertex> vertices =
+    std::vector<Vertex_Position2> vertices =
     {
         Vertex_Position2({-1.0f,  1.0f}),
         Vertex_Position2({ 1.0f,  1.0f}),
@@ -59,40 +62,47 @@ Scene_Cursor_Color::Scene_Cursor_Color() : Scene()
         Vertex_Position2({-1.0f, -1.0f})
     };
 
-    mesh = std::make_shared<Mesh>(vertices, GL_TRIANGLES, GL_STATIC_DRAW);
-    shader = std::make_shared<Shader>("shaders/scene_cursor_color.vs.glsl", "shaders/scene_cursor_color.fs.glsl");
+    // registered by name, so switching back to the scene finds the uploaded quad
+    mesh_asset = assets.mesh("cursor_color_quad", [vertices]() { return Mesh_Data::from_vertices(vertices); });
+    shader_asset = assets.shader("shaders/scene_cursor_color.vs.glsl", "shaders/scene_cursor_color.fs.glsl");
+}
+
+Scene_State Scene_Cursor_Color::load()
+{
+    if (!mesh_asset->ready() || !shader_asset->ready())
+    {
+        return SCENE_STATE_LOADING;
+    }
+
+    mesh = mesh_asset->value;
+    shader = shader_asset->value;
     model = std::make_shared<Model>(mesh, shader);
 
-    uniloc_mouse = glGetUniformLocation(*shader, "mouse");
-    uniloc_resolution = glGetUniformLocation(*shader, "resolution");
+    return SCENE_STATE_READY;
 }
 
 void Scene_Cursor_Color::update(Renderer* renderer)
 {
-    width = renderer->buffer_width();
-    height = renderer->buffer_height();
-    glfwGetCursorPos(renderer->window(), &mouse_x, &mouse_y);
+    // resolution and mouse come with the renderer's frame uniforms
+    renderer->submit(model->packet());
 }
 
-void Scene_Cursor_Color::render()
+void Scene_Cursor_Color::render(Gl_State& state)
 {
+    state.clear_color(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
-
-    glUseProgram(*shader);
-    glBindVertexArray(*model);
-
-    glUniform2f(uniloc_mouse, float(mouse_x), float(mouse_y));
-    glUniform2f(uniloc_resolution, float(width), float(height));
-
-    glDrawArrays(model->topology, 0, model->index_count);
 }
 
 
-Scene_Quadrilateral::Scene_Quadrilateral() : Scene()
+Scene_Quadrilateral::Scene_Quadrilateral(Asset_Registry& assets) : Scene()
 {
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    std::vector<GLuint> indices =
+    {
+        0, 1, 2,
+        2, 3, 0
+    };
 
-    std::vector<Vertex> vertices =
+    std::vector<Vertex_Position2_Texcoord_Color> vertices =
     {
         Vertex_Position2_Texcoord_Color({-0.5f,  0.5f}, {0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}),
         Vertex_Position2_Texcoord_Color({ 0.5f,  0.5f}, {1.0f, 0.0f}, {0.0f, 1.0f, 0.0f}),
@@ -100,19 +110,23 @@ Scene_Quadrilateral::Scene_Quadrilateral() : Scene()
         Vertex_Position2_Texcoord_Color({-0.5f, -0.5f}, {0.0f, 1.0f}, {1.0f, 1.0f, 1.0f})
     };
 
-    std::vector<GLuint> indices =
+    mesh_asset = assets.mesh("quadrilateral", [vertices, indices]() { return Mesh_Data::from_vertices(vertices, indices); });
+
+    shader_asset = assets.shader("shaders/scene_quadrilateral.vs.glsl", "shaders/scene_quadrilateral.fs.glsl");
+}
+
+Scene_State Scene_Quadrilateral::load()
+{
+    if (!mesh_asset->ready() || !shader_asset->ready())
     {
-        0, 1, 2,
-        2, 3, 0
-    };
+        return SCENE_STATE_LOADING;
+    }
 
-    mesh = std::make_shared<Mesh>(vertices, indices, GL_TRIANGLES, GL_STATIC_DRAW);
-    shader = std::make_shared<Shader>("shaders/scene_quadrilateral.vs.glsl", "shaders/scene_quadrilateral.fs.glsl");
+    mesh = mesh_asset->value;
+    shader = shader_asset->value;
     model = std::make_shared<Model>(mesh, shader);
 
-    uniloc_model = glGetUniformLocation(*shader, "model");
-    uniloc_view = glGetUniformLocation(*shader, "view");
-    uniloc_projection = glGetUniformLocation(*shader, "projection");
+    return SCENE_STATE_READY;
 }
 
 void Scene_Quadrilateral::update(Renderer* renderer)
@@ -124,25 +138,138 @@ void Scene_Quadrilateral::update(Renderer* renderer)
     mat_model = glm::scale(glm::rotate(glm::mat4(1.0f), -angle, glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(scale));
     mat_view = glm::lookAt(glm::vec3(0.0f, 0.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
     mat_projection = glm::perspective(glm::radians(45.0f), aspect_ratio, 0.1f, 10.0f);
+
+    renderer->set_camera(mat_view, mat_projection, glm::vec3(0.0f, 0.0f, 2.0f));
+    // matrices come from the frame uniforms and the object records packets() fills
+    GLuint first_object;
+    Object_Uniforms* objects = renderer->object_uniforms(model->object_count(), first_object);
+
+    Lod_View lod = renderer->lod_view(glm::vec3(0.0f, 0.0f, 2.0f), glm::radians(45.0f));
+    Cull_View cull = renderer->cull_view();
+    float depth = renderer->view_depth(glm::vec3(mat_model[3]));
+
+    packets.clear();
+    model->packets(packets, mat_model, objects, first_object, &lod, &cull);
+    for (Draw_Packet& visible : packets)
+    {
+        visible.depth = depth;
+        renderer->submit(visible);
+    }
 }
 
-void Scene_Quadrilateral::render()
+void Scene_Quadrilateral::render(Gl_State& state)
 {
+    state.clear_color(0.0f, 0.0f, 0.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void Scene_Quadrilateral::reset()
+{
+    scale = 0;
+    angle = 0;
+}
+
+
+Scene_Instances::Scene_Instances(Asset_Registry& assets) : Scene()
+{
+    mesh_asset = assets.obj("models/box/box.obj");
+    shader_asset = assets.shader("shaders/scene_instances.vs.glsl", "shaders/scene_instances.fs.glsl");
 
-    glUseProgram(*shader);
-    glBindVertexArray(*model);
+    // the boxes are 2 units wide; one unit of space between neighbours
+    const int side = int(std::ceil(std::cbrt(double(constants::instance_benchmark_count))));
+    const float spacing = 3.0f;
+    const float center = 0.5f * spacing * float(side - 1);
 
-    // update matrices
-    glUniformMatrix4fv(uniloc_model, 1, GL_FALSE, glm::value_ptr(mat_model));
-    glUniformMatrix4fv(uniloc_view, 1, GL_FALSE, glm::value_ptr(mat_view));
-    glUniformMatrix4fv(uniloc_projection, 1, GL_FALSE, glm::value_ptr(mat_projection));
+    grid.reserve(constants::instance_benchmark_count);
+    for (int i = 0; i < constants::instance_benchmark_count; ++i)
+    {
+        int x = i % side;
+        int y = i / (side * side);
+        int z = (i / side) % side;
+
+        float r = float(x) / float(side - 1);
+        float g = float(y) / float(side - 1);
+        float b = float(z) / float(side - 1);
+
+        grid.push_back(Instance_Transform_Color(
+            {{ float(x) * spacing - center, float(y) * spacing - center, float(z) * spacing - center, 1.0f }},
+            {{ 0.0f, 0.0f, 0.0f, 1.0f }},
+            {{ r, g, b, 1.0f }}));
+    }
 
-    glDrawElements(model->topology, model->index_count, model->index_type, 0);
+    reset();
 }
 
-void Scene_Quadrilateral::reset()
+Scene_State Scene_Instances::load()
+{
+    if (!mesh_asset->ready() || !shader_asset->ready())
+    {
+        return SCENE_STATE_LOADING;
+    }
+
+    mesh = mesh_asset->value;
+    shader = shader_asset->value;
+    model = std::make_shared<Model>(mesh, shader);
+
+    return SCENE_STATE_READY;
+}
+
+void Scene_Instances::update(Renderer* renderer)
+{
+    angle += renderer->time_delta() * 0.25f;
+
+    // camera circling the grid from just outside of it
+    const float distance = 400.0f;
+    glm::vec3 eye(distance * std::sin(angle * 0.2f), distance * 0.5f, distance * std::cos(angle * 0.2f));
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), renderer->aspect_ratio(), 1.0f, 2000.0f);
+    renderer->set_camera(view, projection, eye);
+
+    // every record is rewritten; the ring is only allocated from here, the layers fill their part of it
+    // and record their draw on worker threads
+    Instance_Transform_Color* records;
+    Instance_Range instances = renderer->instances(GLsizei(grid.size()), records);
+
+    const std::size_t side = std::size_t(std::ceil(std::cbrt(double(grid.size()))));
+    const std::size_t layer_size = side * side;
+    const std::size_t layers = (grid.size() + layer_size - 1) / layer_size;
+
+    renderer->record(layers, [&](std::size_t layer, Command_Buffer& commands)
+    {
+        std::size_t first = layer * layer_size;
+        std::size_t count = std::min(layer_size, grid.size() - first);
+        std::memcpy(records + first, grid.data() + first, count * sizeof(Instance_Transform_Color));
+
+        // the layers spin in alternating directions
+        float turn = (layer % 2 ? -angle : angle) * (1.0f + float(layer) / float(side));
+        glm::quat rotation = glm::angleAxis(turn, glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f)));
+        Attrib_Instance_Rotation::value_type value = {{ rotation.x, rotation.y, rotation.z, rotation.w }};
+
+        for (std::size_t i = first; i < first + count; ++i)
+        {
+            records[i].store<1>(value);
+        }
+
+        Instance_Range chunk = instances;
+        chunk.first += GLuint(first);
+        chunk.count = GLsizei(count);
+
+        // front to back by the layer's center
+        Draw_Packet packet = model->packet(chunk);
+        packet.depth = renderer->view_depth(glm::vec3(0.0f, grid[first].get<0>()[1], 0.0f));
+        commands.draw(packet);
+    });
+}
+
+void Scene_Instances::render(Gl_State& state)
+{
+    state.enable(GL_DEPTH_TEST);
+    state.enable(GL_CULL_FACE);
+    state.clear_color(0.05f, 0.05f, 0.08f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void Scene_Instances::reset()
 {
-    scale = 0;
     angle = 0;
 }
@@ -1,26 +1,47 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include <glm/glm.hpp>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "vertex.hpp"
+#include "gl_state.hpp"
+#include "render_queue.hpp"
+#include "asset_registry.hpp"
+
 class Mesh;
 class Model;
 class Shader;
 class Renderer;
 struct GLFWwindow;
 
+enum Scene_State
+{
+    SCENE_STATE_LOADING,
+    SCENE_STATE_READY
+};
+
 class Scene
 {
 public:
     Scene() = default;
     virtual ~Scene() = default;
 
+    // Polled by the renderer every frame after construction until the scene is ready; the previous scene
+    // keeps being shown meanwhile. Scenes request their assets in the constructor and finish setting up
+    // here once they arrived.
+    virtual Scene_State load() { return SCENE_STATE_READY; }
+
+    // draws are submitted to the renderer's queue here
     virtual void update(Renderer* renderer) = 0;
-    virtual void render() = 0;
+
+    // draws that have to precede the queued ones (clears, backgrounds); all state changes go through
+    // state, which drops the redundant ones
+    virtual void render(Gl_State& state) = 0;
     virtual void reset() {};
 
     virtual void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {};
@@ -32,31 +53,30 @@ class Scene_Random_Color : public Scene
 {
 private:
     double timer;
+    glm::vec4 clear_color;
     void random_clear_color();
 
 public:
     Scene_Random_Color();
     virtual void update(Renderer* renderer) override;
-    virtual void render() override;
+    virtual void render(Gl_State& state) override;
 };
 
 class Scene_Cursor_Color : public Scene
 {
 private:
-    int width, height;
-    double mouse_x, mouse_y;
+    std::shared_ptr<Asset<Mesh>> mesh_asset;
+    std::shared_ptr<Asset<Shader>> shader_asset;
 
-    GLint uniloc_mouse;
-    GLint uniloc_resolution;
-    
     std::shared_ptr<Mesh> mesh;
     std::shared_ptr<Model> model;
     std::shared_ptr<Shader> shader;
 
 public:
-    Scene_Cursor_Color();
+    Scene_Cursor_Color(Asset_Registry& assets);
+    virtual Scene_State load() override;
     virtual void update(Renderer* renderer) override;
-    virtual void render() override;
+    virtual void render(Gl_State& state) override;
 };
 
 class Scene_Quadrilateral : public Scene
@@ -69,18 +89,46 @@ private:
     glm::mat4 mat_view;
     glm::mat4 mat_projection;
 
-    GLint uniloc_model;
-    GLint uniloc_view;
-    GLint uniloc_projection;
+    std::shared_ptr<Asset<Mesh>> mesh_asset;
+    std::shared_ptr<Asset<Shader>> shader_asset;
+
+    std::shared_ptr<Mesh> mesh;
+    std::shared_ptr<Model> model;
+    std::shared_ptr<Shader> shader;
+
+    std::vector<Draw_Packet> packets; // reused from frame to frame
+
+public:
+    Scene_Quadrilateral(Asset_Registry& assets);
+    virtual Scene_State load() override;
+    virtual void update(Renderer* renderer) override;
+    virtual void render(Gl_State& state) override;
+    virtual void reset() override;
+};
+
+// Instancing stress benchmark: constants::instance_benchmark_count boxes in a cube grid. Every frame
+// each layer rewrites its instance records and records its instanced draw on a worker thread (each
+// layer spins on its own); the queue joins the layers into one multi-draw. Frame times are in the
+// renderer's statistics.
+class Scene_Instances : public Scene
+{
+private:
+    float angle;
+
+    std::vector<Instance_Transform_Color> grid;    // records at rest; copied to the ring every frame
+
+    std::shared_ptr<Asset<Mesh>> mesh_asset;
+    std::shared_ptr<Asset<Shader>> shader_asset;
 
     std::shared_ptr<Mesh> mesh;
     std::shared_ptr<Model> model;
     std::shared_ptr<Shader> shader;
 
 public:
-    Scene_Quadrilateral();
+    Scene_Instances(Asset_Registry& assets);
+    virtual Scene_State load() override;
     virtual void update(Renderer* renderer) override;
-    virtual void render() override;
+    virtual void render(Gl_State& state) override;
     virtual void reset() override;
 };
 
@@ -90,5 +138,6 @@ enum Scene_ID
     SCENE_ID_RANDOM_COLOR,
     SCENE_ID_CURSOR_COLOR,
     SCENE_ID_QUADRILATERAL,
+    SCENE_ID_INSTANCES,
     SCENE_ID_COUNT
 };
@@ -2,13 +2,18 @@
 
 #include <fmt/format.h>
 #include "util.hpp"
+#include "vertex.hpp"
 
 Vertex_Shader::Vertex_Shader(const std::string& vs_file)
+: Vertex_Shader(vs_file, util::file_as_string(vs_file))
 {
-    std::string contents = util::file_as_string(vs_file);
-    const char* c_contents = contents.c_str();
+}
+
+Vertex_Shader::Vertex_Shader(const std::string& vs_file, const std::string& source)
+{
+    const char* c_contents = source.c_str();
 
-    shader = glCreateShader(GL_VERTEX_SHADER);
+    shader = Gpu_Shader::create(GL_VERTEX_SHADER);
     glShaderSource(shader, 1, &c_contents, NULL);
     glCompileShader(shader);
 
@@ -20,7 +25,7 @@ Vertex_Shader::Vertex_Shader(const std::string& vs_file)
         GLint info_log_len;
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_len);
 
-        std::string info_log_str;
+        std::string info_log_str(std::size_t(info_log_len), '\0');
         glGetShaderInfoLog(shader, info_log_len, nullptr, &info_log_str[0]);
 
         std::string msg = fmt::format("Vertex shader compilation error in \"{}\": {}", vs_file, info_log_str);
@@ -29,11 +34,15 @@ Vertex_Shader::Vertex_Shader(const std::string& vs_file)
 }
 
 Fragment_Shader::Fragment_Shader(const std::string& fs_file)
+: Fragment_Shader(fs_file, util::file_as_string(fs_file))
+{
+}
+
+Fragment_Shader::Fragment_Shader(const std::string& fs_file, const std::string& source)
 {
-    std::string contents = util::file_as_string(fs_file);
-    const char* c_contents = contents.c_str();
+    const char* c_contents = source.c_str();
 
-    shader = glCreateShader(GL_FRAGMENT_SHADER);
+    shader = Gpu_Shader::create(GL_FRAGMENT_SHADER);
     glShaderSource(shader, 1, &c_contents, NULL);
     glCompileShader(shader);
 
@@ -45,7 +54,7 @@ Fragment_Shader::Fragment_Shader(const std::string& fs_file)
         GLint info_log_len;
         glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_len);
 
-        std::string info_log_str;
+        std::string info_log_str(std::size_t(info_log_len), '\0');
         glGetShaderInfoLog(shader, info_log_len, nullptr, &info_log_str[0]);
 
         std::string msg = fmt::format("Fragment shader compilation error in \"{}\": {}", fs_file, info_log_str);
@@ -55,7 +64,7 @@ Fragment_Shader::Fragment_Shader(const std::string& fs_file)
 
 Shader::Shader(Vertex_Shader& vs, Fragment_Shader& fs)
 {
-    program = glCreateProgram();
+    program = Gpu_Program::create();
 
     glAttachShader(program, vs);
     glAttachShader(program, fs);
@@ -70,8 +79,8 @@ Shader::Shader(Vertex_Shader& vs, Fragment_Shader& fs)
         GLint info_log_len;
         glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_len);
 
-        std::string info_log_str;
-        glGetShaderInfoLog(program, info_log_len, nullptr, &info_log_str[0]);
+        std::string info_log_str(std::size_t(info_log_len), '\0');
+        glGetProgramInfoLog(program, info_log_len, nullptr, &info_log_str[0]);
 
         std::string msg = fmt::format("Shader program linker error: {}", info_log_str);
         throw std::runtime_error(msg.c_str());
@@ -79,6 +88,8 @@ Shader::Shader(Vertex_Shader& vs, Fragment_Shader& fs)
 
     glDetachShader(program, vs);
     glDetachShader(program, fs);
+
+    reflect();
 }
 
 Shader::Shader(const std::string& vs_file, const std::string& fs_file)
@@ -86,7 +97,7 @@ Shader::Shader(const std::string& vs_file, const std::string& fs_file)
     Vertex_Shader vs(vs_file);
     Fragment_Shader fs(fs_file);
 
-    program = glCreateProgram();
+    program = Gpu_Program::create();
 
     glAttachShader(program, vs);
     glAttachShader(program, fs);
@@ -101,13 +112,133 @@ Shader::Shader(const std::string& vs_file, const std::string& fs_file)
         GLint info_log_len;
         glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_len);
 
-        std::string info_log_str;
+        std::string info_log_str(std::size_t(info_log_len), '\0');
         glGetProgramInfoLog(program, info_log_len, nullptr, &info_log_str[0]);
 
         std::string msg = fmt::format("Shader program linker failure: {}", info_log_str);
-        throw std::runtime_error(info_log_str.c_str());
+        throw std::runtime_error(msg.c_str());
     }
 
     glDetachShader(program, vs);
     glDetachShader(program, fs);
+
+    reflect();
+}
+
+void Shader::reflect()
+{
+    std::vector<GLchar> name;
+
+    auto resource_name = [&](GLenum interface, GLint index, GLint length) -> std::string
+    {
+        name.resize(std::size_t(length) + 1);
+        glGetProgramResourceName(program, interface, index, GLsizei(name.size()), nullptr, name.data());
+        return std::string(name.data());
+    };
+
+    // arrays are reported as "name[0]"; make them reachable by their bare name as well
+    auto insert = [](std::unordered_map<std::string, Shader_Variable>& table, const std::string& key, const Shader_Variable& variable)
+    {
+        table[key] = variable;
+
+        std::size_t bracket = key.find("[0]");
+        if (bracket != std::string::npos && bracket + 3 == key.size())
+        {
+            table[key.substr(0, bracket)] = variable;
+        }
+    };
+
+    // vertex inputs
+    GLint input_count = 0;
+    glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &input_count);
+
+    for (GLint i = 0; i < input_count; ++i)
+    {
+        const GLenum props[] = { GL_NAME_LENGTH, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+        GLint values[4];
+        glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 4, props, 4, nullptr, values);
+
+        if (values[1] < 0) continue; // built-in inputs such as gl_VertexID
+        insert(attributes, resource_name(GL_PROGRAM_INPUT, i, values[0]), { values[1], GLenum(values[2]), values[3], -1 });
+    }
+
+    // default block uniforms
+    GLint uniform_count = 0;
+    glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniform_count);
+
+    for (GLint i = 0; i < uniform_count; ++i)
+    {
+        const GLenum props[] = { GL_NAME_LENGTH, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE, GL_BLOCK_INDEX };
+        GLint values[5];
+        glGetProgramResourceiv(program, GL_UNIFORM, i, 5, props, 5, nullptr, values);
+
+        if (values[4] != -1) continue; // members of uniform blocks have no location
+        insert(uniforms, resource_name(GL_UNIFORM, i, values[0]), { values[1], GLenum(values[2]), values[3], -1 });
+    }
+
+    // uniform blocks
+    GLint block_count = 0;
+    glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &block_count);
+
+    for (GLint i = 0; i < block_count; ++i)
+    {
+        const GLenum props[] = { GL_NAME_LENGTH, GL_BUFFER_DATA_SIZE, GL_BUFFER_BINDING };
+        GLint values[3];
+        glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, i, 3, props, 3, nullptr, values);
+
+        insert(uniform_blocks, resource_name(GL_UNIFORM_BLOCK, i, values[0]), { i, GL_UNIFORM_BLOCK, values[1], values[2] });
+    }
+}
+
+const Shader_Variable* Shader::find_attribute(const std::string& name) const
+{
+    auto it = attributes.find(name);
+    return (it != attributes.end()) ? &it->second : nullptr;
+}
+
+const Shader_Variable* Shader::find_uniform(const std::string& name) const
+{
+    auto it = uniforms.find(name);
+    return (it != uniforms.end()) ? &it->second : nullptr;
+}
+
+const Shader_Variable* Shader::find_uniform_block(const std::string& name) const
+{
+    auto it = uniform_blocks.find(name);
+    return (it != uniform_blocks.end()) ? &it->second : nullptr;
+}
+
+GLint Shader::attrib_location(const std::string& name) const
+{
+    const Shader_Variable* variable = find_attribute(name);
+    return variable ? variable->location : -1;
+}
+
+GLint Shader::uniform_location(const std::string& name) const
+{
+    const Shader_Variable* variable = find_uniform(name);
+    return variable ? variable->location : -1;
+}
+
+GLint Shader::uniform_block_index(const std::string& name) const
+{
+    const Shader_Variable* variable = find_uniform_block(name);
+    return variable ? variable->location : -1;
+}
+
+const std::vector<GLint>& Shader::attrib_locations(const Vertex_Format& format)
+{
+    auto it = layout_locations.find(format.attribs);
+    if (it != layout_locations.end())
+    {
+        return it->second;
+    }
+
+    std::vector<GLint> locations(format.attrib_count);
+    for (GLuint i = 0; i < format.attrib_count; ++i)
+    {
+        locations[i] = attrib_location(format.attribs[i].name);
+    }
+
+    return layout_locations.emplace(format.attribs, std::move(locations)).first->second;
 }
@@ -1,14 +1,18 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <unordered_map>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "gpu_object.hpp"
+
 class Base_Shader
 {
 protected:
-	GLuint shader;
+	Gpu_Shader shader;
 
 public:
 	virtual operator GLuint()
@@ -21,23 +25,57 @@ class Vertex_Shader : public Base_Shader
 {
 public:
 	Vertex_Shader(const std::string& vs_file);
+	Vertex_Shader(const std::string& vs_file, const std::string& source);	// source already read
 };
 
 class Fragment_Shader : public Base_Shader
 {
 public:
 	Fragment_Shader(const std::string& fs_file);
+	Fragment_Shader(const std::string& fs_file, const std::string& source);	// source already read
+};
+
+struct Vertex_Format;
+
+struct Shader_Variable
+{
+	GLint location;		// attribute or uniform location; block index for uniform blocks
+	GLenum type;		// e.g. GL_FLOAT_VEC2, GL_FLOAT_MAT4; GL_UNIFORM_BLOCK for blocks
+	GLint size;			// array size; buffer data size in bytes for blocks
+	GLint binding;		// buffer binding point (uniform blocks only)
 };
 
 class Shader
 {
 private:
-	GLuint program;
+	Gpu_Program program;
+
+	// active program resources, reflected once after linking
+	std::unordered_map<std::string, Shader_Variable> attributes;
+	std::unordered_map<std::string, Shader_Variable> uniforms;
+	std::unordered_map<std::string, Shader_Variable> uniform_blocks;
+
+	// attribute locations resolved per vertex layout, keyed by the layout's static attribute table
+	std::unordered_map<const void*, std::vector<GLint>> layout_locations;
+
+	void reflect();
 
 public:
 	Shader(Vertex_Shader& vs, Fragment_Shader& fs);
 	Shader(const std::string& vs_file, const std::string& fs_file);
 
+	// -1 when the program has no active resource with this name
+	GLint attrib_location(const std::string& name) const;
+	GLint uniform_location(const std::string& name) const;
+	GLint uniform_block_index(const std::string& name) const;
+
+	const Shader_Variable* find_attribute(const std::string& name) const;
+	const Shader_Variable* find_uniform(const std::string& name) const;
+	const Shader_Variable* find_uniform_block(const std::string& name) const;
+
+	// locations of the format's attributes in this program (-1 for inputs the program does not use)
+	const std::vector<GLint>& attrib_locations(const Vertex_Format& format);
+
 	operator GLuint()
 	{
 		return program;
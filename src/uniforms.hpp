@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// C++ mirrors of the blocks the shaders declare. Members are ordered so std140 (Frame) and std430
+// (Objects) place them where the compiler does here: matrices and vec4 first, then vec2 pairs, scalars
+// last, with the size padded to a multiple of 16 bytes. Shaders have to declare the blocks with the
+// same members in the same order.
+namespace uniforms
+{
+    const GLuint frame_binding = 0;     // layout(std140, binding = 0) uniform Frame
+    const GLuint object_binding = 0;    // layout(std430, binding = 0) readonly buffer Objects (storage block binding)
+}
+
+// per frame, written by the Renderer
+struct Frame_Uniforms
+{
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    glm::vec4 eye = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    glm::vec2 resolution = glm::vec2(1.0f);
+    glm::vec2 mouse = glm::vec2(0.0f);     // cursor position in window coordinates
+    GLfloat time = 0.0f;
+    GLfloat time_delta = 0.0f;
+    GLfloat padding[2] = { 0.0f, 0.0f };
+};
+
+// per drawn object; a draw reads objects[gl_BaseInstanceARB + gl_InstanceID]
+struct Object_Uniforms
+{
+    glm::mat4 model = glm::mat4(1.0f);
+};
+
+static_assert(offsetof(Frame_Uniforms, eye) == 192 && offsetof(Frame_Uniforms, resolution) == 208 &&
+              offsetof(Frame_Uniforms, time) == 224 && sizeof(Frame_Uniforms) == 240, "Frame_Uniforms does not match the std140 layout");
+static_assert(sizeof(Object_Uniforms) % 16 == 0, "Object_Uniforms does not match the std430 array stride");
@@ -1,12 +1,19 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 #include <fstream>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
 
 namespace util
 {
-    const std::string file_as_string(const std::string& filename)
+    inline const std::string file_as_string(const std::string& filename)
     {
         std::ifstream file(filename);
 
@@ -24,4 +31,109 @@ namespace util
         file.read(&buffer[0], size);
         return buffer;
     }
+
+    inline std::size_t worker_count()
+    {
+        return std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    // Splits [0, count) into one contiguous range per worker and runs function(begin, end, worker)
+    // on each, the calling thread taking the first range. Exceptions are rethrown on the caller.
+    template <typename Function>
+    void parallel_for(std::size_t count, Function function, std::size_t min_range = 1)
+    {
+        std::size_t workers = std::min(worker_count(), std::max<std::size_t>(1, count / std::max<std::size_t>(1, min_range)));
+        std::size_t range = (count + workers - 1) / std::max<std::size_t>(1, workers);
+
+        std::vector<std::thread> threads;
+        std::vector<std::exception_ptr> errors(workers);
+
+        for (std::size_t w = 1; w < workers; ++w)
+        {
+            std::size_t begin = std::min(count, w * range), end = std::min(count, begin + range);
+            threads.emplace_back([&, w, begin, end]()
+            {
+                try { function(begin, end, w); }
+                catch (...) { errors[w] = std::current_exception(); }
+            });
+        }
+
+        try { function(0, std::min(count, range), 0); }
+        catch (...) { errors[0] = std::current_exception(); }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        for (std::exception_ptr& error : errors)
+        {
+            if (error) std::rethrow_exception(error);
+        }
+    }
+
+    // 64-bit content hash, xxHash64 (same values as the reference implementation); not cryptographic
+    inline std::uint64_t hash_bytes(const void* data, std::size_t size, std::uint64_t seed = 0)
+    {
+        const std::uint64_t prime1 = 0x9e3779b185ebca87ull;
+        const std::uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+        const std::uint64_t prime3 = 0x165667b19e3779f9ull;
+        const std::uint64_t prime4 = 0x85ebca77c2b2ae63ull;
+        const std::uint64_t prime5 = 0x27d4eb2f165667c5ull;
+
+        auto rotl = [](std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+        auto round = [&](std::uint64_t acc, std::uint64_t lane) { return rotl(acc + lane * prime2, 31) * prime1; };
+        auto merge = [&](std::uint64_t acc, std::uint64_t lane) { return (acc ^ round(0, lane)) * prime1 + prime4; };
+        auto read64 = [](const unsigned char* p) { std::uint64_t v; std::memcpy(&v, p, 8); return v; };
+        auto read32 = [](const unsigned char* p) { std::uint32_t v; std::memcpy(&v, p, 4); return std::uint64_t(v); };
+
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        const unsigned char* end = p + size;
+        std::uint64_t h;
+
+        if (size >= 32)
+        {
+            std::uint64_t v1 = seed + prime1 + prime2, v2 = seed + prime2, v3 = seed, v4 = seed - prime1;
+
+            for (; p + 32 <= end; p += 32)
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+        }
+        else
+        {
+            h = seed + prime5;
+        }
+
+        h += std::uint64_t(size);
+
+        for (; p + 8 <= end; p += 8)
+        {
+            h = rotl(h ^ round(0, read64(p)), 27) * prime1 + prime4;
+        }
+
+        if (p + 4 <= end)
+        {
+            h = rotl(h ^ (read32(p) * prime1), 23) * prime2 + prime3;
+            p += 4;
+        }
+
+        for (; p < end; ++p)
+        {
+            h = rotl(h ^ (*p * prime5), 11) * prime1;
+        }
+
+        h ^= h >> 33;
+        h *= prime2;
+        h ^= h >> 29;
+        h *= prime3;
+        h ^= h >> 32;
+        return h;
+    }
 }
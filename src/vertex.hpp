@@ -1,30 +1,16 @@
 #pragma once
 
 #include <array>
-#include <vector>
-#include <iterator>
-#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <type_traits>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
-class Shader;
-
-enum Vertex_Type
-{
-    VERTEX_TYPE_UNDEFINED,
-
-    VERTEX_TYPE_POSITION2,
-    VERTEX_TYPE_POSITION2_COLOR,
-    VERTEX_TYPE_POSITION2_TEXCOORD,
-    VERTEX_TYPE_POSITION2_TEXCOORD_COLOR,
-
-    VERTEX_TYPE_POSITION,
-    VERTEX_TYPE_POSITION_COLOR,
-    VERTEX_TYPE_POSITION_TEXCOORD,
-    VERTEX_TYPE_POSITION_NORMAL,
-    VERTEX_TYPE_POSITION_NORMAL_TEXCOORD
-};
+#include "vertex_encode.hpp"
 
 struct Vertex_Attrib
 {
@@ -32,439 +18,311 @@ struct Vertex_Attrib
     GLint size;             // 1, 2, 3, 4 or GL_BGRA
     GLenum type;            // e.g. GL_BYTE, GL_SHORT, GL_INT, GL_FLOAT, GL_DOUBLE
     GLboolean normalized;   // GL_TRUE or GL_FALSE
-    GLsizei stride;
-    GLsizei offset;         // offset to the first component of this vertex attribute
+    GLsizei offset;         // offset in bytes to the first component of this vertex attribute
+    const char* name;       // name of the matching vertex shader input
 };
 
-struct Vertex
+struct Vertex_Format
 {
-    Vertex_Type type = VERTEX_TYPE_UNDEFINED;
-    std::vector<GLfloat> data = std::vector<GLfloat>();
-    std::vector<Vertex_Attrib> attribs = std::vector<Vertex_Attrib>();
+    GLsizei stride;                 // size of one vertex in bytes
+    GLuint attrib_count;
+    const Vertex_Attrib* attribs;
+};
 
-    static std::vector<GLfloat> assemble(const std::vector<Vertex>& vertices)
-    {
-        if (vertices.size() < 2)
-        {
-            throw std::runtime_error("Need at least two vertices for assembly");
-        }
+// Vertex components; each describes one attribute of a vertex layout. Count is the number of stored
+// values of type T, Size the component count reported to GL (differs for packed types).
+template <typename T, GLint Count, GLenum Type, GLboolean Normalized = GL_FALSE, GLint Size = Count>
+struct Vertex_Component
+{
+    typedef std::array<T, Count> value_type;   // stored representation
+    typedef value_type input_type;              // what vertex constructors accept
 
-        Vertex_Type type = vertices.front().type;
-        if (type == VERTEX_TYPE_UNDEFINED)
-        {
-            throw std::runtime_error("Cannot assemble vertices with unknown type");
-        }
+    static constexpr GLint size = Size;
+    static constexpr GLenum type = Type;
+    static constexpr GLboolean normalized = Normalized;
+    static constexpr GLsizei bytes = (sizeof(value_type) + 3) & ~3; // keep every attribute 4-byte aligned
 
-        std::vector<GLfloat> data;
-        for (const Vertex& vertex : vertices)
-        {
-            if (vertex.type != type)
-            {
-                throw std::runtime_error("All vertex types must correspond");
-            }
+    static void encode(const input_type& in, value_type& out)
+    {
+        out = in;
+    }
+};
 
-            data.insert(data.end(), vertex.data.begin(), vertex.data.end());
-        }
+struct Attrib_Position2 : public Vertex_Component<GLfloat, 2, GL_FLOAT>
+{
+    static constexpr const char* name() { return "position"; }
+};
 
-        return data;
-    }
+struct Attrib_Position : public Vertex_Component<GLfloat, 3, GL_FLOAT>
+{
+    static constexpr const char* name() { return "position"; }
 };
 
-// 2D
-struct Vertex_Position2 : public Vertex
+struct Attrib_Normal : public Vertex_Component<GLfloat, 3, GL_FLOAT>
 {
-    Vertex_Position2(std::array<GLfloat, 2> position,
-                     GLuint position_index = 0)
-    {
-        type = VERTEX_TYPE_POSITION2;
+    static constexpr const char* name() { return "normal"; }
+};
+
+struct Attrib_Texcoord : public Vertex_Component<GLfloat, 2, GL_FLOAT>
+{
+    static constexpr const char* name() { return "texcoord"; }
+};
 
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
+struct Attrib_Color : public Vertex_Component<GLfloat, 3, GL_FLOAT>
+{
+    static constexpr const char* name() { return "color"; }
+};
 
-        // position
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 2;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
+struct Attrib_Color4 : public Vertex_Component<GLfloat, 4, GL_FLOAT>
+{
+    static constexpr const char* name() { return "color"; }
+};
 
-        attribs.push_back(attrib_position);
-    }
+// quantized components; these accept floats and encode them when a vertex is assigned
+struct Attrib_Position_Half : public Vertex_Component<GLhalf, 3, GL_HALF_FLOAT>
+{
+    typedef std::array<GLfloat, 3> input_type;
+    static constexpr const char* name() { return "position"; }
 
-    Vertex_Position2(std::array<GLfloat, 2> position, 
-                     GLuint shader_program, 
-                     const char* position_name = "vs_position") : Vertex_Position2(position)
+    static void encode(const input_type& in, value_type& out)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
+        for (std::size_t i = 0; i < in.size(); ++i) out[i] = vertex_encode::half(in[i]);
     }
 };
 
-struct Vertex_Position2_Color : public Vertex
+struct Attrib_Normal_Packed : public Vertex_Component<GLuint, 1, GL_INT_2_10_10_10_REV, GL_TRUE, 4>
 {
-    Vertex_Position2_Color(std::array<GLfloat, 2> position, 
-                           std::array<GLfloat, 3> color, 
-                           GLuint position_index = 0, 
-                           GLuint color_index = 1)
-    {
-        type = VERTEX_TYPE_POSITION2_COLOR;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), color.begin(), color.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 2;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_color;
-        attrib_color.index = color_index;
-        attrib_color.size = 3;
-        attrib_color.type = GL_FLOAT;
-        attrib_color.normalized = GL_FALSE;
-        attrib_color.stride = data.size() * sizeof(GLfloat);
-        attrib_color.offset = 2; // skip position elements
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_color);
-    }
+    typedef std::array<GLfloat, 3> input_type;
+    static constexpr const char* name() { return "normal"; }
 
-    Vertex_Position2_Color(std::array<GLfloat, 2> position, 
-                           std::array<GLfloat, 3> color, 
-                           GLuint shader_program, 
-                           const char* position_name = "vs_position", 
-                           const char* color_name = "vs_color") : Vertex_Position2_Color(position, color)
+    static void encode(const input_type& in, value_type& out)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, color_name);
+        out[0] = vertex_encode::int_2_10_10_10(in[0], in[1], in[2]);
     }
 };
 
-struct Vertex_Position2_Texcoord : public Vertex
+// texture coordinates must lie in [0, 1]
+struct Attrib_Texcoord_Unorm16 : public Vertex_Component<GLushort, 2, GL_UNSIGNED_SHORT, GL_TRUE>
 {
-    Vertex_Position2_Texcoord(std::array<GLfloat, 2> position, 
-                              std::array<GLfloat, 2> texcoord, 
-                              GLuint position_index = 0, 
-                              GLuint texcoord_index = 1)
-    {
-        type = VERTEX_TYPE_POSITION2_TEXCOORD;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), texcoord.begin(), texcoord.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 2;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_texcoord;
-        attrib_texcoord.index = texcoord_index;
-        attrib_texcoord.size = 2;
-        attrib_texcoord.type = GL_FLOAT;
-        attrib_texcoord.normalized = GL_FALSE;
-        attrib_texcoord.stride = 2 * sizeof(GLfloat);
-        attrib_texcoord.offset = 2;
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_texcoord);
-    }
+    typedef std::array<GLfloat, 2> input_type;
+    static constexpr const char* name() { return "texcoord"; }
 
-    Vertex_Position2_Texcoord(std::array<GLfloat, 2> position, 
-                              std::array<GLfloat, 2> texcoord,
-                              GLuint shader_program, 
-                              const char* position_name = "vs_position", 
-                              const char* texcoord_name = "vs_texcoord") : Vertex_Position2_Texcoord(position, texcoord)
+    static void encode(const input_type& in, value_type& out)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, texcoord_name);
+        for (std::size_t i = 0; i < in.size(); ++i) out[i] = vertex_encode::unorm16(in[i]);
     }
 };
 
-struct Vertex_Position2_Texcoord_Color : public Vertex
+struct Attrib_Color_Unorm8 : public Vertex_Component<GLubyte, 4, GL_UNSIGNED_BYTE, GL_TRUE>
 {
-    Vertex_Position2_Texcoord_Color(std::array<GLfloat, 2> position, 
-                                    std::array<GLfloat, 2> texcoord, 
-                                    std::array<GLfloat, 3> color, 
-                                    GLuint position_index = 0, 
-                                    GLuint texcoord_index = 1, 
-                                    GLuint color_index = 2)
-    {
-        type = VERTEX_TYPE_POSITION2_TEXCOORD_COLOR;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), texcoord.begin(), texcoord.end());
-        data.insert(data.end(), color.begin(), color.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 2;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_texcoord;
-        attrib_texcoord.index = texcoord_index;
-        attrib_texcoord.size = 2;
-        attrib_texcoord.type = GL_FLOAT;
-        attrib_texcoord.normalized = GL_FALSE;
-        attrib_texcoord.stride = data.size() * sizeof(GLfloat);
-        attrib_texcoord.offset = 2;
-        
-        Vertex_Attrib attrib_color;
-        attrib_color.index = color_index;
-        attrib_color.size = 3;
-        attrib_color.type = GL_FLOAT;
-        attrib_color.normalized = GL_FALSE;
-        attrib_color.stride = data.size() * sizeof(GLfloat);
-        attrib_color.offset = 4; // skip position and texcoord
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_texcoord);
-        attribs.push_back(attrib_color);
-    }
-    
-    Vertex_Position2_Texcoord_Color(std::array<GLfloat, 2> position, 
-                                    std::array<GLfloat, 2> texcoord, 
-                                    std::array<GLfloat, 3> color, 
-                                    GLuint shader_program, 
-                                    const char* position_name = "vs_position", 
-                                    const char* texcoord_name = "vs_texcoord", 
-                                    const char* color_name = "vs_color") : Vertex_Position2_Texcoord_Color(position, texcoord, color)
+    typedef std::array<GLfloat, 4> input_type;
+    static constexpr const char* name() { return "color"; }
+
+    static void encode(const input_type& in, value_type& out)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, texcoord_name);
-        attribs[2].index = glGetAttribLocation(shader_program, color_name);
+        for (std::size_t i = 0; i < in.size(); ++i) out[i] = vertex_encode::unorm8(in[i]);
     }
 };
 
-// 3D
-struct Vertex_Position : public Vertex
+// per-instance components, read once per instance by instanced draws (binding divisor 1); an instance
+// layout is a Vertex of these. A rotation plus uniform scale and offset takes 32 bytes where a mat4
+// would take 64 and four attribute locations.
+struct Attrib_Instance_Offset_Scale : public Vertex_Component<GLfloat, 4, GL_FLOAT>
+{
+    static constexpr const char* name() { return "instance_offset_scale"; }    // xyz offset, w uniform scale
+};
+
+struct Attrib_Instance_Rotation : public Vertex_Component<GLfloat, 4, GL_FLOAT>
+{
+    static constexpr const char* name() { return "instance_rotation"; }        // unit quaternion, xyzw
+};
+
+struct Attrib_Instance_Color : public Vertex_Component<GLubyte, 4, GL_UNSIGNED_BYTE, GL_TRUE>
 {
-    Vertex_Position(std::array<GLfloat, 3> position, 
-                    GLuint position_index = 0)
+    typedef std::array<GLfloat, 4> input_type;
+    static constexpr const char* name() { return "instance_color"; }
+
+    static void encode(const input_type& in, value_type& out)
     {
-        type = VERTEX_TYPE_POSITION;
+        for (std::size_t i = 0; i < in.size(); ++i) out[i] = vertex_encode::unorm8(in[i]);
+    }
+};
 
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
+struct Attrib_Instance_Data : public Vertex_Component<GLfloat, 4, GL_FLOAT>
+{
+    static constexpr const char* name() { return "instance_data"; }            // whatever the shader makes of it
+};
 
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 3;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
+namespace vertex_detail
+{
+    constexpr GLsizei sum()
+    {
+        return 0;
+    }
 
-        attribs.push_back(attrib_position);
+    template <typename... Sizes>
+    constexpr GLsizei sum(GLsizei first, Sizes... rest)
+    {
+        return first + sum(rest...);
     }
 
-    Vertex_Position(std::array<GLfloat, 3> position, 
-                    GLuint shader_program, 
-                    const char* position_name = "vs_position") : Vertex_Position(position)
+    template <std::size_t N>
+    constexpr GLsizei offset(const GLsizei (&sizes)[N], std::size_t index)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
+        GLsizei offset = 0;
+        for (std::size_t i = 0; i < index; ++i)
+        {
+            offset += sizes[i];
+        }
+        return offset;
     }
-};
 
-struct Vertex_Position_Color : public Vertex
+    template <std::size_t I, typename First, typename... Rest>
+    struct Component_At
+    {
+        typedef typename Component_At<I - 1, Rest...>::type type;
+    };
+
+    template <typename First, typename... Rest>
+    struct Component_At<0, First, Rest...>
+    {
+        typedef First type;
+    };
+}
+
+// Tightly packed, trivially copyable vertex whose stride, attribute offsets and GL formats are
+// known at compile time. A std::vector of these is exactly the interleaved vertex buffer.
+template <typename... Components>
+struct Vertex
 {
-    Vertex_Position_Color(std::array<GLfloat, 3> position, 
-                          std::array<GLfloat, 3> color, 
-                          GLuint position_index = 0, 
-                          GLuint color_index = 1)
+    static_assert(sizeof...(Components) > 0, "A vertex needs at least one component");
+
+    static constexpr GLsizei sizes[sizeof...(Components)] = { Components::bytes... };
+    static constexpr GLsizei stride = vertex_detail::sum(Components::bytes...);
+    static constexpr GLuint attrib_count = sizeof...(Components);
+
+    template <std::size_t I>
+    using component = typename vertex_detail::Component_At<I, Components...>::type;
+
+    alignas(4) GLubyte bytes[stride];
+
+    Vertex() = default;
+
+    Vertex(const typename Components::input_type&... values)
     {
-        type = VERTEX_TYPE_POSITION_COLOR;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), color.begin(), color.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 3;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_color;
-        attrib_color.index = color_index;
-        attrib_color.size = 3;
-        attrib_color.type = GL_FLOAT;
-        attrib_color.normalized = GL_FALSE;
-        attrib_color.stride = data.size() * sizeof(GLfloat);
-        attrib_color.offset = 3;
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_color);
+        assign(std::index_sequence_for<Components...>(), values...);
     }
 
-    Vertex_Position_Color(std::array<GLfloat, 3> position, 
-                          std::array<GLfloat, 3> color, 
-                          GLuint shader_program, 
-                          const char* position_name = "vs_position", 
-                          const char* color_name = "vs_color") : Vertex_Position_Color(position, color)
+    static constexpr GLsizei offset(std::size_t index)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, color_name);
+        return vertex_detail::offset(sizes, index);
     }
-};
 
-struct Vertex_Position_Texcoord : public Vertex
-{
-    Vertex_Position_Texcoord(std::array<GLfloat, 3> position, 
-                             std::array<GLfloat, 2> texcoord, 
-                             GLuint position_index = 0, 
-                             GLuint texcoord_index = 1)
+    template <std::size_t I>
+    typename component<I>::value_type get() const
     {
-        type = VERTEX_TYPE_POSITION_TEXCOORD;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), texcoord.begin(), texcoord.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 3;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_texcoord;
-        attrib_texcoord.index = texcoord_index;
-        attrib_texcoord.size = 2;
-        attrib_texcoord.type = GL_FLOAT;
-        attrib_texcoord.normalized = GL_FALSE;
-        attrib_texcoord.stride = data.size() * sizeof(GLfloat);
-        attrib_texcoord.offset = 3;
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_texcoord);
+        typename component<I>::value_type value;
+        std::memcpy(value.data(), bytes + offset(I), sizeof(value));
+        return value;
     }
 
-    Vertex_Position_Texcoord(std::array<GLfloat, 3> position, 
-                             std::array<GLfloat, 2> texcoord,
-                             GLuint shader_program, 
-                             const char* position_name = "vs_position", 
-                             const char* texcoord_name = "vs_texcoord") : Vertex_Position_Texcoord(position, texcoord)
+    // stores an already encoded value
+    template <std::size_t I>
+    void store(const typename component<I>::value_type& value)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, texcoord_name);
+        std::memcpy(bytes + offset(I), value.data(), sizeof(value));
     }
-};
 
-struct Vertex_Position_Normal : public Vertex
-{
-    Vertex_Position_Normal(std::array<GLfloat, 3> position, 
-                           std::array<GLfloat, 3> normal, 
-                           GLuint position_index = 0,
-                           GLuint normal_index = 1)
+    template <std::size_t I>
+    void set(const typename component<I>::input_type& value)
     {
-        type = VERTEX_TYPE_POSITION_NORMAL;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), normal.begin(), normal.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 3;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_normal;
-        attrib_normal.index = normal_index;
-        attrib_normal.size = 3;
-        attrib_normal.type = GL_FLOAT;
-        attrib_normal.normalized = GL_FALSE;
-        attrib_normal.stride = data.size() * sizeof(GLfloat);
-        attrib_normal.offset = 3;
-
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_normal);
+        typename component<I>::value_type encoded;
+        component<I>::encode(value, encoded);
+        store<I>(encoded);
     }
 
-    Vertex_Position_Normal(std::array<GLfloat, 3> position, 
-                           std::array<GLfloat, 3> normal, 
-                           GLuint shader_program, 
-                           const char* position_name = "vs_position", 
-                           const char* normal_name = "vs_normal") : Vertex_Position_Normal(position, normal)
+    static const Vertex_Format& format()
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, normal_name);
+        return make_format(std::index_sequence_for<Components...>());
     }
-};
 
-struct Vertex_Position_Normal_Texcoord : public Vertex
-{
-    Vertex_Position_Normal_Texcoord(std::array<GLfloat, 3> position, 
-                                    std::array<GLfloat, 3> normal,
-                                    std::array<GLfloat, 2> texcoord,
-                                    GLuint position_index = 0,
-                                    GLuint normal_index = 1,
-                                    GLuint texcoord_index = 2)
+private:
+    template <std::size_t... I>
+    void assign(std::index_sequence<I...>, const typename Components::input_type&... values)
     {
-        type = VERTEX_TYPE_POSITION_NORMAL_TEXCOORD;
-
-        data = std::vector<GLfloat>();
-        data.insert(data.end(), position.begin(), position.end());
-        data.insert(data.end(), normal.begin(), normal.end());
-        data.insert(data.end(), texcoord.begin(), texcoord.end());
-
-        Vertex_Attrib attrib_position;
-        attrib_position.index = position_index;
-        attrib_position.size = 3;
-        attrib_position.type = GL_FLOAT;
-        attrib_position.normalized = GL_FALSE;
-        attrib_position.stride = data.size() * sizeof(GLfloat);
-        attrib_position.offset = 0;
-
-        Vertex_Attrib attrib_normal;
-        attrib_normal.index = normal_index;
-        attrib_normal.size = 3;
-        attrib_normal.type = GL_FLOAT;
-        attrib_normal.normalized = GL_FALSE;
-        attrib_normal.stride = data.size() * sizeof(GLfloat);
-        attrib_normal.offset = 3; // skip position
-
-        Vertex_Attrib attrib_texcoord;
-        attrib_texcoord.index = texcoord_index;
-        attrib_texcoord.size = 2;
-        attrib_texcoord.type = GL_FLOAT;
-        attrib_texcoord.normalized = GL_FALSE;
-        attrib_texcoord.stride = data.size() * sizeof(GLfloat);
-        attrib_texcoord.offset = 6; // skip position and normal
-        
-        attribs.push_back(attrib_position);
-        attribs.push_back(attrib_normal);
-        attribs.push_back(attrib_texcoord);
+        int expand[] = { 0, (set<I>(values), 0)... };
+        (void)expand;
     }
 
-    Vertex_Position_Normal_Texcoord(std::array<GLfloat, 3> position, 
-                                    std::array<GLfloat, 3> normal,
-                                    std::array<GLfloat, 2> texcoord,
-                                    GLuint shader_program, 
-                                    const char* position_name = "vs_position", 
-                                    const char* normal_name = "vs_normal", 
-                                    const char* texcoord_name = "vs_texcoord") : Vertex_Position_Normal_Texcoord(position, normal, texcoord)
+    template <std::size_t... I>
+    static const Vertex_Format& make_format(std::index_sequence<I...>)
     {
-        attribs[0].index = glGetAttribLocation(shader_program, position_name);
-        attribs[1].index = glGetAttribLocation(shader_program, normal_name);
-        attribs[2].index = glGetAttribLocation(shader_program, texcoord_name);
+        // attribute indices default to the component order; shaders may remap them by name
+        static constexpr Vertex_Attrib attribs[] =
+        {
+            { GLuint(I), Components::size, Components::type, Components::normalized, offset(I), Components::name() }...
+        };
+
+        static constexpr Vertex_Format format = { stride, attrib_count, attribs };
+        return format;
     }
 };
+
+template <typename... Components>
+constexpr GLsizei Vertex<Components...>::sizes[sizeof...(Components)];
+
+// 2D
+typedef Vertex<Attrib_Position2> Vertex_Position2;
+typedef Vertex<Attrib_Position2, Attrib_Color> Vertex_Position2_Color;
+typedef Vertex<Attrib_Position2, Attrib_Texcoord> Vertex_Position2_Texcoord;
+typedef Vertex<Attrib_Position2, Attrib_Texcoord, Attrib_Color> Vertex_Position2_Texcoord_Color;
+
+// 3D
+typedef Vertex<Attrib_Position> Vertex_Position;
+typedef Vertex<Attrib_Position, Attrib_Color> Vertex_Position_Color;
+typedef Vertex<Attrib_Position, Attrib_Texcoord> Vertex_Position_Texcoord;
+typedef Vertex<Attrib_Position, Attrib_Normal> Vertex_Position_Normal;
+typedef Vertex<Attrib_Position, Attrib_Normal, Attrib_Texcoord> Vertex_Position_Normal_Texcoord;
+
+// 3D, quantized
+typedef Vertex<Attrib_Position_Half> Vertex_Packed_Position;
+typedef Vertex<Attrib_Position_Half, Attrib_Color_Unorm8> Vertex_Packed_Position_Color;
+typedef Vertex<Attrib_Position_Half, Attrib_Texcoord_Unorm16> Vertex_Packed_Position_Texcoord;
+typedef Vertex<Attrib_Position_Half, Attrib_Normal_Packed> Vertex_Packed_Position_Normal;
+typedef Vertex<Attrib_Position_Half, Attrib_Normal_Packed, Attrib_Texcoord_Unorm16> Vertex_Packed_Position_Normal_Texcoord;
+typedef Vertex<Attrib_Position_Half, Attrib_Normal_Packed, Attrib_Color_Unorm8> Vertex_Packed_Position_Normal_Color;
+
+// per instance
+typedef Vertex<Attrib_Instance_Offset_Scale, Attrib_Instance_Rotation> Instance_Transform;
+typedef Vertex<Attrib_Instance_Offset_Scale, Attrib_Instance_Rotation, Attrib_Instance_Color> Instance_Transform_Color;
+typedef Vertex<Attrib_Instance_Offset_Scale, Attrib_Instance_Rotation, Attrib_Instance_Color, Attrib_Instance_Data> Instance_Transform_Color_Data;
+
+// every vertex layout above; for mapping layouts described in files (caches, model formats) onto them.
+// Stream files store the position in this list, so new layouts go at the end.
+inline const std::array<const Vertex_Format*, 15>& vertex_formats()
+{
+    static const std::array<const Vertex_Format*, 15> formats =
+    {{
+        &Vertex_Position2::format(),
+        &Vertex_Position2_Color::format(),
+        &Vertex_Position2_Texcoord::format(),
+        &Vertex_Position2_Texcoord_Color::format(),
+        &Vertex_Position::format(),
+        &Vertex_Position_Color::format(),
+        &Vertex_Position_Texcoord::format(),
+        &Vertex_Position_Normal::format(),
+        &Vertex_Position_Normal_Texcoord::format(),
+        &Vertex_Packed_Position_Normal::format(),
+        &Vertex_Packed_Position_Normal_Texcoord::format(),
+        &Vertex_Packed_Position_Normal_Color::format(),
+        &Vertex_Packed_Position::format(),
+        &Vertex_Packed_Position_Color::format(),
+        &Vertex_Packed_Position_Texcoord::format()
+    }};
+
+    return formats;
+}
+
+static_assert(sizeof(Vertex_Position_Normal_Texcoord) == 8 * sizeof(GLfloat), "Vertices must be tightly packed");
+static_assert(sizeof(Vertex_Packed_Position_Normal_Texcoord) == 4 * sizeof(GLfloat), "Vertices must be tightly packed");
+static_assert(std::is_trivially_copyable<Vertex_Position_Normal_Texcoord>::value, "Vertices must be trivially copyable");
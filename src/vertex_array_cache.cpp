@@ -0,0 +1,135 @@
+#include "vertex_array_cache.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+namespace
+{
+    void set_formats(GLuint vao, const Vertex_Format& format, const GLint* locations, GLuint binding)
+    {
+        for (GLuint i = 0; i < format.attrib_count; ++i)
+        {
+            const Vertex_Attrib& attrib = format.attribs[i];
+            GLint location = locations[i];
+
+            if (location < 0) continue; // not an input of the program
+
+            glEnableVertexArrayAttrib(vao, GLuint(location));
+            glVertexArrayAttribFormat(vao, GLuint(location), attrib.size, attrib.type, attrib.normalized, GLuint(attrib.offset));
+            glVertexArrayAttribBinding(vao, GLuint(location), binding);
+        }
+    }
+}
+
+GLuint Vertex_Array_Cache::vertex_array(const Vertex_Format& format, const GLint* locations,
+                                        const Vertex_Format* instance_format, const GLint* instance_locations)
+{
+    const GLuint instance_count = instance_format ? instance_format->attrib_count : 0;
+    const Vertex_Attrib* instance_attribs = instance_format ? instance_format->attribs : nullptr;
+
+    // instance attributes follow the vertex attributes in the component order
+    auto location = [&](GLuint i)
+    {
+        if (i < format.attrib_count) return locations ? locations[i] : GLint(format.attribs[i].index);
+
+        i -= format.attrib_count;
+        return instance_locations ? instance_locations[i] : GLint(format.attrib_count + instance_format->attribs[i].index);
+    };
+
+    // called for every draw: matched in place, without building the location list
+    for (const Entry& entry : entries)
+    {
+        if (entry.attribs != format.attribs || entry.instance_attribs != instance_attribs) continue;
+
+        GLuint i = 0;
+        while (i < entry.locations.size() && entry.locations[i] == location(i)) ++i;
+        if (i == entry.locations.size()) return entry.vao;
+    }
+
+    std::vector<GLint> resolved(format.attrib_count + instance_count);
+    for (GLuint i = 0; i < resolved.size(); ++i)
+    {
+        resolved[i] = location(i);
+    }
+
+    Entry entry;
+    entry.attribs = format.attribs;
+    entry.instance_attribs = instance_attribs;
+    entry.locations = std::move(resolved);
+    entry.vao = Gpu_Vertex_Array::create();
+    entry.vertex_buffer = 0;
+    entry.stride = format.stride;
+    entry.index_buffer = 0;
+    entry.instance_buffer = 0;
+    entry.instance_stride = 0;
+
+    set_formats(entry.vao, format, entry.locations.data(), 0);
+
+    if (instance_format)
+    {
+        set_formats(entry.vao, *instance_format, entry.locations.data() + format.attrib_count, 1);
+        glVertexArrayBindingDivisor(entry.vao, 1, 1);
+    }
+
+    entries.push_back(std::move(entry));
+    return entries.back().vao;
+}
+
+void Vertex_Array_Cache::bind(Gl_State& state, GLuint vertex_array, GLuint vertex_buffer, GLsizei stride, GLuint index_buffer,
+                              GLuint instance_buffer, GLsizei instance_stride)
+{
+    auto it = std::find_if(entries.begin(), entries.end(), [vertex_array](const Entry& entry) { return entry.vao == vertex_array; });
+    if (it == entries.end())
+    {
+        throw std::runtime_error(fmt::format("Vertex array {} does not belong to the cache", vertex_array));
+    }
+
+    if (it->vertex_buffer != vertex_buffer || it->stride != stride)
+    {
+        glVertexArrayVertexBuffer(vertex_array, 0, vertex_buffer, 0, stride);
+        it->vertex_buffer = vertex_buffer;
+        it->stride = stride;
+        buffer_changes++;
+    }
+
+    if (it->index_buffer != index_buffer)
+    {
+        glVertexArrayElementBuffer(vertex_array, index_buffer);
+        it->index_buffer = index_buffer;
+        buffer_changes++;
+    }
+
+    if (it->instance_attribs && (it->instance_buffer != instance_buffer || it->instance_stride != instance_stride))
+    {
+        glVertexArrayVertexBuffer(vertex_array, 1, instance_buffer, 0, instance_stride);
+        it->instance_buffer = instance_buffer;
+        it->instance_stride = instance_stride;
+        buffer_changes++;
+    }
+
+    state.bind_vertex_array(vertex_array);
+}
+
+Vertex_Array_Cache_Statistics Vertex_Array_Cache::statistics() const
+{
+    Vertex_Array_Cache_Statistics statistics;
+    statistics.vertex_arrays = entries.size();
+    statistics.buffer_changes = buffer_changes;
+    return statistics;
+}
+
+std::shared_ptr<Vertex_Array_Cache> Vertex_Array_Cache::shared()
+{
+    static std::weak_ptr<Vertex_Array_Cache> cache;
+
+    std::shared_ptr<Vertex_Array_Cache> result = cache.lock();
+    if (!result)
+    {
+        result = std::make_shared<Vertex_Array_Cache>();
+        cache = result;
+    }
+
+    return result;
+}
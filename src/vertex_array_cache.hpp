@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+#include "vertex.hpp"
+#include "gl_state.hpp"
+#include "gpu_object.hpp"
+
+struct Vertex_Array_Cache_Statistics
+{
+    std::size_t vertex_arrays = 0;      // one per vertex layout and set of attribute locations
+    std::size_t buffer_changes = 0;     // vertex or index buffers attached on bind
+};
+
+// Vertex array objects shared by every mesh with the same vertex layout. With direct state access the
+// attribute formats are recorded once, separately from the buffer bindings: all attributes read from
+// binding point 0, which holds a whole arena block from offset 0 with the layout's stride, and meshes
+// address their vertices with a base vertex. Meshes that live in the same arena blocks therefore draw
+// through an identical vertex array; other blocks only swap the two buffer bindings.
+//
+// Instanced vertex arrays additionally read an instance layout from binding point 1 with a divisor of
+// 1. That buffer is also attached from offset 0, and the draw's base instance selects the first
+// record, so per-frame instance data in the ring never re-points the vertex array. GL thread only.
+class Vertex_Array_Cache
+{
+private:
+    struct Entry
+    {
+        const Vertex_Attrib* attribs;           // identifies the layout
+        const Vertex_Attrib* instance_attribs;  // nullptr when not instanced
+        std::vector<GLint> locations;           // per format attribute, then per instance attribute; -1 for unused ones
+        Gpu_Vertex_Array vao;
+
+        // currently attached
+        GLuint vertex_buffer;
+        GLsizei stride;
+        GLuint index_buffer;
+        GLuint instance_buffer;
+        GLsizei instance_stride;
+    };
+
+    std::vector<Entry> entries;         // a handful: layouts times distinct program input orders
+    std::size_t buffer_changes;
+
+public:
+    Vertex_Array_Cache() : buffer_changes(0) {}
+
+    Vertex_Array_Cache(const Vertex_Array_Cache&) = delete;
+    Vertex_Array_Cache& operator=(const Vertex_Array_Cache&) = delete;
+
+    // vertex array with the attributes of format at locations (one per attribute, -1 to leave it out;
+    // nullptr for the component order of the format), and those of instance_format if given
+    GLuint vertex_array(const Vertex_Format& format, const GLint* locations,
+                        const Vertex_Format* instance_format = nullptr, const GLint* instance_locations = nullptr);
+
+    // binds vertex_array, first attaching vertex_buffer, index_buffer (0 for none) and instance_buffer
+    // (instanced vertex arrays only) if it holds others
+    void bind(Gl_State& state, GLuint vertex_array, GLuint vertex_buffer, GLsizei stride, GLuint index_buffer,
+              GLuint instance_buffer = 0, GLsizei instance_stride = 0);
+
+    Vertex_Array_Cache_Statistics statistics() const;
+
+    // cache shared by every mesh of the process; created on first use and destroyed with the last holder
+    static std::shared_ptr<Vertex_Array_Cache> shared();
+};
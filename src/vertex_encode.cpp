@@ -0,0 +1,192 @@
+#include "vertex_encode.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VERTEX_ENCODE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    // Values are converted in chunks into a small contiguous block first, so the SIMD kernels work on
+    // plain arrays and the scatter into the interleaved vertex block is a fixed-size copy per element.
+    const std::size_t chunk_values = 1024;
+
+    template <typename T, typename Kernel>
+    void encode_chunked(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride, Kernel kernel)
+    {
+        T chunk[chunk_values];
+        const std::size_t elements_per_chunk = chunk_values / std::size_t(components);
+        const std::size_t element_bytes = sizeof(T) * std::size_t(components);
+
+        GLubyte* out = static_cast<GLubyte*>(dst);
+
+        for (std::size_t first = 0; first < count; first += elements_per_chunk)
+        {
+            std::size_t elements = std::min(elements_per_chunk, count - first);
+            kernel(src + first * components, elements * components, chunk);
+
+            for (std::size_t i = 0; i < elements; ++i)
+            {
+                std::memcpy(out + (first + i) * stride, chunk + i * components, element_bytes);
+            }
+        }
+    }
+
+#ifdef VERTEX_ENCODE_SSE2
+    // narrows four 32-bit lanes holding values in [0, 0xffff] to 16 bits without saturation
+    inline __m128i pack_u16(__m128i lo, __m128i hi)
+    {
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+        return _mm_packs_epi32(lo, hi);
+    }
+
+    inline __m128i half4(__m128 value)
+    {
+        const __m128i sign_mask = _mm_set1_epi32(int(0x80000000u));
+
+        __m128i f = _mm_castps_si128(value);
+        __m128i sign = _mm_and_si128(f, sign_mask);
+        f = _mm_xor_si128(f, sign);
+
+        // overflow, infinity or nan
+        __m128i is_special = _mm_cmpgt_epi32(f, _mm_set1_epi32(0x477fffff));
+        __m128i is_nan = _mm_cmpgt_epi32(f, _mm_set1_epi32(0x7f800000));
+        __m128i special = _mm_or_si128(_mm_set1_epi32(0x7c00), _mm_and_si128(is_nan, _mm_set1_epi32(0x0200)));
+
+        // subnormal or zero
+        __m128i is_subnormal = _mm_cmplt_epi32(f, _mm_set1_epi32(0x38800000));
+        const __m128i magic = _mm_set1_epi32(0x3f000000);
+        __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(f), _mm_castsi128_ps(magic))), magic);
+
+        // normal
+        __m128i mantissa_odd = _mm_and_si128(_mm_srli_epi32(f, 13), _mm_set1_epi32(1));
+        __m128i normal = _mm_add_epi32(_mm_add_epi32(f, _mm_set1_epi32(int(0xc8000fffu))), mantissa_odd);
+        normal = _mm_srli_epi32(normal, 13);
+
+        __m128i result = _mm_or_si128(_mm_and_si128(is_subnormal, subnormal), _mm_andnot_si128(is_subnormal, normal));
+        result = _mm_or_si128(_mm_and_si128(is_special, special), _mm_andnot_si128(is_special, result));
+        return _mm_or_si128(result, _mm_srli_epi32(sign, 16));
+    }
+
+    inline __m128i unorm4(__m128 value, GLfloat scale)
+    {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(scale)), _mm_set1_ps(0.5f)));
+    }
+
+    inline __m128i snorm4(__m128 value, GLfloat scale)
+    {
+        value = _mm_min_ps(_mm_max_ps(value, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+        return _mm_cvtps_epi32(_mm_mul_ps(value, _mm_set1_ps(scale))); // round to nearest
+    }
+
+    inline void load_xyz4(const GLfloat* src, __m128& x, __m128& y, __m128& z)
+    {
+        x = _mm_setr_ps(src[0], src[3], src[6], src[9]);
+        y = _mm_setr_ps(src[1], src[4], src[7], src[10]);
+        z = _mm_setr_ps(src[2], src[5], src[8], src[11]);
+    }
+#endif
+
+    void half_kernel(const GLfloat* src, std::size_t n, GLhalf* out)
+    {
+        std::size_t i = 0;
+#ifdef VERTEX_ENCODE_SSE2
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i lo = half4(_mm_loadu_ps(src + i));
+            __m128i hi = half4(_mm_loadu_ps(src + i + 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), pack_u16(lo, hi));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            out[i] = vertex_encode::half(src[i]);
+        }
+    }
+
+    void unorm16_kernel(const GLfloat* src, std::size_t n, GLushort* out)
+    {
+        std::size_t i = 0;
+#ifdef VERTEX_ENCODE_SSE2
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i lo = unorm4(_mm_loadu_ps(src + i), 65535.0f);
+            __m128i hi = unorm4(_mm_loadu_ps(src + i + 4), 65535.0f);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), pack_u16(lo, hi));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            out[i] = vertex_encode::unorm16(src[i]);
+        }
+    }
+
+    void unorm8_kernel(const GLfloat* src, std::size_t n, GLubyte* out)
+    {
+        std::size_t i = 0;
+#ifdef VERTEX_ENCODE_SSE2
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i a = _mm_packs_epi32(unorm4(_mm_loadu_ps(src + i), 255.0f), unorm4(_mm_loadu_ps(src + i + 4), 255.0f));
+            __m128i b = _mm_packs_epi32(unorm4(_mm_loadu_ps(src + i + 8), 255.0f), unorm4(_mm_loadu_ps(src + i + 12), 255.0f));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(a, b));
+        }
+#endif
+        for (; i < n; ++i)
+        {
+            out[i] = vertex_encode::unorm8(src[i]);
+        }
+    }
+}
+
+namespace vertex_encode
+{
+    void half(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride)
+    {
+        encode_chunked<GLhalf>(src, components, count, dst, stride, half_kernel);
+    }
+
+    void unorm16(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride)
+    {
+        encode_chunked<GLushort>(src, components, count, dst, stride, unorm16_kernel);
+    }
+
+    void unorm8(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride)
+    {
+        encode_chunked<GLubyte>(src, components, count, dst, stride, unorm8_kernel);
+    }
+
+    void int_2_10_10_10(const GLfloat* src, std::size_t count, void* dst, GLsizei stride)
+    {
+        GLubyte* out = static_cast<GLubyte*>(dst);
+        std::size_t i = 0;
+
+#ifdef VERTEX_ENCODE_SSE2
+        const __m128i mask = _mm_set1_epi32(0x3ff);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128 x, y, z;
+            load_xyz4(src + i * 3, x, y, z);
+
+            __m128i packed = _mm_and_si128(snorm4(x, 511.0f), mask);
+            packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_and_si128(snorm4(y, 511.0f), mask), 10));
+            packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_and_si128(snorm4(z, 511.0f), mask), 20));
+
+            alignas(16) GLuint values[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(values), packed);
+
+            for (std::size_t j = 0; j < 4; ++j)
+            {
+                std::memcpy(out + (i + j) * stride, &values[j], sizeof(GLuint));
+            }
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            GLuint value = vertex_encode::int_2_10_10_10(src[i * 3], src[i * 3 + 1], src[i * 3 + 2]);
+            std::memcpy(out + i * stride, &value, sizeof(value));
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <glad/glad.h>
+
+// Encoders for quantized vertex attribute formats. The scalar versions are used when single vertices
+// are constructed; the bulk versions convert whole attribute streams (SSE2 where available) and write
+// them into an interleaved vertex block with the given stride.
+namespace vertex_encode
+{
+    // IEEE 754 binary16, round to nearest even
+    inline GLhalf half(GLfloat value)
+    {
+        std::uint32_t f;
+        std::memcpy(&f, &value, sizeof(f));
+
+        std::uint32_t sign = f & 0x80000000u;
+        f ^= sign;
+
+        std::uint32_t h;
+        if (f >= 0x47800000u) // overflow, infinity or nan
+        {
+            h = (f > 0x7f800000u) ? 0x7e00u : 0x7c00u;
+        }
+        else if (f < 0x38800000u) // subnormal or zero; let the fpu do the rounding
+        {
+            const std::uint32_t magic_bits = 0x3f000000u; // 0.5f
+            GLfloat magic, shifted;
+            std::memcpy(&magic, &magic_bits, sizeof(magic));
+            std::memcpy(&shifted, &f, sizeof(shifted));
+            shifted += magic;
+            std::memcpy(&h, &shifted, sizeof(h));
+            h -= magic_bits;
+        }
+        else
+        {
+            std::uint32_t mantissa_odd = (f >> 13) & 1u;
+            h = (f + 0xc8000fffu + mantissa_odd) >> 13; // rebias exponent and round
+        }
+
+        return GLhalf(h | (sign >> 16));
+    }
+
+    inline GLfloat half_to_float(GLhalf value)
+    {
+        std::uint32_t sign = std::uint32_t(value & 0x8000u) << 16;
+        std::uint32_t exponent = (value >> 10) & 0x1fu;
+        std::uint32_t mantissa = value & 0x3ffu;
+
+        std::uint32_t f;
+        if (exponent == 0x1fu) // infinity or nan
+        {
+            f = sign | 0x7f800000u | (mantissa << 13);
+        }
+        else if (exponent == 0) // subnormal or zero
+        {
+            GLfloat magnitude = std::ldexp(GLfloat(mantissa), -24);
+            std::memcpy(&f, &magnitude, sizeof(f));
+            f |= sign;
+        }
+        else
+        {
+            f = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+        }
+
+        GLfloat result;
+        std::memcpy(&result, &f, sizeof(result));
+        return result;
+    }
+
+    inline GLushort unorm16(GLfloat value)
+    {
+        return GLushort(std::min(std::max(value, 0.0f), 1.0f) * 65535.0f + 0.5f);
+    }
+
+    inline GLubyte unorm8(GLfloat value)
+    {
+        return GLubyte(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+
+    // signed normalized x, y, z in 10 bits each, w = 0; for GL_INT_2_10_10_10_REV
+    inline GLuint int_2_10_10_10(GLfloat x, GLfloat y, GLfloat z)
+    {
+        auto snorm10 = [](GLfloat v) { return GLuint(std::lrint(std::min(std::max(v, -1.0f), 1.0f) * 511.0f)) & 0x3ffu; };
+        return snorm10(x) | (snorm10(y) << 10) | (snorm10(z) << 20);
+    }
+
+    // Bulk encoders. src holds count tightly packed elements of the given number of float components;
+    // element i is written to dst + i * stride.
+    void half(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride);
+    void unorm16(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride);
+    void unorm8(const GLfloat* src, GLsizei components, std::size_t count, void* dst, GLsizei stride);
+
+    // src holds count xyz vectors
+    void int_2_10_10_10(const GLfloat* src, std::size_t count, void* dst, GLsizei stride);
+}
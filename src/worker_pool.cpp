@@ -0,0 +1,107 @@
+#include "worker_pool.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#include "util.hpp"
+
+Worker_Pool::Worker_Pool(std::size_t thread_count)
+: stopping(false)
+{
+    if (thread_count == 0)
+    {
+        thread_count = std::max<std::size_t>(1, util::worker_count() - 1);
+    }
+
+    for (std::size_t i = 0; i < thread_count; ++i)
+    {
+        workers.emplace_back(&Worker_Pool::run_worker, this);
+    }
+}
+
+void Worker_Pool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        stopping = true;
+        work.clear();
+    }
+
+    work_available.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+
+    workers.clear();
+}
+
+void Worker_Pool::enqueue(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(work_mutex);
+        work.push_back(std::move(job));
+    }
+
+    work_available.notify_one();
+}
+
+void Worker_Pool::run_worker()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(work_mutex);
+            work_available.wait(lock, [this]() { return stopping || !work.empty(); });
+
+            if (stopping) return;
+
+            job = std::move(work.front());
+            work.pop_front();
+        }
+
+        job();
+    }
+}
+
+void Worker_Pool::parallel_for(std::size_t count, const std::function<void(std::size_t begin, std::size_t end, std::size_t range)>& function,
+                               std::size_t min_range)
+{
+    std::size_t ranges = std::min(workers.size() + 1, std::max<std::size_t>(1, count / std::max<std::size_t>(1, min_range)));
+    std::size_t range = (count + ranges - 1) / ranges;
+
+    std::vector<std::exception_ptr> errors(ranges);
+    std::mutex done_mutex;
+    std::condition_variable done;
+    std::size_t remaining = ranges - 1;
+
+    for (std::size_t r = 1; r < ranges; ++r)
+    {
+        std::size_t begin = std::min(count, r * range), end = std::min(count, begin + range);
+        enqueue([&, r, begin, end]()
+        {
+            try { function(begin, end, r); }
+            catch (...) { errors[r] = std::current_exception(); }
+
+            // notified under the lock, as the waiting caller destroys done once remaining is 0
+            std::lock_guard<std::mutex> lock(done_mutex);
+            if (--remaining == 0) done.notify_one();
+        });
+    }
+
+    try { function(0, std::min(count, range), 0); }
+    catch (...) { errors[0] = std::current_exception(); }
+
+    {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        done.wait(lock, [&remaining]() { return remaining == 0; });
+    }
+
+    for (std::exception_ptr& error : errors)
+    {
+        if (error) std::rethrow_exception(error);
+    }
+}
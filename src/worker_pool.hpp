@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+// Threads started once and kept for the lifetime of the pool, taking jobs from one queue in order.
+// Owners with work of different urgency keep a pool each, so short per-frame jobs never wait behind
+// long ones (the asset loader's parsing, the renderer's command recording).
+class Worker_Pool
+{
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> work;
+    std::mutex work_mutex;
+    std::condition_variable work_available;
+    bool stopping;
+
+    void run_worker();
+
+public:
+    // thread_count 0 starts one thread per core besides the calling thread
+    explicit Worker_Pool(std::size_t thread_count = 0);
+
+    ~Worker_Pool() { stop(); }
+
+    Worker_Pool(const Worker_Pool&) = delete;
+    Worker_Pool& operator=(const Worker_Pool&) = delete;
+
+    // drops the work that has not started and waits for the running jobs; for owners whose state the
+    // jobs use, before that state goes
+    void stop();
+
+    // runs job on one of the threads; it must not throw
+    void enqueue(std::function<void()> job);
+
+    // Splits [0, count) into one contiguous range per thread, the calling thread included, runs
+    // function(begin, end, range) on each and returns once all are done. Exceptions are rethrown on
+    // the caller. Not from a job of the same pool, which could wait for itself.
+    void parallel_for(std::size_t count, const std::function<void(std::size_t begin, std::size_t end, std::size_t range)>& function,
+                      std::size_t min_range = 1);
+
+    std::size_t size() const { return workers.size(); }
+};